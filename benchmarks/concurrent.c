@@ -0,0 +1,317 @@
+#include "mmem.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_THREADS    32
+#define BURST          64
+#define OPERATIONS     1000000
+// Objects handed between threads by the correctness check, so objects are released by other threads as well
+#define EXCHANGE       256
+
+// Simple struct to test allocations
+typedef struct {
+	int x, y;
+	float value;
+} TestStruct;
+
+// Object of the correctness check, stamped by its owner and verified before it is released
+typedef struct {
+	uint64_t Stamp;
+	uint64_t Check;
+} CheckStruct;
+
+typedef enum {
+	BENCH_MALLOC,
+	BENCH_POOL_MUTEX,
+	BENCH_POOL_CONCURRENT,
+	BENCH_POOL_CACHE,
+	BENCH_TOTAL
+} Benchmark;
+
+typedef struct {
+	Benchmark Bench;
+	uint64_t Id;
+	size_t Operations;
+	pthread_barrier_t * Barrier;
+	MemoryPoolCache Cache;
+} Worker;
+
+char const * const bstring[BENCH_TOTAL] = {
+	"malloc",
+	"pool_mutex",
+	"pool_concurrent",
+	"pool_cache"
+};
+
+int const bthreads[] = { 1, 2, 4, 8, 16, 32 };
+#define THREAD_STEPS ((int)(sizeof( bthreads ) / sizeof( bthreads[0] )))
+
+MemoryPool pool;
+pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+MemoryPoolConcurrent cpool;
+// Thread owning each slot of the concurrent pool during the correctness check, 0 while the slot is free
+uint64_t * owners;
+void * exchange[EXCHANGE];
+uint64_t failures;
+
+static inline double Now( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static inline void * Allocate( Worker * worker ) {
+	void * ptr = NULL;
+	switch ( worker->Bench ) {
+	case BENCH_MALLOC:
+		return malloc( sizeof( TestStruct ) );
+	case BENCH_POOL_MUTEX:
+		pthread_mutex_lock( &pool_lock );
+		ptr = PoolAllocate( &pool );
+		pthread_mutex_unlock( &pool_lock );
+		return ptr;
+	case BENCH_POOL_CONCURRENT:
+		return PoolConcurrentAllocate( &cpool );
+	case BENCH_POOL_CACHE:
+		return PoolCacheAllocate( &worker->Cache );
+	default:
+		return NULL;
+	}
+}
+
+static inline void Release( Worker * worker, void * ptr ) {
+	switch ( worker->Bench ) {
+	case BENCH_MALLOC:
+		free( ptr );
+		break;
+	case BENCH_POOL_MUTEX:
+		pthread_mutex_lock( &pool_lock );
+		PoolRelease( &pool, ptr );
+		pthread_mutex_unlock( &pool_lock );
+		break;
+	case BENCH_POOL_CONCURRENT:
+		PoolConcurrentRelease( &cpool, ptr );
+		break;
+	case BENCH_POOL_CACHE:
+		PoolCacheRelease( &worker->Cache, ptr );
+		break;
+	default:
+		break;
+	}
+}
+
+static void * Work( void * param ) {
+	Worker * worker = param;
+	TestStruct * burst[BURST];
+
+	if ( worker->Bench == BENCH_POOL_CACHE ) {
+		PoolCacheAttach( &worker->Cache, &cpool );
+	}
+
+	pthread_barrier_wait( worker->Barrier );
+	for ( size_t done = 0; done < worker->Operations; done += BURST ) {
+		for ( int i = 0; i < BURST; ++i ) {
+			burst[i] = Allocate( worker );
+			burst[i]->x = i;
+		}
+		for ( int i = 0; i < BURST; ++i ) {
+			Release( worker, burst[i] );
+		}
+	}
+
+	if ( worker->Bench == BENCH_POOL_CACHE ) {
+		PoolCacheDetach( &worker->Cache );
+	}
+	return NULL;
+}
+
+static inline size_t Slot( void const * ptr ) {
+	return (size_t)((char const *)ptr - (char const *)cpool.Raw) / cpool.ElementSize;
+}
+
+static void Fail( char const * what, void const * ptr ) {
+	MMEM_ATOMIC_FETCH_ADD( &failures, 1 );
+	fprintf( stderr, "%s: slot %zu\n", what, Slot( ptr ) );
+}
+
+/// Releases an object after verifying its stamp and giving up its ownership, which has to be held
+static void CheckRelease( Worker * worker, CheckStruct * object ) {
+	if ( object->Check != ~object->Stamp ) {
+		Fail( "object overwritten while in use", object );
+	}
+	if ( !MMEM_ATOMIC_EXCHANGE( &owners[Slot( object )], 0 ) ) {
+		Fail( "object released twice", object );
+	}
+	Release( worker, object );
+}
+
+static void * Check( void * param ) {
+	Worker * worker = param;
+	CheckStruct * burst[BURST];
+	uint64_t serial = 0;
+	uint64_t random = worker->Id * 0x9E3779B97F4A7C15u;
+
+	if ( worker->Bench == BENCH_POOL_CACHE ) {
+		PoolCacheAttach( &worker->Cache, &cpool );
+	}
+
+	pthread_barrier_wait( worker->Barrier );
+	for ( size_t done = 0; done < worker->Operations; done += BURST ) {
+		int count = 0;
+		while ( count < BURST ) {
+			CheckStruct * object = Allocate( worker );
+			if ( !object ) {
+				break;
+			}
+			// A slot handed out twice is owned already
+			uint64_t expected = 0;
+			if ( !MMEM_ATOMIC_CAS( &owners[Slot( object )], &expected, worker->Id ) ) {
+				Fail( "slot handed out twice", object );
+				continue;
+			}
+			object->Stamp = (worker->Id << 32) | serial++;
+			object->Check = ~object->Stamp;
+			burst[count++] = object;
+		}
+
+		for ( int i = 0; i < count; ++i ) {
+			CheckStruct * object = burst[i];
+			if ( ( object->Stamp >> 32 ) != worker->Id ) {
+				Fail( "object stamped by another thread", object );
+			}
+			if ( i & 1 ) {
+				// Every other object is released by whichever thread takes it from the exchange
+				random ^= random << 13;
+				random ^= random >> 7;
+				random ^= random << 17;
+				object = MMEM_ATOMIC_EXCHANGE_PTR( &exchange[random % EXCHANGE], object );
+				if ( !object ) {
+					continue;
+				}
+			}
+			CheckRelease( worker, object );
+		}
+	}
+
+	if ( worker->Bench == BENCH_POOL_CACHE ) {
+		PoolCacheDetach( &worker->Cache );
+	}
+	return NULL;
+}
+
+/// Runs the correctness check of a concurrent benchmark, returns whether every slot was used and returned correctly
+static bool Verify( Benchmark bench, int threads, size_t operations ) {
+	pthread_t handles[MAX_THREADS];
+	static Worker workers[MAX_THREADS];
+	pthread_barrier_t barrier;
+
+	failures = 0;
+	pthread_barrier_init( &barrier, NULL, (unsigned int)threads );
+	for ( int t = 0; t < threads; ++t ) {
+		workers[t] = (Worker) { .Bench = bench, .Id = (uint64_t)t + 1, .Operations = operations, .Barrier = &barrier };
+		pthread_create( &handles[t], NULL, Check, &workers[t] );
+	}
+	for ( int t = 0; t < threads; ++t ) {
+		pthread_join( handles[t], NULL );
+	}
+	pthread_barrier_destroy( &barrier );
+
+	// Objects left in the exchange go back directly, every cache is detached by now
+	Worker main = { .Bench = BENCH_POOL_CONCURRENT };
+	for ( size_t i = 0; i < EXCHANGE; ++i ) {
+		if ( exchange[i] ) {
+			CheckRelease( &main, exchange[i] );
+			exchange[i] = NULL;
+		}
+	}
+	size_t leaked = PoolConcurrentSlotsInUse( &cpool );
+	if ( leaked ) {
+		fprintf( stderr, "%zu slots still in use\n", leaked );
+		failures++;
+	}
+	printf( "%-16s %8d %12s\n", bstring[bench], threads, failures ? "FAILED" : "ok" );
+	return !failures;
+}
+
+static double Measure( Benchmark bench, int threads, size_t operations ) {
+	pthread_t handles[MAX_THREADS];
+	static Worker workers[MAX_THREADS];
+	pthread_barrier_t barrier;
+
+	pthread_barrier_init( &barrier, NULL, (unsigned int)threads + 1 );
+	for ( int t = 0; t < threads; ++t ) {
+		workers[t] = (Worker) { .Bench = bench, .Operations = operations, .Barrier = &barrier };
+		pthread_create( &handles[t], NULL, Work, &workers[t] );
+	}
+
+	double begin = Now();
+	pthread_barrier_wait( &barrier );
+	for ( int t = 0; t < threads; ++t ) {
+		pthread_join( handles[t], NULL );
+	}
+	double end = Now();
+
+	pthread_barrier_destroy( &barrier );
+	return end - begin;
+}
+
+int main( int argc, char ** argv ) {
+	bool check = argc > 1 && !strcmp( argv[1], "--check" );
+	int arg = check ? 2 : 1;
+	size_t operations = argc > arg ? (size_t)strtoull( argv[arg], NULL, 10 ) : OPERATIONS;
+	// Thread caches hold up to a full magazine besides the burst
+	size_t capacity = (size_t)MAX_THREADS * (BURST + MMEM_CACHE_MAGAZINE);
+
+	if ( check ) {
+		// Slots of every check object, including the ones waiting in the exchange
+		cpool = PoolConcurrentCreate( sizeof( CheckStruct ), capacity + EXCHANGE );
+		owners = calloc( capacity + EXCHANGE, sizeof( uint64_t ) );
+		if ( !cpool.Raw || !owners ) {
+			fprintf( stderr, "Out of memory\n" );
+			return EXIT_FAILURE;
+		}
+
+		printf( "%-16s %8s %12s\n", "Check", "Threads", "Result" );
+		bool passed = true;
+		for ( Benchmark bench = BENCH_POOL_CONCURRENT; bench <= BENCH_POOL_CACHE; ++bench ) {
+			for ( int step = 1; step < THREAD_STEPS; ++step ) {
+				passed &= Verify( bench, bthreads[step], operations );
+			}
+		}
+		free( owners );
+		PoolConcurrentDestroy( &cpool );
+		return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	pool = PoolCreate( sizeof( TestStruct ), capacity );
+	cpool = PoolConcurrentCreate( sizeof( TestStruct ), capacity );
+
+	FILE * f = fopen( "concurrent.bench.csv", "w+" );
+	if ( f ) {
+		fprintf( f, "Benchmark;Threads;Seconds;Operations;Throughput" );
+	}
+	printf( "%-16s %8s %12s %16s\n", "Benchmark", "Threads", "Seconds", "Ops/s" );
+
+	for ( Benchmark bench = 0; bench < BENCH_TOTAL; ++bench ) {
+		for ( int step = 0; step < THREAD_STEPS; ++step ) {
+			int threads = bthreads[step];
+			double seconds = Measure( bench, threads, operations );
+			// One operation is an allocation followed by its release
+			double total = (double)operations * threads;
+			printf( "%-16s %8d %12lf %16.0lf\n", bstring[bench], threads, seconds, total / seconds );
+			if ( f ) {
+				fprintf( f, "\n%s;%d;%lf;%.0lf;%.0lf", bstring[bench], threads, seconds, total, total / seconds );
+			}
+		}
+	}
+
+	if ( f ) {
+		fclose( f );
+	}
+	PoolConcurrentDestroy( &cpool );
+	PoolDestroy( &pool );
+	return EXIT_SUCCESS;
+}
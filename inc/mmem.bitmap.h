@@ -0,0 +1,191 @@
+#ifndef MMEM_BITMAP_H
+#define MMEM_BITMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mmem.compiler.h"
+
+/*
+ * Occupancy bitmap of the pools, internal to the library and the typed pools of mmem.typed.h.
+ * Programs including mmem.typed.h see every name of it, so every name carries the prefix of the library.
+ */
+
+typedef uint64_t MemoryBitmapWord;
+#define MMEM_BITMAP_WORD_BITS  64
+#define MMEM_BITMAP_WORD_SHIFT 6
+#define MMEM_BITMAP_WORD_FULL  (~(MemoryBitmapWord)0)
+
+/// @brief Levels needed to summarize any size_t bit count into a single word
+#define MMEM_BITMAP_LEVELS_MAX 11
+
+/**
+ * Hierarchical occupancy map. Level 0 holds one bit per slot (set = used), every higher level holds one bit per word
+ * of the level below (set = word full). The top level is a single word, so finding the lowest free slot costs one
+ * count-trailing-zeros per level. Padding bits beyond the tracked range are set and never handed out.
+ */
+typedef struct {
+	size_t Bits;
+	size_t Levels;
+	MemoryBitmapWord * Level[MMEM_BITMAP_LEVELS_MAX];
+} MemoryBitmap;
+
+static inline MemoryBitmapWord MemoryBitmapMask( size_t bit ) {
+	return (MemoryBitmapWord)1 << ( bit & (MMEM_BITMAP_WORD_BITS - 1) );
+}
+
+static inline size_t MemoryBitmapWordOf( size_t bit ) {
+	return bit >> MMEM_BITMAP_WORD_SHIFT;
+}
+
+static inline size_t MemoryBitmapWords( size_t bits ) {
+	return (bits + MMEM_BITMAP_WORD_BITS - 1) >> MMEM_BITMAP_WORD_SHIFT;
+}
+
+static inline size_t MemoryBitmapLevels( size_t bits, size_t * words ) {
+	size_t levels = 0;
+	size_t count = MemoryBitmapWords( bits ) ? MemoryBitmapWords( bits ) : 1;
+	*words = 0;
+	for ( ;; ) {
+		*words += count;
+		levels++;
+		if ( count == 1 ) {
+			return levels;
+		}
+		count = MemoryBitmapWords( count );
+	}
+}
+
+static inline size_t MemoryBitmapBytes( size_t bits ) {
+	size_t words = 0;
+	MemoryBitmapLevels( bits, &words );
+	return sizeof( MemoryBitmap ) + words * sizeof( MemoryBitmapWord );
+}
+
+static inline void MemoryBitmapClearAll( MemoryBitmap * map ) {
+	size_t count = map->Bits;
+	memset( map->Level[0], 0x00, (size_t)((char *)(map->Level[map->Levels - 1] + 1) - (char *)map->Level[0]) );
+
+	// Mark padding as used on every level, so it is never found and full words summarize correctly
+	for ( size_t level = 0; level < map->Levels; ++level ) {
+		size_t words = MemoryBitmapWords( count ) ? MemoryBitmapWords( count ) : 1;
+		for ( size_t bit = count; bit < words * MMEM_BITMAP_WORD_BITS; ++bit ) {
+			map->Level[level][MemoryBitmapWordOf( bit )] |= MemoryBitmapMask( bit );
+		}
+		if ( level + 1 < map->Levels ) {
+			for ( size_t word = 0; word < words; ++word ) {
+				if ( map->Level[level][word] == MMEM_BITMAP_WORD_FULL ) {
+					map->Level[level + 1][MemoryBitmapWordOf( word )] |= MemoryBitmapMask( word );
+				}
+			}
+		}
+		count = words;
+	}
+}
+
+static inline MemoryBitmap * MemoryBitmapInit( void * memory, size_t bits ) {
+	MemoryBitmap * map = memory;
+	if ( !map ) {
+		return NULL;
+	}
+
+	size_t words = 0;
+	size_t count = MemoryBitmapWords( bits ) ? MemoryBitmapWords( bits ) : 1;
+	MemoryBitmapWord * level = (MemoryBitmapWord *)(map + 1);
+
+	map->Bits = bits;
+	map->Levels = MemoryBitmapLevels( bits, &words );
+	for ( size_t i = 0; i < map->Levels; ++i ) {
+		map->Level[i] = level;
+		level += count;
+		count = MemoryBitmapWords( count );
+	}
+
+	MemoryBitmapClearAll( map );
+	return map;
+}
+
+static inline void MemoryBitmapSet( MemoryBitmap * map, size_t bit ) {
+	for ( size_t level = 0; level < map->Levels; ++level ) {
+		MemoryBitmapWord * word = &map->Level[level][MemoryBitmapWordOf( bit )];
+		*word |= MemoryBitmapMask( bit );
+		if ( *word != MMEM_BITMAP_WORD_FULL ) {
+			return;
+		}
+		bit = MemoryBitmapWordOf( bit );
+	}
+}
+
+static inline void MemoryBitmapClear( MemoryBitmap * map, size_t bit ) {
+	for ( size_t level = 0; level < map->Levels; ++level ) {
+		MemoryBitmapWord * word = &map->Level[level][MemoryBitmapWordOf( bit )];
+		int full = *word == MMEM_BITMAP_WORD_FULL;
+		*word &= ~MemoryBitmapMask( bit );
+		if ( !full ) {
+			return;
+		}
+		bit = MemoryBitmapWordOf( bit );
+	}
+}
+
+/// @brief Sets every bit of mask in one level 0 word, summarizing the word upwards once it is full
+static inline void MemoryBitmapSetWord( MemoryBitmap * map, size_t word, MemoryBitmapWord mask ) {
+	map->Level[0][word] |= mask;
+	for ( size_t level = 1; level < map->Levels && map->Level[level - 1][word] == MMEM_BITMAP_WORD_FULL; ++level ) {
+		map->Level[level][MemoryBitmapWordOf( word )] |= MemoryBitmapMask( word );
+		word = MemoryBitmapWordOf( word );
+	}
+}
+
+/// @brief Clears every bit of mask in one level 0 word, the word is no longer full in the levels above
+static inline void MemoryBitmapClearWord( MemoryBitmap * map, size_t word, MemoryBitmapWord mask ) {
+	int full = map->Level[0][word] == MMEM_BITMAP_WORD_FULL;
+	map->Level[0][word] &= ~mask;
+	for ( size_t level = 1; level < map->Levels && full; ++level ) {
+		MemoryBitmapWord * summary = &map->Level[level][MemoryBitmapWordOf( word )];
+		full = *summary == MMEM_BITMAP_WORD_FULL;
+		*summary &= ~MemoryBitmapMask( word );
+		word = MemoryBitmapWordOf( word );
+	}
+}
+
+static inline int MemoryBitmapTest( MemoryBitmap const * map, size_t bit ) {
+	return ( map->Level[0][MemoryBitmapWordOf( bit )] & MemoryBitmapMask( bit ) ) != 0;
+}
+
+/// @brief Finds the lowest clear bit, SIZE_MAX if every bit is set
+static inline size_t MemoryBitmapFind( MemoryBitmap const * map ) {
+	size_t level = map->Levels - 1;
+	size_t bit = 0;
+
+	if ( map->Level[level][0] == MMEM_BITMAP_WORD_FULL ) {
+		return SIZE_MAX;
+	}
+
+	for ( ;; ) {
+		bit = (bit << MMEM_BITMAP_WORD_SHIFT) | MMEM_CTZ64( ~map->Level[level][bit] );
+		if ( level == 0 ) {
+			return bit;
+		}
+		level--;
+	}
+}
+
+/// @brief Finds the highest set bit with an index lower than below, SIZE_MAX if none is set
+static inline size_t MemoryBitmapLast( MemoryBitmap const * map, size_t below ) {
+	while ( below ) {
+		size_t word = MemoryBitmapWordOf( below - 1 );
+		MemoryBitmapWord used = map->Level[0][word];
+		if ( ( below & (MMEM_BITMAP_WORD_BITS - 1) ) ) {
+			used &= MemoryBitmapMask( below ) - 1;
+		}
+		if ( used ) {
+			return (word << MMEM_BITMAP_WORD_SHIFT) | (MMEM_BITMAP_WORD_BITS - 1 - MMEM_CLZ64( used ));
+		}
+		below = word << MMEM_BITMAP_WORD_SHIFT;
+	}
+	return SIZE_MAX;
+}
+
+#endif // MMEM_BITMAP_H
@@ -1,6 +1,8 @@
 #ifndef MMEM_COMPILER_H
 #define MMEM_COMPILER_H
 
+#include <stdint.h>
+
 #if defined( _MSC_VER )
     #define MMEM_ALIGNED( alignment ) __declspec( align( alignment ) )
 #elif defined( __GNUC__ ) || defined( __clang__ )
@@ -9,4 +11,183 @@
     #define MMEM_ALIGNED( alignment ) /* no-op */
 #endif
 
+#if defined( __STDC_VERSION__ ) && __STDC_VERSION__ >= 201112L
+    #define MMEM_ALIGNOF( type ) _Alignof( type )
+#elif defined( _MSC_VER )
+    #define MMEM_ALIGNOF( type ) __alignof( type )
+#elif defined( __GNUC__ ) || defined( __clang__ )
+    #define MMEM_ALIGNOF( type ) __alignof__( type )
+#else
+    #include <stddef.h>
+    #define MMEM_ALIGNOF( type ) offsetof( struct { char c; type t; }, t )
+#endif
+
+#if defined( _MSC_VER )
+    #include <intrin.h>
+    static __forceinline unsigned int MmemCountTrailingZeros64( uint64_t value ) {
+        unsigned long index;
+        _BitScanForward64( &index, value );
+        return (unsigned int)index;
+    }
+    #define MMEM_CTZ64( value ) MmemCountTrailingZeros64( value )
+#elif defined( __GNUC__ ) || defined( __clang__ )
+    #define MMEM_CTZ64( value ) ((unsigned int)__builtin_ctzll( value ))
+#else
+    static inline unsigned int MmemCountTrailingZeros64( uint64_t value ) {
+        unsigned int count = 0;
+        while ( !( value & 1 ) ) {
+            value >>= 1;
+            count++;
+        }
+        return count;
+    }
+    #define MMEM_CTZ64( value ) MmemCountTrailingZeros64( value )
+#endif
+
+#if defined( _MSC_VER )
+    static __forceinline unsigned int MmemCountLeadingZeros64( uint64_t value ) {
+        unsigned long index;
+        _BitScanReverse64( &index, value );
+        return 63u - (unsigned int)index;
+    }
+    #define MMEM_CLZ64( value ) MmemCountLeadingZeros64( value )
+#elif defined( __GNUC__ ) || defined( __clang__ )
+    #define MMEM_CLZ64( value ) ((unsigned int)__builtin_clzll( value ))
+#else
+    static inline unsigned int MmemCountLeadingZeros64( uint64_t value ) {
+        unsigned int count = 0;
+        while ( !( value & 0x8000000000000000ULL ) ) {
+            value <<= 1;
+            count++;
+        }
+        return count;
+    }
+    #define MMEM_CLZ64( value ) MmemCountLeadingZeros64( value )
+#endif
+
+#if defined( _MSC_VER )
+    static __forceinline unsigned int MmemPopCount64( uint64_t value ) {
+        return (unsigned int)__popcnt64( value );
+    }
+    #define MMEM_POPCOUNT64( value ) MmemPopCount64( value )
+#elif ( defined( __GNUC__ ) || defined( __clang__ ) ) && defined( __POPCNT__ )
+    #define MMEM_POPCOUNT64( value ) ((unsigned int)__builtin_popcountll( value ))
+#else
+    /* Without a popcnt instruction the builtin needs libgcc, which is not linked (-nodefaultlibs) */
+    static inline unsigned int MmemPopCount64( uint64_t value ) {
+        value = value - ( ( value >> 1 ) & 0x5555555555555555ULL );
+        value = ( value & 0x3333333333333333ULL ) + ( ( value >> 2 ) & 0x3333333333333333ULL );
+        value = ( value + ( value >> 4 ) ) & 0x0F0F0F0F0F0F0F0FULL;
+        return (unsigned int)( ( value * 0x0101010101010101ULL ) >> 56 );
+    }
+    #define MMEM_POPCOUNT64( value ) MmemPopCount64( value )
+#endif
+
+#if defined( _MSC_VER ) && ( defined( _M_X64 ) || defined( _M_IX86 ) )
+    #include <xmmintrin.h>
+    #define MMEM_PREFETCH( address ) _mm_prefetch( (char const *)(address), _MM_HINT_T0 )
+#elif defined( __GNUC__ ) || defined( __clang__ )
+    #define MMEM_PREFETCH( address ) __builtin_prefetch( (address), 0, 3 )
+#else
+    #define MMEM_PREFETCH( address ) ((void)(address))
+#endif
+
+#if defined( _MSC_VER )
+    #define MMEM_NOINLINE __declspec( noinline )
+#elif defined( __GNUC__ ) || defined( __clang__ )
+    #define MMEM_NOINLINE __attribute__(( noinline ))
+#else
+    #define MMEM_NOINLINE /* no-op */
+#endif
+
+#if defined( __STDC_VERSION__ ) && __STDC_VERSION__ >= 201112L && !defined( __STDC_NO_THREADS__ )
+    #define MMEM_THREAD_LOCAL _Thread_local
+#elif defined( _MSC_VER )
+    #define MMEM_THREAD_LOCAL __declspec( thread )
+#elif defined( __GNUC__ ) || defined( __clang__ )
+    #define MMEM_THREAD_LOCAL __thread
+#else
+    #define MMEM_THREAD_LOCAL /* no thread local storage, single threaded use only */
+#endif
+
+/*
+ * Atomic operations on naturally aligned 64 bit integers and pointers, following the C11 memory model.
+ * They map onto compiler intrinsics, so the library stays C99 compatible.
+ */
+#if defined( _MSC_VER )
+    #define MMEM_ATOMIC_LOAD( ptr ) ( _ReadWriteBarrier(), *(volatile uint64_t *)(ptr) )
+    #define MMEM_ATOMIC_STORE( ptr, value ) ( _ReadWriteBarrier(), (void)( *(volatile uint64_t *)(ptr) = (uint64_t)(value) ) )
+    #define MMEM_ATOMIC_FETCH_ADD( ptr, value ) ((uint64_t)_InterlockedExchangeAdd64( (volatile __int64 *)(ptr), (__int64)(value) ))
+    #define MMEM_ATOMIC_FETCH_SUB( ptr, value ) ((uint64_t)_InterlockedExchangeAdd64( (volatile __int64 *)(ptr), -(__int64)(value) ))
+    #define MMEM_ATOMIC_FETCH_OR( ptr, value ) ((uint64_t)_InterlockedOr64( (volatile __int64 *)(ptr), (__int64)(value) ))
+    #define MMEM_ATOMIC_FETCH_AND( ptr, value ) ((uint64_t)_InterlockedAnd64( (volatile __int64 *)(ptr), (__int64)(value) ))
+    #define MMEM_ATOMIC_EXCHANGE( ptr, value ) ((uint64_t)_InterlockedExchange64( (volatile __int64 *)(ptr), (__int64)(value) ))
+    static __forceinline int MmemAtomicCompareExchange( volatile uint64_t * ptr, uint64_t * expected, uint64_t desired ) {
+        __int64 previous = _InterlockedCompareExchange64( (volatile __int64 *)ptr, (__int64)desired, (__int64)*expected );
+        if ( (uint64_t)previous == *expected ) {
+            return 1;
+        }
+        *expected = (uint64_t)previous;
+        return 0;
+    }
+    #define MMEM_ATOMIC_CAS( ptr, expected, desired ) MmemAtomicCompareExchange( (volatile uint64_t *)(ptr), (uint64_t *)(expected), (uint64_t)(desired) )
+    #define MMEM_ATOMIC_LOAD_PTR( ptr ) ( _ReadWriteBarrier(), *(void * volatile *)(ptr) )
+    #define MMEM_ATOMIC_EXCHANGE_PTR( ptr, value ) _InterlockedExchangePointer( (void * volatile *)(ptr), (value) )
+    static __forceinline int MmemAtomicCompareExchangePtr( void * volatile * ptr, void ** expected, void * desired ) {
+        void * previous = _InterlockedCompareExchangePointer( ptr, desired, *expected );
+        if ( previous == *expected ) {
+            return 1;
+        }
+        *expected = previous;
+        return 0;
+    }
+    #define MMEM_ATOMIC_CAS_PTR( ptr, expected, desired ) MmemAtomicCompareExchangePtr( (void * volatile *)(ptr), (void **)(expected), (desired) )
+    #define MMEM_ATOMIC_PAUSE() _mm_pause()
+#elif defined( __GNUC__ ) || defined( __clang__ )
+    #define MMEM_ATOMIC_LOAD( ptr ) __atomic_load_n( (ptr), __ATOMIC_ACQUIRE )
+    #define MMEM_ATOMIC_STORE( ptr, value ) __atomic_store_n( (ptr), (value), __ATOMIC_RELEASE )
+    #define MMEM_ATOMIC_FETCH_ADD( ptr, value ) __atomic_fetch_add( (ptr), (value), __ATOMIC_ACQ_REL )
+    #define MMEM_ATOMIC_FETCH_SUB( ptr, value ) __atomic_fetch_sub( (ptr), (value), __ATOMIC_ACQ_REL )
+    #define MMEM_ATOMIC_FETCH_OR( ptr, value ) __atomic_fetch_or( (ptr), (value), __ATOMIC_ACQ_REL )
+    #define MMEM_ATOMIC_FETCH_AND( ptr, value ) __atomic_fetch_and( (ptr), (value), __ATOMIC_ACQ_REL )
+    #define MMEM_ATOMIC_EXCHANGE( ptr, value ) __atomic_exchange_n( (ptr), (value), __ATOMIC_ACQ_REL )
+    #define MMEM_ATOMIC_CAS( ptr, expected, desired ) __atomic_compare_exchange_n( (ptr), (expected), (desired), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE )
+    #define MMEM_ATOMIC_LOAD_PTR( ptr ) __atomic_load_n( (ptr), __ATOMIC_ACQUIRE )
+    #define MMEM_ATOMIC_EXCHANGE_PTR( ptr, value ) __atomic_exchange_n( (ptr), (value), __ATOMIC_ACQ_REL )
+    #define MMEM_ATOMIC_CAS_PTR( ptr, expected, desired ) __atomic_compare_exchange_n( (ptr), (expected), (desired), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE )
+    #if defined( __x86_64__ ) || defined( __i386__ )
+        #define MMEM_ATOMIC_PAUSE() __builtin_ia32_pause()
+    #else
+        #define MMEM_ATOMIC_PAUSE() ((void)0)
+    #endif
+#else
+    /* No atomic operations known for this compiler, the concurrent types are limited to single threaded use */
+    #define MMEM_ATOMIC_LOAD( ptr ) (*(ptr))
+    #define MMEM_ATOMIC_STORE( ptr, value ) ((void)( *(ptr) = (value) ))
+    #define MMEM_ATOMIC_FETCH_ADD( ptr, value ) ( *(ptr) += (value), *(ptr) - (value) )
+    #define MMEM_ATOMIC_FETCH_SUB( ptr, value ) ( *(ptr) -= (value), *(ptr) + (value) )
+    static inline uint64_t MmemFetchOr( uint64_t * ptr, uint64_t value ) { uint64_t old = *ptr; *ptr |= value; return old; }
+    static inline uint64_t MmemFetchAnd( uint64_t * ptr, uint64_t value ) { uint64_t old = *ptr; *ptr &= value; return old; }
+    static inline uint64_t MmemExchange( uint64_t * ptr, uint64_t value ) { uint64_t old = *ptr; *ptr = value; return old; }
+    static inline int MmemCompareExchange( uint64_t * ptr, uint64_t * expected, uint64_t desired ) {
+        if ( *ptr == *expected ) { *ptr = desired; return 1; }
+        *expected = *ptr;
+        return 0;
+    }
+    static inline void * MmemExchangePtr( void ** ptr, void * value ) { void * old = *ptr; *ptr = value; return old; }
+    static inline int MmemCompareExchangePtr( void ** ptr, void ** expected, void * desired ) {
+        if ( *ptr == *expected ) { *ptr = desired; return 1; }
+        *expected = *ptr;
+        return 0;
+    }
+    #define MMEM_ATOMIC_FETCH_OR( ptr, value ) MmemFetchOr( (uint64_t *)(ptr), (value) )
+    #define MMEM_ATOMIC_FETCH_AND( ptr, value ) MmemFetchAnd( (uint64_t *)(ptr), (value) )
+    #define MMEM_ATOMIC_EXCHANGE( ptr, value ) MmemExchange( (uint64_t *)(ptr), (value) )
+    #define MMEM_ATOMIC_CAS( ptr, expected, desired ) MmemCompareExchange( (uint64_t *)(ptr), (uint64_t *)(expected), (desired) )
+    #define MMEM_ATOMIC_LOAD_PTR( ptr ) (*(ptr))
+    #define MMEM_ATOMIC_EXCHANGE_PTR( ptr, value ) MmemExchangePtr( (void **)(ptr), (value) )
+    #define MMEM_ATOMIC_CAS_PTR( ptr, expected, desired ) MmemCompareExchangePtr( (void **)(ptr), (void **)(expected), (desired) )
+    #define MMEM_ATOMIC_PAUSE() ((void)0)
+#endif
+
 #endif // MMEM_COMPILER_H
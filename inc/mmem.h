@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "mmem.compiler.h"
 
@@ -27,7 +28,11 @@
 #endif
 #ifndef MMEM_ALIGNMENT_CACHEL1
 /// @brief Size of the expected L1 cache in bytes
-#define MMEM_ALIGNMENT_CACHEL1 (16 * MMEM_KB_FACTOR);
+#define MMEM_ALIGNMENT_CACHEL1 (16 * MMEM_KB_FACTOR)
+#endif
+#ifndef MMEM_ZERO_STREAM_MIN
+/// @brief Number of bytes from which ranges are zeroed with non-temporal stores, which do not evict the working set
+#define MMEM_ZERO_STREAM_MIN (256 * MMEM_KB_FACTOR)
 #endif
 
 #define MMEM_ZERO_POLICY_ONALLOCATE 0
@@ -54,19 +59,206 @@
 #define MMEM_STRUCT typedef struct
 #endif
 
+#define MMEM_POOL_MODE_BITMAP   0
+#define MMEM_POOL_MODE_FREELIST 1
+
+// Per-instance policies of the creation options, 0 selects the compile-time policy
+#define MMEM_ZERO_DEFAULT    0
+#define MMEM_ZERO_ONALLOCATE 1
+#define MMEM_ZERO_ONRELEASE  2
+#define MMEM_ZERO_MANUAL     3
+
+#define MMEM_ALIGN_DEFAULT   0
+#define MMEM_ALIGN_NONE      1
+#define MMEM_ALIGN_CACHELINE 2
+
+#ifndef MMEM_SLAB_SIZE_DEFAULT
+/// @brief Default number of bytes per slab of a growable pool (power of two)
+#define MMEM_SLAB_SIZE_DEFAULT (64 * MMEM_KB_FACTOR)
+#endif
+#ifndef MMEM_CACHE_MAGAZINE
+/// @brief Number of free slots a thread cache holds before it flushes half of them back to the pool
+#define MMEM_CACHE_MAGAZINE 128
+#endif
+#ifndef MMEM_CACHE_MAX
+/// @brief Maximum number of thread caches attached to one concurrent pool at the same time
+#define MMEM_CACHE_MAX 256
+#endif
+#ifndef MMEM_ARENA_COMMIT_CHUNK
+/// @brief Number of bytes a virtual arena commits at once when its committed memory is exhausted (power of two, at least a page)
+#define MMEM_ARENA_COMMIT_CHUNK (64 * MMEM_KB_FACTOR)
+#endif
+#ifndef MMEM_ITERATE_PREFETCH
+/// @brief Number of slots the pool iterators prefetch ahead of the visited slot
+#define MMEM_ITERATE_PREFETCH 8
+#endif
+/// @brief Minimal alignment of stack allocations in bytes, the size of the header in front of every allocation
+#define MMEM_STACK_ALIGNMENT (2 * sizeof( size_t ))
+#ifndef MMEM_HANDLE_INDEX_BITS
+/// @brief Number of low handle bits holding the table index, the remaining bits of the 32 bit handle hold the generation
+#define MMEM_HANDLE_INDEX_BITS 20
+#endif
+#define MMEM_HANDLE_INDEX_MASK ((uint32_t)((1ull << MMEM_HANDLE_INDEX_BITS) - 1))
+#define MMEM_HANDLE_GENERATION_MASK ((uint32_t)(0xFFFFFFFFull >> MMEM_HANDLE_INDEX_BITS))
+/// @brief Handle never handed out, returned when an allocation fails
+#define MMEM_HANDLE_NULL 0
+/// @brief Number of size classes of a heap
+#define MMEM_HEAP_CLASSES 32
+/// @brief Largest size in bytes served by the size classes of a heap, larger sizes are allocated directly
+#define MMEM_HEAP_SMALL_MAX 4096
+/// @brief Pattern mixed into the tag in front of large heap objects
+#define MMEM_HEAP_LARGE_TAG 0x6D6D656D4C617267ull
+/// @brief Slab policy value to keep every empty slab until the pool is trimmed or destroyed
+#define MMEM_SLAB_KEEP_ALL ((size_t)-1)
+#ifndef MMEM_STATS
+/// @brief Maintain allocation statistics and the statistics registry (0/1), the library and its users must agree on it
+#define MMEM_STATS 0
+#endif
+/// @brief Number of buckets of the scan length histogram, bucket n > 0 counts scans of [2^(n-1), 2^n) bitmap words
+#define MMEM_STATS_SCAN_BUCKETS 16
+
+#define MMEM_STATS_POOL  1
+#define MMEM_STATS_ARENA 2
+
+#ifndef MMEM_PROFILE
+/// @brief Build the sampling allocation profiler (0/1), the library and its users must agree on it
+#define MMEM_PROFILE 0
+#endif
+#ifndef MMEM_PROFILE_RATE
+/// @brief Default mean number of bytes allocated by a profiled instance between two samples
+#define MMEM_PROFILE_RATE (512 * MMEM_KB_FACTOR)
+#endif
+#ifndef MMEM_PROFILE_DEPTH
+/// @brief Maximum number of return addresses recorded per call site
+#define MMEM_PROFILE_DEPTH 16
+#endif
+#ifndef MMEM_PROFILE_SITES
+/// @brief Number of call sites a profiled instance tells apart (power of two), samples of further sites are dropped
+#define MMEM_PROFILE_SITES 512
+#endif
+
+#define MMEM_PROFILE_LIVE  0
+#define MMEM_PROFILE_PEAK  1
+#define MMEM_PROFILE_PPROF 2
+
+#if MMEM_PROFILE
+/// @brief Tells if a pool or arena is profiled, constant false without MMEM_PROFILE
+#define MMEM_PROFILED( instance ) ( (instance)->Profile != NULL )
+#else
+#define MMEM_PROFILED( instance ) 0
+#endif
+
 typedef void * (*AllocateFct)( size_t const element_size, size_t const capacity );
 typedef void (*ReleaseFct)( void * memory );
+typedef void (*VisitFct)( void * element, void * context );
+typedef void (*RelocateFct)( void * from, void * to, void * context );
+
+/// @brief Reference to an object of a MemoryHandlePool, the table index in the low and the generation in the high bits
+typedef uint32_t MemoryHandle;
+
+/// @brief Page size of explicit 2 MB huge pages
+#define MMEM_PAGE_2M (2 * MMEM_MB_FACTOR)
+/// @brief Page size of explicit 1 GB huge pages
+#define MMEM_PAGE_1G (1 * MMEM_GB_FACTOR)
+
+#define MMEM_NUMA_NONE       0
+#define MMEM_NUMA_LOCAL      1
+#define MMEM_NUMA_BIND       2
+#define MMEM_NUMA_INTERLEAVE 3
+
+struct MemoryProvider;
+
+typedef void * (*ProviderAllocateFct)( struct MemoryProvider const * provider, size_t const size );
+typedef void (*ProviderReleaseFct)( struct MemoryProvider const * provider, void * memory, size_t const size );
+
+/**
+ * @brief Source of backing memory, which unlike AllocateFct/ReleaseFct receives the size and itself on release.
+ * @details A zeroed provider selects the allocation functions of the library. Custom providers may keep their state
+ * in Context, the remaining members configure the built-in providers.
+ */
+typedef struct MemoryProvider {
+	/// @brief Pointer to the function to allocate memory of the given size
+	ProviderAllocateFct Allocate;
+	/// @brief Pointer to the function to release memory, receiving the size it was allocated with
+	ProviderReleaseFct Release;
+	/// @brief User data of custom providers
+	void * Context;
+	/// @brief Page size of explicit huge pages (MMEM_PAGE_2M/MMEM_PAGE_1G), 0 for regular pages
+	size_t PageSize;
+	/// @brief Advise the kernel to back the memory with transparent huge pages
+	bool Transparent;
+	/// @brief NUMA placement policy ( MMEM_NUMA_NONE/MMEM_NUMA_LOCAL/MMEM_NUMA_BIND/MMEM_NUMA_INTERLEAVE )
+	unsigned int Numa;
+	/// @brief Mask of the NUMA nodes to bind or interleave to, 0 for every node
+	uint64_t Nodes;
+} MemoryProvider;
+
+/**
+ * @brief Counters of a pool or arena, maintained when the library is built with MMEM_STATS
+ */
+typedef struct {
+	/// @brief Number of successful allocations
+	uint64_t Allocations;
+	/// @brief Number of released slots of a pool, or rewinds of an arena
+	uint64_t Releases;
+	/// @brief Number of allocations that failed for lack of memory
+	uint64_t Failures;
+	/// @brief Number of resets
+	uint64_t Resets;
+	/// @brief Number of times an arena entered another block or committed further memory
+	uint64_t Grows;
+	/// @brief Highest number of slots (pools) or bytes (arenas) in use at once
+	uint64_t Peak;
+	/// @brief Number of bytes zeroed on allocation, release and reset
+	uint64_t BytesZeroed;
+	/// @brief Histogram of bitmap words read per pool allocation, bucket 0 counts allocations without a scan
+	uint64_t Scans[MMEM_STATS_SCAN_BUCKETS];
+} MemoryCounters;
+
+/**
+ * @brief Statistics of a pool or arena and its link in the statistics registry
+ */
+typedef struct MemoryStats {
+	/// @brief Counters of the instance
+	MemoryCounters Counters;
+	/// @brief Name the instance was registered with, NULL if it is not registered
+	char const * Name;
+	/// @brief Kind of the instance ( MMEM_STATS_POOL/MMEM_STATS_ARENA )
+	unsigned int Kind;
+	/// @brief Instance the statistics belong to, NULL if it is not registered
+	void * Owner;
+	/// @brief Previous registered instance
+	struct MemoryStats * Prev;
+	/// @brief Next registered instance
+	struct MemoryStats * Next;
+} MemoryStats;
+
+/**
+ * @brief Copy of the statistics of a registered instance, taken with StatsSnapshot
+ */
+typedef struct {
+	/// @brief Name the instance was registered with
+	char const * Name;
+	/// @brief Kind of the instance ( MMEM_STATS_POOL/MMEM_STATS_ARENA )
+	unsigned int Kind;
+	/// @brief Counters of the instance
+	MemoryCounters Counters;
+	/// @brief Number of slots (pools) or bytes (arenas) in use
+	size_t InUse;
+	/// @brief Number of slots (pools) or bytes (arenas) available in total
+	size_t Capacity;
+} MemoryStatsSnapshot;
 
 /**
  * @brief Memory Pool state structure.
  * @details Refrain from accessing members directly unless you know what you do!
  */
-MMEM_STRUCT {
+MMEM_STRUCT MemoryPool {
 	/// @brief Number of slots used in this pool
 	size_t Used;
-	/// @brief Active cursor for searching available slots
+	/// @brief Number of leading slots touched since the last reset (high-water mark)
 	size_t Cursor;
-	/// @brief Anonymous List of slot states( USED/UNUSED )
+	/// @brief Anonymous hierarchical bitmap of slot states( USED/UNUSED )
 	void * List;
 	/// @brief Raw chunk of memory owned by this pool
 	void * Raw;
@@ -76,19 +268,488 @@ MMEM_STRUCT {
 	size_t Capacity;
 	/// @brief Pointer to a function that will be used to deallocate the memory block
 	void (*Release)( void * chunk );
+	/// @brief Slot search strategy of this pool ( MMEM_POOL_MODE_BITMAP/MMEM_POOL_MODE_FREELIST )
+	unsigned int Mode;
+	/// @brief Head of the embedded list of released slots (free list mode only)
+	void * Free;
+	/// @brief Memory returned by the allocate function, Raw may be aligned above it
+	void * Base;
+	/// @brief Provider of the memory block, a zeroed provider if Release is used instead
+	MemoryProvider Provider;
+	/// @brief Number of bytes allocated from the provider
+	size_t Bytes;
+	/// @brief Zero policy of this pool ( MMEM_ZERO_POLICY_ONALLOCATE/MMEM_ZERO_POLICY_ONRELEASE/MMEM_ZERO_POLICY_MANUAL )
+	unsigned int ZeroPolicy;
+	/// @brief Alignment policy flags of this pool ( MMEM_ALIGNMENT_POLICY_* )
+	unsigned int AlignmentPolicy;
+	/// @brief Allocation routine specialized for the mode and zero policy of this pool
+	void * (*AllocateSlot)( struct MemoryPool * pool );
+	/// @brief Release routine specialized for the mode and zero policy of this pool
+	void (*ReleaseSlot)( struct MemoryPool * pool, void * element );
+#if MMEM_STATS
+	/// @brief Counters of this pool and its link in the statistics registry
+	MemoryStats Stats;
+#endif
+#if MMEM_PROFILE
+	/// @brief Sampling state of the profiler, NULL unless the pool is profiled
+	struct MemoryProfile * Profile;
+#endif
 } MemoryPool;
 
+/**
+ * @brief Options to create a pool with, a zeroed structure selects the defaults of PoolCreate
+ */
+typedef struct {
+	/// @brief Slot search strategy ( MMEM_POOL_MODE_BITMAP/MMEM_POOL_MODE_FREELIST )
+	unsigned int Mode;
+	/// @brief Keep the slot state list in free list mode to reject foreign and double released pointers
+	bool Validate;
+	/// @brief Alignment of every slot in bytes (power of two), 0 for none
+	size_t Alignment;
+	/// @brief Provider of the pool memory
+	MemoryProvider Provider;
+	/// @brief Zero policy of the pool ( MMEM_ZERO_DEFAULT/MMEM_ZERO_ONALLOCATE/MMEM_ZERO_ONRELEASE/MMEM_ZERO_MANUAL )
+	unsigned int ZeroPolicy;
+	/// @brief Alignment of the pool memory ( MMEM_ALIGN_DEFAULT/MMEM_ALIGN_NONE/MMEM_ALIGN_CACHELINE )
+	unsigned int AlignmentPolicy;
+} MemoryPoolOptions;
+
+/**
+ * @brief Position of an iteration over the objects allocated in a pool, see PoolIterate
+ * @details Refrain from accessing members directly unless you know what you do!
+ */
+typedef struct {
+	/// @brief Occupancy words of the pool, one bit per slot (set = used)
+	uint64_t const * Bits;
+	/// @brief Raw chunk of memory of the pool
+	char * Raw;
+	/// @brief Size of the element type managed by the pool in bytes
+	size_t ElementSize;
+	/// @brief Index of the current occupancy word
+	size_t Word;
+	/// @brief Index of the occupancy word the iteration ends at
+	size_t Words;
+	/// @brief Mask of the slots of the last word below the high-water mark
+	uint64_t Tail;
+	/// @brief Used slots of the current word not visited yet
+	uint64_t Live;
+} MemoryPoolIterator;
+
+/**
+ * @brief Entry of the handle table of a MemoryHandlePool
+ */
+typedef struct {
+	/// @brief Slot of the object in the pool, the next unused entry while the entry is unused
+	uint32_t Slot;
+	/// @brief Generation of the handle currently valid, or of the next handle while the entry is unused
+	uint32_t Generation;
+} MemoryHandleEntry;
+
+/**
+ * @brief Memory Pool handing out generational handles instead of pointers.
+ * @details Handles refer to a table entry, which refers to the slot, so compaction moves objects behind the handles.
+ * Refrain from accessing members directly unless you know what you do!
+ */
 MMEM_STRUCT {
-	/// @brief Number of bytes used in this arena
+	/// @brief Pool of the objects
+	MemoryPool Pool;
+	/// @brief Handle table, indexed by the low bits of the handle
+	MemoryHandleEntry * Entries;
+	/// @brief Table index of the handle of every slot
+	uint32_t * Owners;
+	/// @brief First unused table entry, Capacity if none is left
+	uint32_t Unused;
+	/// @brief Number of table entries and slots
+	uint32_t Capacity;
+} MemoryHandlePool;
+
+struct MemorySlabPool;
+
+/**
+ * @brief Header at the start of every slab of a growable pool.
+ * @details Slabs are aligned to the slab size, so masking an object address yields its slab.
+ */
+MMEM_STRUCT MemorySlab {
+	/// @brief Pool managing the slots of this slab, its memory is located in the slab
+	MemoryPool Pool;
+	/// @brief Identity of the growable pool owning this slab
+	uint64_t Owner;
+	/// @brief Previous slab in the owners slab list
+	struct MemorySlab * Prev;
+	/// @brief Next slab in the owners slab list
+	struct MemorySlab * Next;
+	/// @brief Memory returned by the allocate function, the slab may be aligned above it
+	void * Base;
+} MemorySlab;
+
+/**
+ * @brief Growable Memory Pool state structure, chaining fixed size slabs.
+ * @details Slabs know their pool by its identity rather than its address, the pool may be moved or copied. Only one
+ * copy may be used afterwards.
+ * Refrain from accessing members directly unless you know what you do!
+ */
+MMEM_STRUCT MemorySlabPool {
+	/// @brief Number of slots used across all slabs
 	size_t Used;
+	/// @brief Number of slots across all slabs
+	size_t Capacity;
+	/// @brief Size of the element type managed by this pool in bytes
+	size_t ElementSize;
+	/// @brief Number of bytes per slab, a power of two slabs are aligned to
+	size_t SlabSize;
+	/// @brief Number of slots per slab
+	size_t SlabCapacity;
+	/// @brief Number of slabs owned by this pool
+	size_t Slabs;
+	/// @brief Number of slabs owned by this pool without any used slot
+	size_t EmptySlabs;
+	/// @brief Maximum number of slabs, 0 for unlimited growth
+	size_t MaxSlabs;
+	/// @brief Number of empty slabs kept for reuse before empty slabs are released ( MMEM_SLAB_KEEP_ALL )
+	size_t KeepEmpty;
+	/// @brief Identity stored in every slab of this pool, unique among all growable pools
+	uint64_t Id;
+	/// @brief Slabs with at least one unused slot, allocations are served from the first one
+	MemorySlab * Partial;
+	/// @brief Slabs without unused slots
+	MemorySlab * Full;
+	/// @brief Pointer to a function that will be used to allocate slabs, NULL for the internal aligned allocation
+	AllocateFct Allocate;
+	/// @brief Pointer to a function that will be used to deallocate slabs
+	void (*Release)( void * chunk );
+} MemorySlabPool;
+
+/**
+ * @brief Header in front of a large heap object
+ * @details The tag is the last word of the header, directly in front of the object.
+ */
+MMEM_STRUCT MemoryHeapLarge {
+	/// @brief Previous large object of the heap
+	struct MemoryHeapLarge * Prev;
+	/// @brief Next large object of the heap
+	struct MemoryHeapLarge * Next;
+	/// @brief Number of bytes of the object
+	size_t Size;
+	/// @brief Address of the header mixed with MMEM_HEAP_LARGE_TAG, which tells large objects apart from pooled ones
+	uint64_t Tag;
+} MemoryHeapLarge;
+
+/**
+ * @brief General purpose heap state structure, serving small sizes from a growable pool per size class.
+ * @details Refrain from accessing members directly unless you know what you do!
+ */
+MMEM_STRUCT {
+	/// @brief Growable pool of every size class
+	MemorySlabPool Pools[MMEM_HEAP_CLASSES];
+	/// @brief Size class of every size rounded up to 8 bytes, indexed by (size + 7) / 8
+	uint8_t Classes[(MMEM_HEAP_SMALL_MAX >> 3) + 1];
+	/// @brief Number of bytes in large allocations
+	size_t LargeUsed;
+	/// @brief Large allocations, linked through the headers in front of them
+	MemoryHeapLarge * Large;
+	/// @brief Pointer to a function that will be used to allocate large objects, NULL for malloc
+	AllocateFct Allocate;
+	/// @brief Pointer to a function that will be used to deallocate large objects
+	void (*Release)( void * chunk );
+} MemoryHeap;
+
+/**
+ * @brief Queue of objects released to a thread cache by other threads
+ */
+MMEM_STRUCT {
+	/// @brief Most recently released object, objects are linked through their first bytes. Closed while no cache is attached
+	void * Head;
+	/// @brief Non-zero while a thread cache is attached under this id
+	uint64_t Attached;
+} MemoryPoolRemote;
+
+/**
+ * @brief Thread-safe Memory Pool state structure, slots are claimed lock-free from atomic bitmap words.
+ * @details Refrain from accessing members directly unless you know what you do!
+ */
+MMEM_STRUCT {
+	/// @brief Flat list of 64 bit slot state words( USED/UNUSED ), updated atomically
+	uint64_t * List;
+	/// @brief Number of words in the list
+	size_t Words;
 	/// @brief Raw chunk of memory owned by this pool
 	void * Raw;
-	/// @brief Maximum number of bytes managable by this arena
+	/// @brief Size of the element type managed by this pool in bytes
+	size_t ElementSize;
+	/// @brief Maximum number of elements managable by this pool
 	size_t Capacity;
 	/// @brief Pointer to a function that will be used to deallocate the memory block
 	void (*Release)( void * chunk );
+	/// @brief Id of the thread cache that last claimed slots of each word, 0 if none
+	uint64_t * Owners;
+	/// @brief Remote release queues of the thread caches, indexed by cache id ( 1 to MMEM_CACHE_MAX )
+	MemoryPoolRemote * Remotes;
+} MemoryPoolConcurrent;
+
+/**
+ * @brief Thread local front-end of a concurrent pool, to be used by one thread only.
+ * @details Refrain from accessing members directly unless you know what you do!
+ */
+MMEM_STRUCT {
+	/// @brief Concurrent pool the slots are claimed from
+	MemoryPoolConcurrent * Pool;
+	/// @brief Id of this cache in the pool, 0 while detached
+	size_t Id;
+	/// @brief Number of free slots in the magazine
+	size_t Count;
+	/// @brief Free slots owned by this cache, used last in, first out
+	void * Magazine[MMEM_CACHE_MAGAZINE];
+} MemoryPoolCache;
+
+/**
+ * @brief Header at the start of every block of memory owned by an arena
+ */
+MMEM_STRUCT MemoryArenaBlock {
+	/// @brief Next block in the chain, blocks after the current one are spare blocks
+	struct MemoryArenaBlock * Next;
+	/// @brief Number of bytes behind the header
+	size_t Capacity;
+	/// @brief Number of bytes used when the arena moved on to the next block
+	size_t Used;
+} MemoryArenaBlock;
+
+/**
+ * @brief Memory Arena state structure.
+ * @details Refrain from accessing members directly unless you know what you do!
+ */
+MMEM_STRUCT MemoryArena {
+	/// @brief Number of bytes used in the current block of this arena
+	size_t Used;
+	/// @brief Raw chunk of memory of the current block
+	void * Raw;
+	/// @brief Maximum number of bytes managable by the current block
+	size_t Capacity;
+	/// @brief Pointer to a function that will be used to deallocate the memory blocks
+	void (*Release)( void * chunk );
+	/// @brief Pointer to a function that will be used to allocate further memory blocks
+	AllocateFct Allocate;
+	/// @brief First block of the chain, it is kept for the whole lifetime of the arena
+	MemoryArenaBlock * First;
+	/// @brief Block allocations are currently served from
+	MemoryArenaBlock * Current;
+	/// @brief Number of bytes used in the blocks before the current one
+	size_t UsedBefore;
+	/// @brief Number of bytes in the spare blocks after the current one
+	size_t Spare;
+	/// @brief Factor applied to the current block capacity for the next block, 0 for a fixed arena
+	double Growth;
+	/// @brief Number of blocks after the first one kept as spare blocks on reset
+	size_t Retain;
+	/// @brief Number of bytes of address space reserved behind the header of a virtual arena, 0 for arenas of allocated blocks
+	size_t Reserved;
+	/// @brief Number of committed bytes a virtual arena keeps on reset and rewind
+	size_t Retained;
+	/// @brief Provider of the memory blocks, a zeroed provider if Allocate and Release are used instead
+	MemoryProvider Provider;
+	/// @brief Zero policy of this arena ( MMEM_ZERO_POLICY_ONALLOCATE/MMEM_ZERO_POLICY_ONRELEASE/MMEM_ZERO_POLICY_MANUAL )
+	unsigned int ZeroPolicy;
+	/// @brief Alignment policy flags of this arena ( MMEM_ALIGNMENT_POLICY_* )
+	unsigned int AlignmentPolicy;
+	/// @brief Allocation routine specialized for the zero policy of this arena
+	void * (*AllocateBytes)( struct MemoryArena * arena, size_t size );
+	/// @brief Aligned allocation routine specialized for the zero policy of this arena
+	void * (*AllocateAlignedBytes)( struct MemoryArena * arena, size_t size, size_t alignment );
+#if MMEM_STATS
+	/// @brief Counters of this arena and its link in the statistics registry
+	MemoryStats Stats;
+#endif
+#if MMEM_PROFILE
+	/// @brief Sampling state of the profiler, NULL unless the arena is profiled
+	struct MemoryProfile * Profile;
+#endif
 } MemoryArena;
 
+/**
+ * @brief Options to create an arena with, a zeroed structure selects the defaults of ArenaCreate
+ */
+typedef struct {
+	/// @brief Factor applied to the current block capacity for the next block, 0 for a fixed arena
+	double Growth;
+	/// @brief Number of blocks after the first one kept as spare blocks on reset
+	size_t Retain;
+	/// @brief Provider of the memory blocks
+	MemoryProvider Provider;
+	/// @brief Zero policy of the arena ( MMEM_ZERO_DEFAULT/MMEM_ZERO_ONALLOCATE/MMEM_ZERO_ONRELEASE/MMEM_ZERO_MANUAL )
+	unsigned int ZeroPolicy;
+	/// @brief Alignment of the arena blocks ( MMEM_ALIGN_DEFAULT/MMEM_ALIGN_NONE/MMEM_ALIGN_CACHELINE )
+	unsigned int AlignmentPolicy;
+} MemoryArenaOptions;
+
+/**
+ * @brief Position in an arena to rewind to, taken with ArenaMark
+ */
+typedef struct {
+	/// @brief Block the arena was allocating from
+	MemoryArenaBlock * Block;
+	/// @brief Number of bytes used in that block
+	size_t Used;
+	/// @brief Number of bytes used in the blocks before that block
+	size_t UsedBefore;
+} MemoryArenaMarker;
+
+/**
+ * @brief Temporary scope inside an arena, everything allocated within is dropped at its end
+ */
+typedef struct {
+	/// @brief Arena the scope belongs to, NULL once the scope ended
+	MemoryArena * Arena;
+	/// @brief Position of the arena when the scope began
+	MemoryArenaMarker Marker;
+} MemoryArenaTemp;
+
+/**
+ * @brief Memory Stack state structure, a single block allocated last in, first out from both of its ends
+ * @details Refrain from accessing members directly unless you know what you do!
+ */
+MMEM_STRUCT MemoryStack {
+	/// @brief Raw chunk of memory shared by both ends
+	void * Raw;
+	/// @brief Number of bytes managable by this stack
+	size_t Capacity;
+	/// @brief Number of bytes used from the bottom of the block
+	size_t Front;
+	/// @brief Number of bytes used from the top of the block
+	size_t Back;
+	/// @brief Offset of the most recent allocation from the bottom, 0 if there is none
+	size_t FrontTop;
+	/// @brief Offset of the most recent allocation from the top, 0 if there is none
+	size_t BackTop;
+	/// @brief Memory returned by the allocation function, Raw is aligned inside of it
+	void * Base;
+	/// @brief Pointer to a function that will be used to deallocate the memory block
+	void (*Release)( void * chunk );
+	/// @brief Zero policy of this stack ( MMEM_ZERO_POLICY_ONALLOCATE/MMEM_ZERO_POLICY_ONRELEASE/MMEM_ZERO_POLICY_MANUAL )
+	unsigned int ZeroPolicy;
+} MemoryStack;
+
+/**
+ * @brief Position of one end of a stack to rewind to, taken with StackMarkFront or StackMarkBack
+ */
+typedef struct {
+	/// @brief Number of bytes used from that end
+	size_t Used;
+	/// @brief Offset of the most recent allocation of that end
+	size_t Top;
+} MemoryStackMarker;
+
+/**
+ * @brief Usage of the frames of a frame arena, to size its sub-arenas and the number of frames
+ */
+typedef struct {
+	/// @brief Number of frames ended
+	uint64_t Frames;
+	/// @brief Number of bytes used by the last ended frame
+	uint64_t Last;
+	/// @brief Highest number of bytes used by a single frame
+	uint64_t Peak;
+	/// @brief Number of bytes used by all ended frames together
+	uint64_t Total;
+	/// @brief Number of calls to FrameBegin refused because the frame to reuse was not retired yet
+	uint64_t Stalls;
+} MemoryFrameStats;
+
+/**
+ * @brief Frame Arena state structure, a ring of arenas reused in turn by consecutive frames
+ * @details The producer thread begins, fills and ends the frames, consumer threads only retire them.
+ * Refrain from accessing members directly unless you know what you do!
+ */
+MMEM_STRUCT MemoryFrameArena {
+	/// @brief Sub-arenas of the frames, frame n allocates from Frames[n % Count]
+	MemoryArena * Frames;
+	/// @brief Number of sub-arenas
+	size_t Count;
+	/// @brief Number of the open frame, or of the next frame to begin
+	uint64_t Frame;
+	/// @brief Sub-arena of the open frame, NULL while no frame is open
+	MemoryArena * Current;
+	/// @brief Usage of the ended frames
+	MemoryFrameStats Stats;
+	/// @brief Number of frames retired by the consumers, every frame below it may be reclaimed, updated atomically
+	MMEM_ALIGNED( MMEM_ALIGNMENT_CACHELINE ) uint64_t Retired;
+} MemoryFrameArena;
+
+#if MMEM_PROFILE
+/**
+ * @brief Call stack of sampled allocations and the bytes attributed to it
+ * @details Bytes are estimates, every sample stands for its size divided by the probability it was sampled with.
+ */
+typedef struct {
+	/// @brief Return addresses of the call stack, innermost first
+	void * Frames[MMEM_PROFILE_DEPTH];
+	/// @brief Number of return addresses, 0 while the site is unused
+	size_t Depth;
+	/// @brief Hash of the return addresses
+	uint64_t Hash;
+	/// @brief Number of sampled allocations
+	uint64_t Samples;
+	/// @brief Number of bytes of the sampled allocations
+	uint64_t SampledBytes;
+	/// @brief Number of sampled allocations still alive
+	uint64_t LiveSamples;
+	/// @brief Number of bytes of the sampled allocations still alive
+	uint64_t LiveSampledBytes;
+	/// @brief Estimated number of bytes allocated
+	uint64_t Allocated;
+	/// @brief Estimated number of bytes alive
+	uint64_t Live;
+	/// @brief Highest estimated number of bytes alive at once
+	uint64_t Peak;
+} MemoryProfileSite;
+
+/**
+ * @brief Sampled allocation still alive
+ */
+typedef struct {
+	/// @brief Address of the allocation, NULL for an unused entry
+	void * Address;
+	/// @brief Offset of the last byte of the allocation in the bytes in use by the arena, 0 for pools
+	uint64_t Position;
+	/// @brief Number of bytes of the allocation
+	uint64_t Size;
+	/// @brief Estimated number of bytes the sample stands for
+	uint64_t Weight;
+	/// @brief Call site of the allocation
+	MemoryProfileSite * Site;
+} MemoryProfileSample;
+
+/**
+ * @brief Sampling state of a profiled pool or arena
+ * @details The profiled instance is bound to profiling routines specialized like its own ones, stopping binds it back.
+ * Refrain from accessing members directly unless you know what you do!
+ */
+typedef struct MemoryProfile {
+	/// @brief Name to report the instance with, it has to outlive the profile
+	char const * Name;
+	/// @brief Number of bytes left to allocate until the next sample
+	int64_t Countdown;
+	/// @brief State of the random number generator drawing the sampling intervals
+	uint64_t Random;
+	/// @brief Hash table of MMEM_PROFILE_SITES call sites, sites are never removed
+	MemoryProfileSite * Sites;
+	/// @brief Number of samples dropped because every site was taken or the sample table could not grow
+	uint64_t Dropped;
+	/// @brief Hash table of the live samples by address
+	MemoryProfileSample * Samples;
+	/// @brief Number of live samples
+	size_t Count;
+	/// @brief Number of entries in the sample table (power of two)
+	size_t Capacity;
+	/// @brief Lowest address sampled since the table was last empty
+	void * Low;
+	/// @brief Highest address sampled since the table was last empty
+	void * High;
+	/// @brief Previous profile in the profiler registry
+	struct MemoryProfile * Prev;
+	/// @brief Next profile in the profiler registry
+	struct MemoryProfile * Next;
+} MemoryProfile;
+#endif
+
 /**
  * @brief Calculates kilobytes to bytes
  * @param kilobytes	kilobytes to convert
@@ -163,6 +824,8 @@ static inline size_t TBytesToBytesF( double terabytes ) {
 
 /**
  * @brief Creates a pool for elements of given size
+ * @details If the memory cannot be allocated the pool has no Raw memory and a capacity of 0, allocating from it
+ * returns NULL. This applies to every pool creation function.
  * @param element_size	Size of the object types in bytes
  * @param capacity		Maximum number of objects managable
  * @return MemoryPool	Clean state of the pool
@@ -179,6 +842,87 @@ MemoryPool PoolCreate( size_t const element_size, size_t const capacity );
  */
 MemoryPool PoolCreateEx( size_t const element_size, size_t const capacity, AllocateFct const allocate_fct, ReleaseFct const release_fct );
 
+/**
+ * @brief Creates a pool for elements of given size with every slot aligned to the given alignment
+ * @param element_size	Size of the object types in bytes, rounded up to a multiple of the alignment
+ * @param capacity		Maximum number of objects managable
+ * @param alignment		Alignment of every slot in bytes (power of two)
+ * @return MemoryPool	Clean state of the pool
+ */
+MemoryPool PoolCreateAligned( size_t const element_size, size_t const capacity, size_t const alignment );
+
+/**
+ * @brief Creates a pool for elements of given size with every slot aligned to the given alignment
+ * @details If allocate_fct is given, it is asked for alignment bytes more than needed to align the slots.
+ * @param element_size	Size of the object types in bytes, rounded up to a multiple of the alignment
+ * @param capacity		Maximum number of objects managable
+ * @param alignment		Alignment of every slot in bytes (power of two)
+ * @param allocate_fct	Pointer to the function to preallocate the pool memory, NULL for the internal aligned allocation
+ * @param release_fct	Pointer to the function to release the pool memory
+ * @return MemoryPool	Clean state of the pool
+ */
+MemoryPool PoolCreateAlignedEx( size_t const element_size, size_t const capacity, size_t const alignment, AllocateFct const allocate_fct, ReleaseFct const release_fct );
+
+/**
+ * @brief Creates a pool for elements of given size which threads released slots through an embedded free list
+ * @details Allocation and release are constant time. Untouched slots are handed out in address order first,
+ * released slots are reused last in, first out. Elements smaller than a pointer are padded to pointer size.
+ * @param element_size	Size of the object types in bytes
+ * @param capacity		Maximum number of objects managable
+ * @param validate		Keep the slot state list to reject foreign and double released pointers
+ * @return MemoryPool	Clean state of the pool
+ */
+MemoryPool PoolCreateFreeList( size_t const element_size, size_t const capacity, bool const validate );
+
+/**
+ * @brief Creates a pool for elements of given size which threads released slots through an embedded free list
+ * @param element_size	Size of the object types in bytes
+ * @param capacity		Maximum number of objects managable
+ * @param validate		Keep the slot state list to reject foreign and double released pointers
+ * @param allocate_fct	Pointer to the function to preallocate the pool memory
+ * @param release_fct	Pointer to the function to release the pool memory
+ * @return MemoryPool	Clean state of the pool
+ */
+MemoryPool PoolCreateFreeListEx( size_t const element_size, size_t const capacity, bool const validate, AllocateFct const allocate_fct, ReleaseFct const release_fct );
+
+/**
+ * @brief Creates a pool for elements of given size with the given options
+ * @param element_size	Size of the object types in bytes
+ * @param capacity		Maximum number of objects managable
+ * @param options		Options to create the pool with, NULL for the defaults of PoolCreate
+ * @return MemoryPool	Clean state of the pool
+ */
+MemoryPool PoolCreateOpt( size_t const element_size, size_t const capacity, MemoryPoolOptions const * options );
+
+/**
+ * @brief Provider mapping regular pages directly from the operating system
+ * @return MemoryProvider	Provider to pass in the creation options
+ */
+MemoryProvider ProviderPages( void );
+
+/**
+ * @brief Provider mapping explicit huge pages, falling back to transparent huge pages if none are reserved
+ * @param page_size			Size of the huge pages, MMEM_PAGE_2M or MMEM_PAGE_1G
+ * @return MemoryProvider	Provider to pass in the creation options
+ */
+MemoryProvider ProviderHugePages( size_t const page_size );
+
+/**
+ * @brief Provider mapping regular pages aligned to 2 MB, advising the kernel to back them with transparent huge pages
+ * @return MemoryProvider	Provider to pass in the creation options
+ */
+MemoryProvider ProviderTransparentHugePages( void );
+
+/**
+ * @brief Adds a NUMA placement to a built-in provider
+ * @details Placement is a hint, memory is still handed out if the kernel rejects the policy.
+ * @param provider			Built-in provider to place the memory of
+ * @param numa				Placement policy ( MMEM_NUMA_LOCAL/MMEM_NUMA_BIND/MMEM_NUMA_INTERLEAVE )
+ * @param nodes				Mask of the nodes to bind or interleave to, 0 for every node
+ * @return MemoryProvider	Provider to pass in the creation options
+ */
+MemoryProvider ProviderNuma( MemoryProvider const provider, unsigned int const numa, uint64_t const nodes );
+
 /**
  * @brief Releases all allocated resources of the pool to the operating system and invalidates the state
  * @param pool	Memory pool to release and invalidate
@@ -199,6 +943,29 @@ void * PoolAllocate( MemoryPool * pool );
  */
 void PoolRelease( MemoryPool * pool, void * element );
 
+/**
+ * @brief Allocates up to count objects owned by the pool at once
+ * @details Bitmap pools claim every unused slot of a state word at once and zero adjacent slots with one call,
+ * the counters are updated once per batch. Free list pools allocate one object after another.
+ * @param pool		Memory pool to own and manage the objects
+ * @param elements	Array receiving a pointer to every object allocated, in ascending address order for bitmap pools
+ * @param count		Number of objects to allocate
+ * @return size_t	Number of objects allocated, less than count if the pool ran full
+ */
+size_t PoolAllocateBatch( MemoryPool * pool, void ** elements, size_t const count );
+
+/**
+ * @brief Releases the objects of an array if they are managed by the pool
+ * @details Bitmap pools clear the slots of one state word at once and zero adjacent slots with one call, the counters
+ * are updated once per batch. Ascending addresses, like those of PoolAllocateBatch, group best. NULL entries, foreign
+ * and already released objects are skipped.
+ * @param pool		Owner of the objects
+ * @param elements	Array of pointers to the elements managed by the pool
+ * @param count		Number of pointers in the array
+ * @return size_t	Number of objects released
+ */
+size_t PoolReleaseBatch( MemoryPool * pool, void ** elements, size_t const count );
+
 /**
  * @brief Releases all resources of the pool without releasing the resources to the os or invalidate it
  * @param pool	Memory pool to reset
@@ -224,57 +991,894 @@ static inline size_t PoolSlotsAvailable( MemoryPool * pool ) {
 }
 
 /**
- * @brief Creates an arena of given number of bytes
- * @param capacity		Number of bytes managed by this arena
- * @return MemoryArena	Clean state of the arena
+ * @brief Starts an iteration over every object allocated in the pool, in address order
+ * @details Bitmap pools and validating free list pools keep the occupancy the iteration walks, free list pools
+ * without validation cannot be iterated and visit nothing. Objects may be released while they are visited.
+ * @param pool					Memory pool to iterate
+ * @return MemoryPoolIterator	Iterator before the first object
  */
-MemoryArena ArenaCreate( size_t const capacity );
+MemoryPoolIterator PoolIterate( MemoryPool * pool );
 
 /**
- * @brief Creates an arena of given number of bytes
- * @param capacity		Number of bytes managed by this arena
- * @param allocate_fct	Pointer to the function to preallocate the arena memory
- * @param release_fct	Pointer to the function to release the arena memory
- * @return MemoryArena	Clean state of the arena
+ * @brief Starts an iteration over one of several disjoint ranges of the pool, so threads can share the work
+ * @details The ranges split the occupancy words below the high-water mark evenly, every object is in exactly one range.
+ * @param pool					Memory pool to iterate
+ * @param chunk					Index of the range, below chunks
+ * @param chunks				Number of ranges the pool is split into
+ * @return MemoryPoolIterator	Iterator before the first object of the range
  */
-MemoryArena ArenaCreateEx( size_t const capacity, AllocateFct const allocate_fct, ReleaseFct const release_fct );
+MemoryPoolIterator PoolIterateChunk( MemoryPool * pool, size_t const chunk, size_t const chunks );
 
 /**
- * @brief Releases all allocated resources of the arena to the operating system and invalidates the state
- * @param arena	Memory arena to release and invalidate
+ * @brief Advances the iteration to the next allocated object
+ * @details Words without any used slot are skipped with one test, used slots are found with a count of trailing zeros.
+ * The slot MMEM_ITERATE_PREFETCH ahead is prefetched.
+ * @param iterator	Iterator of PoolIterate or PoolIterateChunk
+ * @return void *	Pointer to the next object, NULL once every object was visited
  */
-void ArenaDestroy( MemoryArena * arena );
+static inline void * PoolIteratorNext( MemoryPoolIterator * iterator ) {
+	while ( !iterator->Live ) {
+		if ( iterator->Word + 1 >= iterator->Words ) {
+			return NULL;
+		}
+		iterator->Word++;
+		iterator->Live = iterator->Bits[iterator->Word];
+		if ( iterator->Word + 1 == iterator->Words ) {
+			iterator->Live &= iterator->Tail;
+		}
+	}
+
+	size_t index = (iterator->Word << 6) | MMEM_CTZ64( iterator->Live );
+	iterator->Live &= iterator->Live - 1;
+	MMEM_PREFETCH( (void const *)((uintptr_t)iterator->Raw + (index + MMEM_ITERATE_PREFETCH) * iterator->ElementSize) );
+	return iterator->Raw + index * iterator->ElementSize;
+}
 
 /**
- * @brief Allocates an object owned by the arena
- * @param arena		Memory pool to own and manage the object
- * @param size		Number of bytes needed for the object
- * @return void *	Pointer to the object allocated
+ * @brief Calls a function for every object allocated in the pool, in address order
+ * @param pool		Memory pool to iterate
+ * @param visit		Function called with every object and the context
+ * @param context	Passed on to every call
  */
-void * ArenaAllocate( MemoryArena * arena, size_t size );
+void PoolForEach( MemoryPool * pool, VisitFct const visit, void * context );
 
 /**
- * @brief Releases all resources of the arena without releasing the resources to the os or invalidate it
- * @param arena	Memory arena to reset
+ * @brief Calls a function for every object allocated in one of several disjoint ranges of the pool
+ * @param pool		Memory pool to iterate
+ * @param chunk		Index of the range, below chunks
+ * @param chunks	Number of ranges the pool is split into
+ * @param visit		Function called with every object of the range and the context
+ * @param context	Passed on to every call
  */
-void ArenaReset( MemoryArena * arena );
+void PoolForEachChunk( MemoryPool * pool, size_t const chunk, size_t const chunks, VisitFct const visit, void * context );
 
 /**
- * @brief Receive the number of bytes used by the specified arena
- * @param arena		Memory arena to check
- * @return size_t	Number of allocated bytes
+ * @brief Moves objects of a bitmap pool into the lowest unused slots, so the used slots become a dense prefix
+ * @details Every call moves at most budget objects, the highest used slot into the lowest unused one each, so it can
+ * run incrementally in idle time. Afterwards the high-water mark drops to the last used slot. Free list pools are not
+ * compacted. Pointers to moved objects are invalid, owners fix their references in the relocation function.
+ * @param pool		Memory pool to compact
+ * @param budget	Maximum number of objects moved by this call
+ * @param relocate	Function called for every moved object after it was copied, NULL if nothing refers to the objects
+ * @param context	Passed on to every call of the relocation function
+ * @return size_t	Number of objects moved, less than budget once the pool is compact
  */
-static inline size_t ArenaBytesInUse( MemoryArena * arena ) {
-	return arena->Used;
-}
+size_t PoolCompact( MemoryPool * pool, size_t const budget, RelocateFct const relocate, void * context );
 
 /**
- * @brief Receive the number of bytes available in the specified arena
- * @param arena		Memory arena to check
- * @return size_t	Number of available bytes
+ * @brief Returns the whole pages of the pool above its high-water mark to the operating system
+ * @details The pages stay mapped and read as zero once touched again. Only supported on Linux and for pool memory
+ * which is private anonymous memory, like the memory of the library, of its providers or of malloc.
+ * @param pool		Memory pool to trim, usually compacted before
+ * @return size_t	Number of bytes returned, 0 if nothing was returned
  */
-static inline size_t ArenaBytesAvailable( MemoryArena * arena ) {
-	return arena->Capacity - arena->Used;
+size_t PoolTrim( MemoryPool * pool );
+
+/**
+ * @brief Creates a pool handing out generational handles to objects of given size
+ * @details A pool failing to create is cleared, it hands out MMEM_HANDLE_NULL only and may be destroyed any number of times.
+ * @param element_size		Size of the object types in bytes
+ * @param capacity			Maximum number of objects, at most MMEM_HANDLE_INDEX_MASK + 1
+ * @return MemoryHandlePool	Clean state of the pool, its capacity is clamped to the handle range
+ */
+MemoryHandlePool PoolHandleCreate( size_t const element_size, size_t const capacity );
+
+/**
+ * @brief Releases the objects and the handle table of the pool and invalidates the state
+ * @param pool	Handle pool to release and invalidate
+ */
+void PoolHandleDestroy( MemoryHandlePool * pool );
+
+/**
+ * @brief Allocates an object and a handle referring to it
+ * @param pool				Handle pool to own and manage the object
+ * @return MemoryHandle		Handle of the object, MMEM_HANDLE_NULL if the pool is full
+ */
+MemoryHandle PoolHandleAllocate( MemoryHandlePool * pool );
+
+/**
+ * @brief Resolves a handle to its object
+ * @details One table lookup, a generation compare and a multiplication, released and reused handles are rejected.
+ * Pointers are valid until the object is released or the pool is compacted.
+ * @param pool		Handle pool owning the object
+ * @param handle	Handle of the object
+ * @return void *	Pointer to the object, NULL if the handle is stale or invalid
+ */
+static inline void * PoolHandleGet( MemoryHandlePool * pool, MemoryHandle const handle ) {
+	uint32_t index = handle & MMEM_HANDLE_INDEX_MASK;
+	if ( index >= pool->Capacity || pool->Entries[index].Generation != handle >> MMEM_HANDLE_INDEX_BITS ) {
+		return NULL;
+	}
+	return (char *)pool->Pool.Raw + (size_t)pool->Entries[index].Slot * pool->Pool.ElementSize;
 }
 
+/**
+ * @brief Releases the object of a handle, which invalidates every copy of the handle
+ * @details Generations wrap after MMEM_HANDLE_GENERATION_MASK releases of the same entry.
+ * @param pool		Handle pool owning the object
+ * @param handle	Handle of the object
+ * @return bool		false if the handle was stale or invalid and nothing was released
+ */
+bool PoolHandleRelease( MemoryHandlePool * pool, MemoryHandle const handle );
+
+/**
+ * @brief Compacts the objects of the pool like PoolCompact, the handles keep referring to their moved objects
+ * @param pool		Handle pool to compact
+ * @param budget	Maximum number of objects moved by this call
+ * @return size_t	Number of objects moved, less than budget once the pool is compact
+ */
+size_t PoolHandleCompact( MemoryHandlePool * pool, size_t const budget );
+
+/**
+ * @brief Creates a growable pool for elements of given size, which adds slabs when it runs out of slots
+ * @param element_size		Size of the object types in bytes
+ * @param slab_size			Number of bytes per slab, rounded up to a power of two (0 for MMEM_SLAB_SIZE_DEFAULT)
+ * @return MemorySlabPool	Clean state of the pool without any slab
+ */
+MemorySlabPool SlabPoolCreate( size_t const element_size, size_t const slab_size );
+
+/**
+ * @brief Creates a growable pool for elements of given size, which adds slabs when it runs out of slots
+ * @details If allocate_fct is given, it is asked for slab_size bytes more than needed to align the slab.
+ * @param element_size		Size of the object types in bytes
+ * @param slab_size			Number of bytes per slab, rounded up to a power of two (0 for MMEM_SLAB_SIZE_DEFAULT)
+ * @param max_slabs			Maximum number of slabs, 0 for unlimited growth
+ * @param keep_empty		Number of empty slabs kept for reuse before empty slabs are released
+ * @param allocate_fct		Pointer to the function to allocate slabs, NULL for the internal aligned allocation
+ * @param release_fct		Pointer to the function to release slabs
+ * @return MemorySlabPool	Clean state of the pool without any slab
+ */
+MemorySlabPool SlabPoolCreateEx( size_t const element_size, size_t const slab_size, size_t const max_slabs, size_t const keep_empty, AllocateFct const allocate_fct, ReleaseFct const release_fct );
+
+/**
+ * @brief Releases all slabs of the pool to the operating system and invalidates the state
+ * @param pool	Growable pool to release and invalidate
+ */
+void SlabPoolDestroy( MemorySlabPool * pool );
+
+/**
+ * @brief Allocates an object owned by the pool, adding a slab if every slab is full
+ * @param pool		Growable pool to own and manage the object
+ * @return void *	Pointer to the object allocated, NULL if the slab limit is reached or allocation failed
+ */
+void * SlabPoolAllocate( MemorySlabPool * pool );
+
+/**
+ * @brief Releases the resources of an object if it is managed by the pool
+ * @details The owning slab is found by masking the address. Empty slabs above the keep policy are released.
+ * @param pool		Owner of the object
+ * @param element	Pointer to the element managed by the pool
+ */
+void SlabPoolRelease( MemorySlabPool * pool, void * element );
+
+/**
+ * @brief Releases all objects of the pool, keeping empty slabs as the keep policy allows
+ * @param pool	Growable pool to reset
+ */
+void SlabPoolReset( MemorySlabPool * pool );
+
+/**
+ * @brief Releases every empty slab of the pool regardless of the keep policy
+ * @param pool	Growable pool to trim
+ */
+void SlabPoolTrim( MemorySlabPool * pool );
+
+/**
+ * @brief Receive the number of slots used by the specified pool
+ * @param pool		Growable pool to check
+ * @return size_t	Number of allocated object slots
+ */
+static inline size_t SlabPoolSlotsInUse( MemorySlabPool * pool ) {
+	return pool->Used;
+}
+
+/**
+ * @brief Receive the number of slots available in the slabs of the specified pool without growing
+ * @param pool		Growable pool to check
+ * @return size_t	Number of unallocated object slots
+ */
+static inline size_t SlabPoolSlotsAvailable( MemorySlabPool * pool ) {
+	return pool->Capacity - pool->Used;
+}
+
+/**
+ * @brief Opens a heap for variable sized objects with the default slab size
+ * @details Heaps are opened and closed, HeapCreate/HeapDestroy are taken by the Windows API.
+ * @return MemoryHeap	Clean state of the heap
+ */
+MemoryHeap HeapOpen( void );
+
+/**
+ * @brief Opens a heap for variable sized objects
+ * @param slab_size		Number of bytes per slab of the size class pools (0 for MMEM_SLAB_SIZE_DEFAULT)
+ * @param allocate_fct	Pointer to the function to allocate objects above MMEM_HEAP_SMALL_MAX, NULL for malloc
+ * @param release_fct	Pointer to the function to release objects above MMEM_HEAP_SMALL_MAX
+ * @return MemoryHeap	Clean state of the heap
+ */
+MemoryHeap HeapOpenEx( size_t const slab_size, AllocateFct const allocate_fct, ReleaseFct const release_fct );
+
+/**
+ * @brief Releases all objects and memory of the heap to the operating system and invalidates the state
+ * @param heap	Heap to close
+ */
+void HeapClose( MemoryHeap * heap );
+
+/**
+ * @brief Allocates an object of the given size owned by the heap
+ * @details Sizes up to MMEM_HEAP_SMALL_MAX are rounded up to their size class, which is found with one table lookup.
+ * @param heap		Heap to own and manage the object
+ * @param size		Number of bytes needed for the object
+ * @return void *	Pointer to the object allocated, NULL if allocation failed
+ */
+void * HeapAllocate( MemoryHeap * heap, size_t const size );
+
+/**
+ * @brief Releases an object of the heap without knowing its size
+ * @details The slab header in front of the object is found by masking its address.
+ * @param heap		Owner of the object
+ * @param element	Pointer to the object, NULL is ignored
+ */
+void HeapRelease( MemoryHeap * heap, void * element );
+
+/**
+ * @brief Resizes an object of the heap, in place if the new size fits its size class
+ * @param heap		Owner of the object
+ * @param element	Pointer to the object, NULL to allocate a new one
+ * @param size		Number of bytes needed for the object, 0 to release it
+ * @return void *	Pointer to the resized object, NULL if allocation failed (the object stays valid) or size is 0
+ */
+void * HeapResize( MemoryHeap * heap, void * element, size_t const size );
+
+/**
+ * @brief Receive the number of bytes usable in an object of the heap
+ * @param heap		Owner of the object
+ * @param element	Pointer to the object
+ * @return size_t	Size of the size class or of the large allocation
+ */
+size_t HeapUsableSize( MemoryHeap * heap, void * element );
+
+/**
+ * @brief Releases the empty slabs of every size class
+ * @param heap	Heap to trim
+ */
+void HeapTrim( MemoryHeap * heap );
+
+/**
+ * @brief Receive the number of bytes allocated from the heap, counting size classes in full
+ * @param heap		Heap to check
+ * @return size_t	Number of bytes in use
+ */
+size_t HeapBytesInUse( MemoryHeap * heap );
+
+/**
+ * @brief Creates a thread-safe pool for elements of given size
+ * @details If any of its memory cannot be allocated the pool has no Raw memory and a capacity of 0, allocating from it
+ * returns NULL and thread caches cannot attach to it.
+ * @param element_size			Size of the object types in bytes
+ * @param capacity				Maximum number of objects managable
+ * @return MemoryPoolConcurrent	Clean state of the pool
+ */
+MemoryPoolConcurrent PoolConcurrentCreate( size_t const element_size, size_t const capacity );
+
+/**
+ * @brief Creates a thread-safe pool for elements of given size
+ * @param element_size			Size of the object types in bytes
+ * @param capacity				Maximum number of objects managable
+ * @param allocate_fct			Pointer to the function to preallocate the pool memory
+ * @param release_fct			Pointer to the function to release the pool memory
+ * @return MemoryPoolConcurrent	Clean state of the pool
+ */
+MemoryPoolConcurrent PoolConcurrentCreateEx( size_t const element_size, size_t const capacity, AllocateFct const allocate_fct, ReleaseFct const release_fct );
+
+/**
+ * @brief Releases all allocated resources of the pool to the operating system and invalidates the state
+ * @details Not thread-safe, no other thread may use the pool anymore.
+ * @param pool	Memory pool to release and invalidate
+ */
+void PoolConcurrentDestroy( MemoryPoolConcurrent * pool );
+
+/**
+ * @brief Allocates an object owned by the pool, safe to call from any thread
+ * @details Every thread starts searching at the word it last allocated from, so threads spread across the list.
+ * @param pool		Memory pool to own and manage the object
+ * @return void *	Pointer to the object allocated, NULL if the pool is full
+ */
+void * PoolConcurrentAllocate( MemoryPoolConcurrent * pool );
+
+/**
+ * @brief Releases the resources of an object if it is managed by the pool, safe to call from any thread
+ * @param pool		Owner of the object
+ * @param element	Pointer to the element managed by the pool
+ */
+void PoolConcurrentRelease( MemoryPoolConcurrent * pool, void * element );
+
+/**
+ * @brief Releases all resources of the pool without releasing the resources to the os or invalidate it
+ * @details Not thread-safe, no other thread may use the pool meanwhile.
+ * @param pool	Memory pool to reset
+ */
+void PoolConcurrentReset( MemoryPoolConcurrent * pool );
+
+/**
+ * @brief Receive the number of slots used by the specified pool
+ * @details Counts the slot states instead of maintaining a shared counter, the result is a snapshot.
+ * @param pool		Memory Pool to check
+ * @return size_t	Number of allocated object slots
+ */
+size_t PoolConcurrentSlotsInUse( MemoryPoolConcurrent * pool );
+
+/**
+ * @brief Receive the number of slots available in the specified pool
+ * @param pool		Memory Pool to check
+ * @return size_t	Number of unallocated object slots
+ */
+static inline size_t PoolConcurrentSlotsAvailable( MemoryPoolConcurrent * pool ) {
+	return pool->Capacity - PoolConcurrentSlotsInUse( pool );
+}
+
+/**
+ * @brief Attaches a thread cache to a concurrent pool
+ * @details Objects are allocated from and released to the magazine of the cache without atomic operations.
+ * The magazine is refilled with up to one state word of slots at once and flushed in halves.
+ * @param cache	Cache to attach, used by the calling thread only from now on
+ * @param pool	Concurrent pool to claim slots from
+ * @return bool	false if MMEM_CACHE_MAX caches are already attached
+ */
+bool PoolCacheAttach( MemoryPoolCache * cache, MemoryPoolConcurrent * pool );
+
+/**
+ * @brief Returns every slot held by the cache to its pool and detaches it
+ * @param cache	Cache to detach
+ */
+void PoolCacheDetach( MemoryPoolCache * cache );
+
+/**
+ * @brief Allocates an object from the magazine of the cache, refilling it from the pool if empty
+ * @details A refill first takes the objects released to this cache by other threads.
+ * @param cache		Cache of the calling thread
+ * @return void *	Pointer to the object allocated, NULL if the pool is full
+ */
+void * PoolCacheAllocate( MemoryPoolCache * cache );
+
+/**
+ * @brief Releases an object of the pool the cache is attached to
+ * @details Objects of slots last claimed by another cache are queued to that cache with a single atomic operation.
+ * Unlike PoolRelease, double releases are only partly detected. Objects whose slot is free in the pool are ignored,
+ * but an object released again while its slot waits in a magazine or queue is handed out twice.
+ * @param cache		Cache of the calling thread
+ * @param element	Pointer to the element managed by the pool
+ */
+void PoolCacheRelease( MemoryPoolCache * cache, void * element );
+
+/**
+ * @brief Returns every free slot held by the cache and its remote queue to the pool
+ * @param cache	Cache of the calling thread
+ */
+void PoolCacheFlush( MemoryPoolCache * cache );
+
+/**
+ * @brief Creates an arena of given number of bytes
+ * @param capacity		Number of bytes managed by this arena
+ * @return MemoryArena	Clean state of the arena
+ */
+MemoryArena ArenaCreate( size_t const capacity );
+
+/**
+ * @brief Creates an arena of given number of bytes
+ * @param capacity		Number of bytes managed by this arena
+ * @param allocate_fct	Pointer to the function to preallocate the arena memory
+ * @param release_fct	Pointer to the function to release the arena memory
+ * @return MemoryArena	Clean state of the arena
+ */
+MemoryArena ArenaCreateEx( size_t const capacity, AllocateFct const allocate_fct, ReleaseFct const release_fct );
+
+/**
+ * @brief Creates an arena which links new blocks of memory instead of failing allocations when exhausted
+ * @param capacity		Number of bytes of the first block
+ * @param growth		Factor applied to the capacity of the current block for the next one (1.0 for equal blocks)
+ * @param retain		Number of blocks after the first one kept on reset, MMEM_SLAB_KEEP_ALL to keep every block
+ * @return MemoryArena	Clean state of the arena
+ */
+MemoryArena ArenaCreateGrowable( size_t const capacity, double const growth, size_t const retain );
+
+/**
+ * @brief Creates an arena which links new blocks of memory instead of failing allocations when exhausted
+ * @param capacity		Number of bytes of the first block
+ * @param growth		Factor applied to the capacity of the current block for the next one (1.0 for equal blocks)
+ * @param retain		Number of blocks after the first one kept on reset, MMEM_SLAB_KEEP_ALL to keep every block
+ * @param allocate_fct	Pointer to the function to allocate the arena memory blocks
+ * @param release_fct	Pointer to the function to release the arena memory blocks
+ * @return MemoryArena	Clean state of the arena
+ */
+MemoryArena ArenaCreateGrowableEx( size_t const capacity, double const growth, size_t const retain, AllocateFct const allocate_fct, ReleaseFct const release_fct );
+
+/**
+ * @brief Creates an arena of given number of bytes with the given options
+ * @param capacity		Number of bytes of the first block
+ * @param options		Options to create the arena with, NULL for the defaults of ArenaCreate
+ * @return MemoryArena	Clean state of the arena
+ */
+MemoryArena ArenaCreateOpt( size_t const capacity, MemoryArenaOptions const * options );
+
+/**
+ * @brief Creates an arena which reserves address space and commits memory only as allocations advance into it
+ * @details Memory is committed in chunks of MMEM_ARENA_COMMIT_CHUNK bytes. Reset and rewind decommit the memory above
+ * the retained number of bytes, which comes back zeroed when committed again. Fails where the platform offers no
+ * virtual memory, the returned arena then refuses every allocation.
+ * @param reserve		Number of bytes of address space to reserve, the arena can never hold more
+ * @param retain		Number of committed bytes kept on reset and rewind
+ * @return MemoryArena	Clean state of the arena
+ */
+MemoryArena ArenaCreateVirtual( size_t const reserve, size_t const retain );
+
+/**
+ * @brief Releases all allocated resources of the arena to the operating system and invalidates the state
+ * @param arena	Memory arena to release and invalidate
+ */
+void ArenaDestroy( MemoryArena * arena );
+
+/**
+ * @brief Allocates an object owned by the arena
+ * @param arena		Memory pool to own and manage the object
+ * @param size		Number of bytes needed for the object
+ * @return void *	Pointer to the object allocated
+ */
+void * ArenaAllocate( MemoryArena * arena, size_t size );
+
+/**
+ * @brief Allocates an object owned by the arena at an address aligned to the given alignment
+ * @details The padding in front of the object is computed with a single mask and counts as used bytes.
+ * @param arena		Memory arena to own and manage the object
+ * @param size		Number of bytes needed for the object
+ * @param alignment	Alignment of the object in bytes (power of two)
+ * @return void *	Pointer to the object allocated
+ */
+void * ArenaAllocateAligned( MemoryArena * arena, size_t size, size_t alignment );
+
+/**
+ * @brief Allocates an object of the given type owned by the arena, aligned to the alignment of the type
+ * @param arena	Memory arena to own and manage the object
+ * @param type	Type of the object
+ */
+#define ArenaNew( arena, type ) ((type *)ArenaAllocateAligned( (arena), sizeof( type ), MMEM_ALIGNOF( type ) ))
+
+/**
+ * @brief Allocates an array of objects of the given type owned by the arena, aligned to the alignment of the type
+ * @param arena	Memory arena to own and manage the objects
+ * @param type	Type of the objects
+ * @param count	Number of objects
+ */
+#define ArenaNewArray( arena, type, count ) ((type *)ArenaAllocateAligned( (arena), sizeof( type ) * (count), MMEM_ALIGNOF( type ) ))
+
+/**
+ * @brief Creates a pool for objects of the given type with slots aligned to the alignment of the type
+ * @param type		Type of the objects
+ * @param capacity	Maximum number of objects managable
+ */
+#define PoolCreateTyped( type, capacity ) PoolCreateAligned( sizeof( type ), (capacity), MMEM_ALIGNOF( type ) )
+
+/**
+ * @brief Releases all resources of the arena without releasing the resources to the os or invalidate it
+ * @details Growable arenas keep the first block and as many following blocks as they retain.
+ * @param arena	Memory arena to reset
+ */
+void ArenaReset( MemoryArena * arena );
+
+/**
+ * @brief Takes the current position of the arena to rewind to later
+ * @details Markers stay valid until the arena is reset or rewound to an earlier position.
+ * @param arena					Memory arena to mark
+ * @return MemoryArenaMarker	Current position of the arena
+ */
+static inline MemoryArenaMarker ArenaMark( MemoryArena * arena ) {
+	return (MemoryArenaMarker) {
+		.Block = arena->Current,
+		.Used = arena->Used,
+		.UsedBefore = arena->UsedBefore
+	};
+}
+
+/**
+ * @brief Releases every object allocated since the marker was taken
+ * @details Only the bytes between the marker and the current position are zeroed (zero policy permitting).
+ * Blocks entered after the marker become spare blocks again.
+ * @param arena		Memory arena to rewind
+ * @param marker	Position taken with ArenaMark
+ */
+void ArenaRewind( MemoryArena * arena, MemoryArenaMarker const marker );
+
+/**
+ * @brief Begins a temporary scope inside the arena
+ * @param arena				Memory arena to allocate the temporary objects from
+ * @return MemoryArenaTemp	Scope to end with ArenaTempEnd
+ */
+static inline MemoryArenaTemp ArenaTempBegin( MemoryArena * arena ) {
+	return (MemoryArenaTemp) {
+		.Arena = arena,
+		.Marker = ArenaMark( arena )
+	};
+}
+
+/**
+ * @brief Ends a temporary scope, releasing everything allocated within it
+ * @param temp	Scope begun with ArenaTempBegin
+ */
+static inline void ArenaTempEnd( MemoryArenaTemp * temp ) {
+	if ( temp->Arena ) {
+		ArenaRewind( temp->Arena, temp->Marker );
+		temp->Arena = NULL;
+	}
+}
+
+/**
+ * @brief Runs the following statement as a temporary scope of the arena
+ * @details Leaving the statement with break, goto or return skips the end of the scope.
+ * @param arena	Memory arena to allocate the temporary objects from
+ */
+#define ArenaScope( arena ) for ( MemoryArenaTemp mmem_arena_scope = ArenaTempBegin( arena ); mmem_arena_scope.Arena; ArenaTempEnd( &mmem_arena_scope ) )
+
+/**
+ * @brief Receive the number of bytes used by the specified arena
+ * @param arena		Memory arena to check
+ * @return size_t	Number of allocated bytes
+ */
+static inline size_t ArenaBytesInUse( MemoryArena * arena ) {
+	return arena->UsedBefore + arena->Used;
+}
+
+/**
+ * @brief Receive the number of bytes available in the specified arena without allocating another block
+ * @param arena		Memory arena to check
+ * @return size_t	Number of available bytes in the current and spare blocks, or in the reservation of a virtual arena
+ */
+static inline size_t ArenaBytesAvailable( MemoryArena * arena ) {
+	return (arena->Reserved ? arena->Reserved : arena->Capacity) - arena->Used + arena->Spare;
+}
+
+/**
+ * @brief Creates a stack of given number of bytes
+ * @param capacity		Number of bytes shared by both ends of the stack
+ * @return MemoryStack	Clean state of the stack
+ */
+MemoryStack StackCreate( size_t const capacity );
+
+/**
+ * @brief Creates a stack of given number of bytes
+ * @param capacity		Number of bytes shared by both ends of the stack
+ * @param allocate_fct	Pointer to the function to preallocate the stack memory
+ * @param release_fct	Pointer to the function to release the stack memory
+ * @return MemoryStack	Clean state of the stack
+ */
+MemoryStack StackCreateEx( size_t const capacity, AllocateFct const allocate_fct, ReleaseFct const release_fct );
+
+/**
+ * @brief Releases the memory of the stack to the operating system and invalidates the state
+ * @param stack	Memory stack to release and invalidate
+ */
+void StackDestroy( MemoryStack * stack );
+
+/**
+ * @brief Allocates an object from the bottom of the stack, aligned to MMEM_STACK_ALIGNMENT
+ * @details Every allocation is preceded by a header of MMEM_STACK_ALIGNMENT bytes to pop it with StackPopFront.
+ * @param stack		Memory stack to own the object
+ * @param size		Number of bytes needed for the object
+ * @return void *	Pointer to the object allocated, NULL if it does not fit between both ends
+ */
+void * StackPushFront( MemoryStack * stack, size_t const size );
+
+/**
+ * @brief Allocates an object from the bottom of the stack at an address aligned to the given alignment
+ * @param stack		Memory stack to own the object
+ * @param size		Number of bytes needed for the object
+ * @param alignment	Alignment of the object in bytes (power of two), at least MMEM_STACK_ALIGNMENT is used
+ * @return void *	Pointer to the object allocated, NULL if it does not fit between both ends
+ */
+void * StackPushFrontAligned( MemoryStack * stack, size_t const size, size_t const alignment );
+
+/**
+ * @brief Allocates an object from the top of the stack, aligned to MMEM_STACK_ALIGNMENT
+ * @details Every allocation is preceded by a header of MMEM_STACK_ALIGNMENT bytes to pop it with StackPopBack.
+ * @param stack		Memory stack to own the object
+ * @param size		Number of bytes needed for the object
+ * @return void *	Pointer to the object allocated, NULL if it does not fit between both ends
+ */
+void * StackPushBack( MemoryStack * stack, size_t const size );
+
+/**
+ * @brief Allocates an object from the top of the stack at an address aligned to the given alignment
+ * @param stack		Memory stack to own the object
+ * @param size		Number of bytes needed for the object
+ * @param alignment	Alignment of the object in bytes (power of two), at least MMEM_STACK_ALIGNMENT is used
+ * @return void *	Pointer to the object allocated, NULL if it does not fit between both ends
+ */
+void * StackPushBackAligned( MemoryStack * stack, size_t const size, size_t const alignment );
+
+/**
+ * @brief Releases the most recent allocation from the bottom of the stack, including its header and padding
+ * @param stack	Memory stack to pop, nothing happens if the bottom holds no allocation
+ */
+void StackPopFront( MemoryStack * stack );
+
+/**
+ * @brief Releases the most recent allocation from the top of the stack, including its header and padding
+ * @param stack	Memory stack to pop, nothing happens if the top holds no allocation
+ */
+void StackPopBack( MemoryStack * stack );
+
+/**
+ * @brief Grows or shrinks the most recent allocation from the bottom of the stack in place
+ * @details Allocations from the top grow towards the bottom and can not keep their address, so only the bottom end
+ * resizes. Grown bytes are zeroed on MMEM_ZERO_POLICY_ONALLOCATE, released bytes on MMEM_ZERO_POLICY_ONRELEASE.
+ * @param stack		Memory stack owning the allocation
+ * @param size		New number of bytes of the allocation
+ * @return void *	Pointer to the unmoved allocation, NULL if there is none or the new size does not fit
+ */
+void * StackResizeFront( MemoryStack * stack, size_t const size );
+
+/**
+ * @brief Releases every allocation of both ends of the stack
+ * @param stack	Memory stack to reset
+ */
+void StackReset( MemoryStack * stack );
+
+/**
+ * @brief Takes the current position of the bottom end to rewind to later
+ * @param stack					Memory stack to mark
+ * @return MemoryStackMarker	Current position of the bottom end
+ */
+static inline MemoryStackMarker StackMarkFront( MemoryStack * stack ) {
+	return (MemoryStackMarker) {
+		.Used = stack->Front,
+		.Top = stack->FrontTop
+	};
+}
+
+/**
+ * @brief Takes the current position of the top end to rewind to later
+ * @param stack					Memory stack to mark
+ * @return MemoryStackMarker	Current position of the top end
+ */
+static inline MemoryStackMarker StackMarkBack( MemoryStack * stack ) {
+	return (MemoryStackMarker) {
+		.Used = stack->Back,
+		.Top = stack->BackTop
+	};
+}
+
+/**
+ * @brief Releases every allocation from the bottom made since the marker was taken
+ * @param stack		Memory stack to rewind
+ * @param marker	Position taken with StackMarkFront
+ */
+void StackRewindFront( MemoryStack * stack, MemoryStackMarker const marker );
+
+/**
+ * @brief Releases every allocation from the top made since the marker was taken
+ * @param stack		Memory stack to rewind
+ * @param marker	Position taken with StackMarkBack
+ */
+void StackRewindBack( MemoryStack * stack, MemoryStackMarker const marker );
+
+/**
+ * @brief Receive the number of bytes used by both ends of the specified stack
+ * @param stack		Memory stack to check
+ * @return size_t	Number of allocated bytes, including headers and padding
+ */
+static inline size_t StackBytesInUse( MemoryStack * stack ) {
+	return stack->Front + stack->Back;
+}
+
+/**
+ * @brief Receive the number of bytes left between both ends of the specified stack
+ * @param stack		Memory stack to check
+ * @return size_t	Number of available bytes, headers and padding of further allocations are taken from them
+ */
+static inline size_t StackBytesAvailable( MemoryStack * stack ) {
+	return stack->Capacity - stack->Front - stack->Back;
+}
+
+/**
+ * @brief Creates a frame arena of given number of fixed sub-arenas
+ * @param count				Number of frames alive at once, at least 1
+ * @param capacity			Number of bytes of every sub-arena
+ * @return MemoryFrameArena	Clean state of the frame arena
+ */
+MemoryFrameArena FrameArenaCreate( size_t const count, size_t const capacity );
+
+/**
+ * @brief Creates a frame arena of given number of sub-arenas created with the given options
+ * @param count				Number of frames alive at once, at least 1
+ * @param capacity			Number of bytes of the first block of every sub-arena
+ * @param options			Options to create the sub-arenas with, NULL for the defaults of ArenaCreate
+ * @return MemoryFrameArena	Clean state of the frame arena
+ */
+MemoryFrameArena FrameArenaCreateOpt( size_t const count, size_t const capacity, MemoryArenaOptions const * options );
+
+/**
+ * @brief Releases all sub-arenas of the frame arena and invalidates the state
+ * @details Consumers must not access any frame anymore.
+ * @param frames	Frame arena to release and invalidate
+ */
+void FrameArenaDestroy( MemoryFrameArena * frames );
+
+/**
+ * @brief Opens the next frame, resetting the sub-arena of the frame Count frames before it
+ * @details Only the producer thread calls it. The frame fails to begin while the frame it reuses is not retired, the
+ * producer may retry later, no lock is taken either way.
+ * @param frames	Frame arena to open the next frame of
+ * @return bool		True if the frame is open, false if a frame is already open or the frame to reuse is still alive
+ */
+bool FrameBegin( MemoryFrameArena * frames );
+
+/**
+ * @brief Closes the open frame and records its usage
+ * @param frames		Frame arena to close the frame of
+ * @return uint64_t		Number of the closed frame, to hand to the consumers along with its data, UINT64_MAX if none was open
+ */
+uint64_t FrameEnd( MemoryFrameArena * frames );
+
+/**
+ * @brief Marks the given frame and every frame before it as consumed, their memory may be reclaimed from now on
+ * @details Callable from any thread, the fence only moves forward. Consumers finishing frames out of order have to
+ * agree on the fence themselves.
+ * @param frames	Frame arena the frame belongs to
+ * @param frame		Number of the consumed frame as returned by FrameEnd, the frame has to be ended already
+ */
+void FrameRetire( MemoryFrameArena * frames, uint64_t const frame );
+
+/**
+ * @brief Allocates an object from the open frame
+ * @param frames	Frame arena to allocate from
+ * @param size		Number of bytes needed for the object
+ * @return void *	Pointer to the object allocated, NULL if no frame is open or its sub-arena is exhausted
+ */
+static inline void * FrameAllocate( MemoryFrameArena * frames, size_t size ) {
+	return frames->Current ? ArenaAllocate( frames->Current, size ) : NULL;
+}
+
+/**
+ * @brief Allocates an object from the open frame at an address aligned to the given alignment
+ * @param frames	Frame arena to allocate from
+ * @param size		Number of bytes needed for the object
+ * @param alignment	Alignment of the object in bytes (power of two)
+ * @return void *	Pointer to the object allocated, NULL if no frame is open or its sub-arena is exhausted
+ */
+static inline void * FrameAllocateAligned( MemoryFrameArena * frames, size_t size, size_t alignment ) {
+	return frames->Current ? ArenaAllocateAligned( frames->Current, size, alignment ) : NULL;
+}
+
+#if MMEM_STATS
+/**
+ * @brief Adds a pool to the statistics registry
+ * @details Pools are created by value, register them only at their final address and do not move them afterwards.
+ * PoolDestroy removes the pool from the registry.
+ * @param pool	Memory pool to register
+ * @param name	Name to report the pool with, it has to outlive the registration
+ */
+void StatsRegisterPool( MemoryPool * pool, char const * name );
+
+/**
+ * @brief Adds an arena to the statistics registry
+ * @details Arenas are created by value, register them only at their final address and do not move them afterwards.
+ * ArenaDestroy removes the arena from the registry.
+ * @param arena	Memory arena to register
+ * @param name	Name to report the arena with, it has to outlive the registration
+ */
+void StatsRegisterArena( MemoryArena * arena, char const * name );
+
+/**
+ * @brief Removes an instance from the statistics registry, its counters are kept
+ * @param stats	Statistics member of the registered pool or arena
+ */
+void StatsUnregister( MemoryStats * stats );
+
+/**
+ * @brief Copies the statistics of the registered instances
+ * @details Counters of instances used by other threads meanwhile may be torn, the registry itself is locked.
+ * @param snapshots	Array to copy the statistics to, may be NULL to count the instances
+ * @param capacity	Number of entries in snapshots
+ * @return size_t	Number of registered instances, entries beyond capacity are left out
+ */
+size_t StatsSnapshot( MemoryStatsSnapshot * snapshots, size_t const capacity );
+
+/**
+ * @brief Writes the statistics of the registered instances to a buffer as a JSON array
+ * @details The output is always terminated unless size is 0, just like snprintf.
+ * @param buffer	Buffer to write to, may be NULL if size is 0
+ * @param size		Size of the buffer in bytes
+ * @return size_t	Length of the complete output without the terminator, larger or equal to size if it was cut
+ */
+size_t StatsDump( char * buffer, size_t const size );
+#endif
+
+#if MMEM_PROFILE
+/**
+ * @brief Sets the mean number of bytes allocated by a profiled instance between two samples
+ * @details Sampling intervals are drawn at random around the rate, so allocation patterns cannot alias with them.
+ * The rate applies from the next interval drawn on, MMEM_PROFILE_RATE is used until it is set.
+ * @param rate	Mean sampling interval in bytes, 1 samples every allocation
+ */
+void ProfileSetRate( size_t const rate );
+
+/**
+ * @brief Starts sampling the allocations of a pool and adds it to the profiler registry
+ * @details Only allocations and releases through PoolAllocate, PoolRelease and the functions built on them are sampled,
+ * batches and typed pools of a profiled pool take that path as well. PoolDestroy stops the profiling.
+ * Pools are created by value, profile them only at their final address and do not move them afterwards.
+ * @param pool	Memory pool to profile
+ * @param name	Name to report the pool with, it has to outlive the profiling
+ * @return bool	True if the pool is profiled, false if it already was or the profile could not be allocated
+ */
+bool ProfilePool( MemoryPool * pool, char const * name );
+
+/**
+ * @brief Starts sampling the allocations of an arena and adds it to the profiler registry
+ * @details Samples stay alive until the arena is reset, rewound below them or destroyed. ArenaDestroy stops the
+ * profiling. Arenas are created by value, profile them only at their final address and do not move them afterwards.
+ * @param arena	Memory arena to profile
+ * @param name	Name to report the arena with, it has to outlive the profiling
+ * @return bool	True if the arena is profiled, false if it already was or the profile could not be allocated
+ */
+bool ProfileArena( MemoryArena * arena, char const * name );
+
+/**
+ * @brief Stops sampling the allocations of a pool and drops its call sites from the profiler registry
+ * @param pool	Memory pool to stop profiling
+ */
+void ProfilePoolStop( MemoryPool * pool );
+
+/**
+ * @brief Stops sampling the allocations of an arena and drops its call sites from the profiler registry
+ * @param arena	Memory arena to stop profiling
+ */
+void ProfileArenaStop( MemoryArena * arena );
+
+/**
+ * @brief Writes the call sites of the profiled instances to a buffer
+ * @details MMEM_PROFILE_LIVE and MMEM_PROFILE_PEAK write folded stacks ( "name;outermost;...;innermost bytes" ) of
+ * the estimated live or peak bytes, as taken by flame graph tools. MMEM_PROFILE_PPROF writes a heap profile in the
+ * legacy text format of pprof, sampled counts with the sampling rate, followed by the mapped libraries on Linux.
+ * Addresses are written as they are, symbolize them with the binary. The output is always terminated unless size is
+ * 0, just like snprintf. Counters of instances used by other threads meanwhile may be torn, the registry itself is
+ * locked.
+ * @param buffer	Buffer to write to, may be NULL if size is 0
+ * @param size		Size of the buffer in bytes
+ * @param format	Format of the report ( MMEM_PROFILE_LIVE/MMEM_PROFILE_PEAK/MMEM_PROFILE_PPROF )
+ * @return size_t	Length of the complete output without the terminator, larger or equal to size if it was cut
+ */
+size_t ProfileDump( char * buffer, size_t const size, unsigned int const format );
+
+/**
+ * @brief Writes the report of ProfileDump to a file whenever the process receives the given signal
+ * @details The signal handler writes the report itself with async-signal-safe calls only, unless it interrupted a
+ * change of the profiler registry. The report is then written by the next sample taken. Unavailable where the
+ * platform offers no POSIX signals.
+ * @param signal	Signal to report on, such as SIGUSR1
+ * @param path		File to write the report to, truncated on every report, it has to outlive the handler
+ * @param format	Format of the report ( MMEM_PROFILE_LIVE/MMEM_PROFILE_PEAK/MMEM_PROFILE_PPROF )
+ * @return bool		True if the handler is installed
+ */
+bool ProfileDumpOnSignal( int const signal, char const * path, unsigned int const format );
+#endif
+
 #endif // MMEM_H
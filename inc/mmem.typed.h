@@ -0,0 +1,100 @@
+#ifndef MMEM_TYPED_H
+#define MMEM_TYPED_H
+
+#include "mmem.h"
+#include "mmem.bitmap.h"
+
+/*
+ * Pools of one type, generated with the element size as a compile-time constant:
+ *     typedef struct { float Position[3]; float Velocity[3]; } Particle;
+ *     MMEM_DEFINE_POOL( ParticlePool, Particle )
+ * declares the type ParticlePool and the static inline functions
+ *     ParticlePoolCreate, ParticlePoolDestroy, ParticlePoolReset,
+ *     ParticlePoolAllocate, ParticlePoolRelease, ParticlePoolIterate, ParticlePoolNext.
+ * Slot addresses and indices are computed from sizeof( Type ), so the compiler folds the multiplication, division and
+ * remainder into shifts and masks for power of two sizes, and allocation and release inline into the calling loop.
+ * The generated pool holds a bitmap MemoryPool, every Pool* function works on its member Pool as well.
+ * With MMEM_STATS, or for a profiled pool, the functions call the out-of-line pool functions, which maintain the counters
+ * and take the samples.
+ */
+
+#define MMEM_DEFINE_POOL( Name, Type ) \
+	typedef struct { \
+		MemoryPool Pool; \
+	} Name; \
+	\
+	static inline Name Name##Create( size_t const capacity ) { \
+		Name pool = { PoolCreateAligned( sizeof( Type ), capacity, MMEM_ALIGNOF( Type ) ) }; \
+		return pool; \
+	} \
+	\
+	static inline void Name##Destroy( Name * pool ) { \
+		PoolDestroy( &pool->Pool ); \
+	} \
+	\
+	static inline void Name##Reset( Name * pool ) { \
+		PoolReset( &pool->Pool ); \
+	} \
+	\
+	static inline Type * Name##Allocate( Name * pool ) { \
+		if ( MMEM_STATS || MMEM_PROFILED( &pool->Pool ) ) { \
+			return (Type *)PoolAllocate( &pool->Pool ); \
+		} \
+		MemoryBitmap * map = (MemoryBitmap *)pool->Pool.List; \
+		size_t index = map ? MemoryBitmapFind( map ) : SIZE_MAX; \
+		if ( index == SIZE_MAX ) { \
+			return NULL; \
+		} \
+		MemoryBitmapSet( map, index ); \
+		pool->Pool.Used++; \
+		if ( index >= pool->Pool.Cursor ) { \
+			pool->Pool.Cursor = index + 1; \
+		} \
+		Type * element = (Type *)pool->Pool.Raw + index; \
+		if ( pool->Pool.ZeroPolicy == MMEM_ZERO_POLICY_ONALLOCATE ) { \
+			memset( element, 0x00, sizeof( Type ) ); \
+		} \
+		return element; \
+	} \
+	\
+	static inline void Name##Release( Name * pool, Type * element ) { \
+		if ( MMEM_STATS || MMEM_PROFILED( &pool->Pool ) ) { \
+			PoolRelease( &pool->Pool, element ); \
+			return; \
+		} \
+		/* Out of bounds, misaligned and unallocated pointers cannot be valid objects of this pool */ \
+		size_t offset = (size_t)((uintptr_t)element - (uintptr_t)pool->Pool.Raw); \
+		size_t index = offset / sizeof( Type ); \
+		MemoryBitmap * map = (MemoryBitmap *)pool->Pool.List; \
+		if ( index >= pool->Pool.Cursor || offset % sizeof( Type ) != 0 || !MemoryBitmapTest( map, index ) ) { \
+			return; \
+		} \
+		MemoryBitmapClear( map, index ); \
+		if ( pool->Pool.ZeroPolicy == MMEM_ZERO_POLICY_ONRELEASE ) { \
+			memset( element, 0x00, sizeof( Type ) ); \
+		} \
+		pool->Pool.Used--; \
+	} \
+	\
+	static inline MemoryPoolIterator Name##Iterate( Name * pool ) { \
+		return PoolIterate( &pool->Pool ); \
+	} \
+	\
+	static inline Type * Name##Next( MemoryPoolIterator * iterator ) { \
+		while ( !iterator->Live ) { \
+			if ( iterator->Word + 1 >= iterator->Words ) { \
+				return NULL; \
+			} \
+			iterator->Word++; \
+			iterator->Live = iterator->Bits[iterator->Word]; \
+			if ( iterator->Word + 1 == iterator->Words ) { \
+				iterator->Live &= iterator->Tail; \
+			} \
+		} \
+		size_t index = (iterator->Word << MMEM_BITMAP_WORD_SHIFT) | MMEM_CTZ64( iterator->Live ); \
+		iterator->Live &= iterator->Live - 1; \
+		MMEM_PREFETCH( (void const *)((uintptr_t)iterator->Raw + (index + MMEM_ITERATE_PREFETCH) * sizeof( Type )) ); \
+		return (Type *)iterator->Raw + index; \
+	}
+
+#endif // MMEM_TYPED_H
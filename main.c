@@ -1,93 +1,119 @@
 #include "mmem.h"
-#include <bits/types/clock_t.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include <assert.h>
-#include <math.h>
-
-#define STORAGE_SIZE 1000000
-#define ITERATIONS   10000
-
-// Simple struct to test allocations
-typedef struct {
-    int x, y;
-    float value;
-} TestStruct;
+#if defined( _WIN32 )
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+// Operations timed together as one latency sample, single operations are below the clock resolution
+#define BATCH        32
+// Allocations followed by their release in reverse order per LIFO round
+#define BURST        (BATCH / 2)
+// Allocations followed by their release in allocation order per burst and batch round
+#define BATCH_BURST  256
+// Timed operations per churn case
+#define OPERATIONS   (1 << 18)
+// Default increase of the median latency in percent reported as regression
+#define THRESHOLD    10.0
+// Sampling rate of the profiler check and the live bytes it estimates per case
+#define PROFILE_RATE 1024
+#define PROFILE_LIVE (8 * 1024 * 1024)
+// Deviation of the estimated live bytes in percent reported as failure, about five standard deviations
+#define PROFILE_THRESHOLD 5.0
+#define NAME_MAX_LEN 32
 
 typedef enum {
-	BENCH_MALLOC,
-	BENCH_CALLOC,
-	BENCH_POOL_SINGLE,
-	BENCH_POOL_BATCHED,
-	BENCH_ARENA,
-	BENCH_TOTAL
-} Benchmark;
-
-typedef void (*SimpleFunction)( TestStruct ** storage );
-
-void AllocMalloc( TestStruct ** );
-void AllocCalloc( TestStruct ** );
-void AllocPool( TestStruct ** );
-void AllocArena( TestStruct ** );
-
-void ReleaseMallocCalloc( TestStruct ** );
-void ReleasePoolSingle( TestStruct ** );
-void ReleasePoolBatched( TestStruct ** );
-void ReleaseArena( TestStruct ** );
-
-MemoryPool pool;
-MemoryArena arena;
-
-char const * const bfile[BENCH_TOTAL] = {
-	"malloc.bench.csv",
-	"calloc.bench.csv",
-	"pool_single.bench.csv",
-	"pool_batched.bench.csv",
-	"arena.bench.csv"
-};
+	ALLOC_MALLOC,
+	ALLOC_POOL_BITMAP,
+	ALLOC_POOL_FREELIST,
+	ALLOC_SLAB_POOL,
+	ALLOC_HEAP,
+	ALLOC_ARENA,
+	ALLOC_TOTAL
+} Allocator;
 
-char const * const bstring[BENCH_TOTAL] = {
+typedef enum {
+	PATTERN_FILL,
+	PATTERN_LIFO,
+	PATTERN_FIFO,
+	PATTERN_RANDOM,
+	PATTERN_BURST,
+	PATTERN_BATCH,
+	PATTERN_TOTAL
+} Pattern;
+
+char const * const astring[ALLOC_TOTAL] = {
 	"malloc",
-	"calloc",
-	"pool_single",
-	"pool_batched",
+	"pool_bitmap",
+	"pool_freelist",
+	"slab_pool",
+	"heap",
 	"arena"
 };
 
-char const * const blog[BENCH_TOTAL] = {
-	" malloc         :",
-	" calloc         :",
-	" pool (single)  :",
-	" pool (batched) :",
-	" arena          :"
+char const * const pstring[PATTERN_TOTAL] = {
+	"fill",
+	"lifo",
+	"fifo",
+	"random",
+	"burst",
+	"batch"
 };
 
-SimpleFunction const balloc[BENCH_TOTAL] = {
-	AllocMalloc,
-	AllocCalloc,
-	AllocPool,
-	AllocPool,
-	AllocArena
-};
+size_t const sizes[] = { 16, 64, 256 };
+size_t const capacities[] = { 1024, 65536, 262144 };
+unsigned int const occupancies[] = { 0, 50, 90 };
+size_t const quick_sizes[] = { 64 };
+size_t const quick_capacities[] = { 4096 };
+unsigned int const quick_occupancies[] = { 0, 90 };
 
-SimpleFunction const bfree[BENCH_TOTAL] = {
-	ReleaseMallocCalloc,
-	ReleaseMallocCalloc,
-	ReleasePoolSingle,
-	ReleasePoolBatched,
-	ReleaseArena
-};
+#define COUNT( array ) (sizeof( array ) / sizeof( array[0] ))
+// Results of a full sweep, the most a baseline can hold
+#define RESULTS_MAX (ALLOC_TOTAL * PATTERN_TOTAL * COUNT( sizes ) * COUNT( capacities ) * COUNT( occupancies ))
+
+/// Allocator under test, only the member of its kind is used
+typedef struct {
+	Allocator Kind;
+	size_t ElementSize;
+	size_t Capacity;
+	MemoryPool Pool;
+	MemorySlabPool Slabs;
+	MemoryHeap Heap;
+	MemoryArena Arena;
+} Subject;
+
+/// State of one benchmark case, every random number and payload is generated before the clock runs
+typedef struct {
+	Subject Subject;
+	void ** Live;
+	size_t Count;
+	uint64_t * Random;
+	size_t Randoms;
+	double * Samples;
+	size_t SampleCount;
+	size_t Operations;
+} Bench;
 
-double bttotal[BENCH_TOTAL][ITERATIONS] = {0};
-double btalloc[BENCH_TOTAL][ITERATIONS] = {0};
-double btfree[BENCH_TOTAL][ITERATIONS] = {0};
-double btmin[BENCH_TOTAL] = {0};
-double btmax[BENCH_TOTAL] = {0};
-double btmean[BENCH_TOTAL] = {0};
-double btsdev[BENCH_TOTAL] = {0};
+typedef struct {
+	char Allocator[NAME_MAX_LEN];
+	char Pattern[NAME_MAX_LEN];
+	size_t ElementSize;
+	size_t Capacity;
+	unsigned int Occupancy;
+	size_t Operations;
+	double Mean;
+	double P50;
+	double P99;
+	double P999;
+} Result;
+
+static uint64_t overhead = 0;
 
 static inline void PrintLine( char const * msg, char const * prefix, va_list args ) {
 	time_t t = time(NULL);
@@ -95,10 +121,10 @@ static inline void PrintLine( char const * msg, char const * prefix, va_list arg
 	char now_str[64];
 	strftime( now_str, sizeof( now_str ), "%F %T", now );
 	printf( "[%s]", now_str );
-	
+
 	if ( prefix )
 		printf( "[%s]", prefix );
-	
+
 	printf( ":" );
 	if ( msg )
 		vprintf( msg, args );
@@ -113,190 +139,704 @@ static inline void Info( char const * msg, ... ) {
 	va_end( args );
 }
 
-static inline void Debug( char const * msg, ... ) {
+static inline void Error( char const * msg, ... ) {
 	va_list args;
 	va_start( args, msg );
-	PrintLine( msg, "DBG", args );
+	PrintLine( msg, "ERR", args );
 	va_end( args );
 }
 
-static inline void Warning( char const * msg, ... ) {
-	va_list args;
-	va_start( args, msg );
-	PrintLine( msg, "WRN", args );
-	va_end( args );
+/// Monotonic clock in nanoseconds
+static inline uint64_t Now( void ) {
+#if defined( _WIN32 )
+	static LARGE_INTEGER frequency = { 0 };
+	LARGE_INTEGER counter;
+	if ( !frequency.QuadPart ) {
+		QueryPerformanceFrequency( &frequency );
+	}
+	QueryPerformanceCounter( &counter );
+	return (uint64_t)( (double)counter.QuadPart * 1e9 / (double)frequency.QuadPart );
+#else
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
 }
 
-static inline void Error( char const * msg, ... ) {
-	va_list args;
-	va_start( args, msg );
-	PrintLine( msg, "ERR", args );
-	va_end( args );
+/// Cost of reading the clock twice, subtracted from every sample
+static uint64_t Calibrate( void ) {
+	uint64_t lowest = UINT64_MAX;
+	for ( int i = 0; i < 10000; ++i ) {
+		uint64_t begin = Now();
+		uint64_t end = Now();
+		if ( end - begin < lowest ) {
+			lowest = end - begin;
+		}
+	}
+	return lowest;
+}
+
+static inline uint64_t XorShift( uint64_t * state ) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
 }
 
-static inline double Sum( double * numbers, int count ) {
-	double ret = 0;
-	for ( int i = 0; i < count; ++i )
-		ret += numbers[i];
+/// Maps the upper half of a random number onto [0, range) without a division
+static inline size_t Range( uint64_t random, size_t range ) {
+	return (size_t)( ( (random >> 32) * (uint64_t)range ) >> 32 );
+}
+
+static bool SubjectOpen( Subject * subject, Allocator kind, size_t element_size, size_t capacity ) {
+	*subject = (Subject) { .Kind = kind, .ElementSize = element_size, .Capacity = capacity };
+	switch ( kind ) {
+	case ALLOC_POOL_BITMAP:
+		subject->Pool = PoolCreate( element_size, capacity );
+		return subject->Pool.Raw != NULL;
+	case ALLOC_POOL_FREELIST:
+		subject->Pool = PoolCreateFreeList( element_size, capacity, false );
+		return subject->Pool.Raw != NULL;
+	case ALLOC_SLAB_POOL:
+		subject->Slabs = SlabPoolCreate( element_size, MMEM_SLAB_SIZE_DEFAULT );
+		return true;
+	case ALLOC_HEAP:
+		subject->Heap = HeapOpen();
+		return true;
+	case ALLOC_ARENA:
+		subject->Arena = ArenaCreate( element_size * capacity );
+		return subject->Arena.Raw != NULL;
+	default:
+		return true;
+	}
+}
 
-	return ret;
+static void SubjectClose( Subject * subject ) {
+	switch ( subject->Kind ) {
+	case ALLOC_POOL_BITMAP:
+	case ALLOC_POOL_FREELIST:
+		PoolDestroy( &subject->Pool );
+		break;
+	case ALLOC_SLAB_POOL:
+		SlabPoolDestroy( &subject->Slabs );
+		break;
+	case ALLOC_HEAP:
+		HeapClose( &subject->Heap );
+		break;
+	case ALLOC_ARENA:
+		ArenaDestroy( &subject->Arena );
+		break;
+	default:
+		break;
+	}
 }
 
-static inline double Timespan( clock_t begin, clock_t end ) {
-	return (double)(end - begin) / CLOCKS_PER_SEC;
+static inline void * SubjectAllocate( Subject * subject ) {
+	switch ( subject->Kind ) {
+	case ALLOC_MALLOC:
+		return malloc( subject->ElementSize );
+	case ALLOC_POOL_BITMAP:
+	case ALLOC_POOL_FREELIST:
+		return PoolAllocate( &subject->Pool );
+	case ALLOC_SLAB_POOL:
+		return SlabPoolAllocate( &subject->Slabs );
+	case ALLOC_HEAP:
+		return HeapAllocate( &subject->Heap, subject->ElementSize );
+	case ALLOC_ARENA:
+		return ArenaAllocate( &subject->Arena, subject->ElementSize );
+	default:
+		return NULL;
+	}
 }
 
-static inline double Measure( Benchmark benchmark, unsigned int seed, TestStruct ** params, int iteration ) {
-	Info( "Preparing benchmark %s, iteration %d", bstring[benchmark], iteration );
-	srand( seed );
+static inline void SubjectRelease( Subject * subject, void * element ) {
+	switch ( subject->Kind ) {
+	case ALLOC_MALLOC:
+		free( element );
+		break;
+	case ALLOC_POOL_BITMAP:
+	case ALLOC_POOL_FREELIST:
+		PoolRelease( &subject->Pool, element );
+		break;
+	case ALLOC_SLAB_POOL:
+		SlabPoolRelease( &subject->Slabs, element );
+		break;
+	case ALLOC_HEAP:
+		HeapRelease( &subject->Heap, element );
+		break;
+	default:
+		// Arenas only release everything at once
+		break;
+	}
+}
 
-	clock_t alloc_begin = 0;
-	clock_t free_begin = 0;
+/// Writes the payload into a fresh object, so the allocation is not measured without touching its memory
+static inline void Touch( Bench * bench, void * element, size_t index ) {
+	memcpy( element, &bench->Random[index & (bench->Randoms - 1)], sizeof( uint64_t ) );
+}
 
-	clock_t alloc_end = 0;
-	clock_t free_end = 0;
+static inline void Record( Bench * bench, uint64_t begin, uint64_t end, size_t operations ) {
+	uint64_t elapsed = end - begin > overhead ? end - begin - overhead : 0;
+	bench->Samples[bench->SampleCount++] = (double)elapsed / (double)operations;
+	bench->Operations += operations;
+}
 
-	// Info( "Starting allocation.." );
-	alloc_begin = clock();
-	balloc[benchmark]( params );
-	alloc_end = clock();
-	// Info( "Allocation took %lf seconds", Timespan( alloc_begin, alloc_end ) );
+static inline bool Push( Bench * bench, size_t index ) {
+	void * element = SubjectAllocate( &bench->Subject );
+	if ( !element ) {
+		return false;
+	}
+	Touch( bench, element, index );
+	bench->Live[bench->Count++] = element;
+	return true;
+}
 
-	// Info( "Starting deallocation.." );
-	free_begin = clock();
-	bfree[benchmark]( params );
-	free_end = clock();
-	// Info( "Deallocation took %lf seconds", Timespan( free_begin, free_end ) );
+/// Removes a random live object, untimed preparation only
+static void Drop( Bench * bench, size_t index ) {
+	size_t slot = Range( bench->Random[index & (bench->Randoms - 1)], bench->Count );
+	SubjectRelease( &bench->Subject, bench->Live[slot] );
+	bench->Live[slot] = bench->Live[--bench->Count];
+}
 
-	btalloc[benchmark][iteration] = Timespan( alloc_begin, alloc_end );
-	btfree[benchmark][iteration] = Timespan( free_begin, free_end );
-	bttotal[benchmark][iteration] = btalloc[benchmark][iteration] + btfree[benchmark][iteration];
-	if ( bttotal[benchmark][iteration] < btmin[benchmark] )
-		btmin[benchmark] = bttotal[benchmark][iteration];
+/// Allocates every remaining slot, then releases them in allocation order
+static bool RunFill( Bench * bench ) {
+	size_t start = bench->Count;
+	size_t capacity = bench->Subject.Capacity;
+
+	while ( bench->Count < capacity ) {
+		size_t operations = capacity - bench->Count < BATCH ? capacity - bench->Count : BATCH;
+		uint64_t begin = Now();
+		for ( size_t i = 0; i < operations; ++i ) {
+			if ( !Push( bench, bench->Count ) ) {
+				return false;
+			}
+		}
+		Record( bench, begin, Now(), operations );
+	}
 
-	if ( bttotal[benchmark][iteration] > btmax[benchmark] )
-		btmax[benchmark] = bttotal[benchmark][iteration];
+	if ( bench->Subject.Kind == ALLOC_ARENA ) {
+		ArenaReset( &bench->Subject.Arena );
+		bench->Count = 0;
+		return true;
+	}
 
-	return bttotal[benchmark][iteration];
+	for ( size_t index = start; index < capacity; index += BATCH ) {
+		size_t operations = capacity - index < BATCH ? capacity - index : BATCH;
+		uint64_t begin = Now();
+		for ( size_t i = 0; i < operations; ++i ) {
+			SubjectRelease( &bench->Subject, bench->Live[index + i] );
+		}
+		Record( bench, begin, Now(), operations );
+	}
+	bench->Count = start;
+	return true;
 }
 
-void AllocMalloc( TestStruct ** storage ) {
-	for ( int i = 0; i < STORAGE_SIZE; ++i ) {
-		storage[i] = malloc( sizeof( TestStruct ) );
-		storage[i]->x = rand();
-		storage[i]->y = rand();
-		storage[i]->value = (float)rand() / (float)RAND_MAX;
+/// Allocates a burst and releases it in reverse order, the pattern of scoped temporaries
+static bool RunLifo( Bench * bench ) {
+	if ( bench->Subject.Capacity - bench->Count < BURST ) {
+		return false;
 	}
+
+	for ( size_t done = 0; done < OPERATIONS; done += 2 * BURST ) {
+		uint64_t begin = Now();
+		for ( size_t i = 0; i < BURST; ++i ) {
+			if ( !Push( bench, done + i ) ) {
+				return false;
+			}
+		}
+		for ( size_t i = 0; i < BURST; ++i ) {
+			SubjectRelease( &bench->Subject, bench->Live[--bench->Count] );
+		}
+		Record( bench, begin, Now(), 2 * BURST );
+	}
+	return true;
 }
 
-void AllocCalloc( TestStruct ** storage ) {
-	for ( int i = 0; i < STORAGE_SIZE; ++i ) {
-		storage[i] = calloc( 1, sizeof( TestStruct ) );
-		storage[i]->x = rand();
-		storage[i]->y = rand();
-		storage[i]->value = (float)rand() / (float)RAND_MAX;
+/// Releases the oldest object of a queue and allocates a new one behind it, the pattern of message buffers
+static bool RunFifo( Bench * bench ) {
+	size_t depth = (bench->Subject.Capacity - bench->Count) / 2;
+	if ( !depth ) {
+		return false;
+	}
+
+	// The queue occupies the end of the live objects
+	size_t base = bench->Count;
+	for ( size_t i = 0; i < depth; ++i ) {
+		if ( !Push( bench, i ) ) {
+			return false;
+		}
 	}
+
+	size_t head = 0;
+	for ( size_t done = 0; done < OPERATIONS; done += BATCH ) {
+		uint64_t begin = Now();
+		for ( size_t i = 0; i < BATCH / 2; ++i ) {
+			void ** slot = &bench->Live[base + head];
+			SubjectRelease( &bench->Subject, *slot );
+			*slot = SubjectAllocate( &bench->Subject );
+			if ( !*slot ) {
+				return false;
+			}
+			Touch( bench, *slot, done + i );
+			head = head + 1 < depth ? head + 1 : 0;
+		}
+		Record( bench, begin, Now(), BATCH );
+	}
+	return true;
 }
 
-void AllocPool( TestStruct ** storage ) {
-	pool = PoolCreate( sizeof( TestStruct ), STORAGE_SIZE );
-	for ( int i = 0; i < STORAGE_SIZE; ++i ) {
-		storage[i] = PoolAllocate( &pool );
-		storage[i]->x = rand();
-		storage[i]->y = rand();
-		storage[i]->value = (float)rand() / (float)RAND_MAX;
+/// Interleaves allocations and releases of random objects, drifting around the occupancy of the case
+static bool RunRandom( Bench * bench, size_t target ) {
+	size_t capacity = bench->Subject.Capacity;
+	if ( target < BURST ) {
+		target = BURST;
+	}
+
+	for ( size_t done = 0; done < OPERATIONS; done += BATCH ) {
+		uint64_t begin = Now();
+		for ( size_t i = 0; i < BATCH; ++i ) {
+			uint64_t random = bench->Random[(done + i) & (bench->Randoms - 1)];
+			// Three out of four operations allocate below the target and release above it
+			bool allocate = bench->Count == 0 || ( bench->Count < capacity && ( random & 3 ) < ( bench->Count < target ? 3u : 1u ) );
+			if ( allocate ) {
+				if ( !Push( bench, done + i ) ) {
+					return false;
+				}
+			} else {
+				size_t slot = Range( random, bench->Count );
+				SubjectRelease( &bench->Subject, bench->Live[slot] );
+				bench->Live[slot] = bench->Live[--bench->Count];
+			}
+		}
+		Record( bench, begin, Now(), BATCH );
 	}
+	return true;
 }
 
-void AllocArena( TestStruct ** storage ) {
-	arena = ArenaCreate( sizeof( TestStruct ) * STORAGE_SIZE );
-	for ( int i = 0; i < STORAGE_SIZE; ++i ) {
-		storage[i] = ArenaAllocate( &arena, sizeof( TestStruct ) );
-		storage[i]->x = rand();
-		storage[i]->y = rand();
-		storage[i]->value = (float)rand() / (float)RAND_MAX;
+/// Allocates a burst and releases it in allocation order, at once with the batch functions of pools if batched is set
+static bool RunBurst( Bench * bench, bool batched ) {
+	Subject * subject = &bench->Subject;
+	size_t burst = subject->Capacity - bench->Count < BATCH_BURST ? subject->Capacity - bench->Count : BATCH_BURST;
+	if ( burst < BURST ) {
+		return false;
 	}
+
+	void ** elements = &bench->Live[bench->Count];
+	for ( size_t done = 0; done < OPERATIONS; done += 2 * burst ) {
+		uint64_t begin = Now();
+		size_t allocated = 0;
+		if ( batched ) {
+			allocated = PoolAllocateBatch( &subject->Pool, elements, burst );
+		} else {
+			while ( allocated < burst && ( elements[allocated] = SubjectAllocate( subject ) ) != NULL ) {
+				allocated++;
+			}
+		}
+		for ( size_t i = 0; i < allocated; ++i ) {
+			Touch( bench, elements[i], done + i );
+		}
+		if ( allocated < burst ) {
+			// Left to the release of every live object once the case ends
+			bench->Count += allocated;
+			return false;
+		}
+
+		if ( batched ) {
+			PoolReleaseBatch( &subject->Pool, elements, burst );
+		} else {
+			for ( size_t i = 0; i < burst; ++i ) {
+				SubjectRelease( subject, elements[i] );
+			}
+		}
+		Record( bench, begin, Now(), 2 * burst );
+	}
+	return true;
+}
+
+static int CompareSamples( void const * a, void const * b ) {
+	double lhs = *(double const *)a;
+	double rhs = *(double const *)b;
+	return (lhs > rhs) - (lhs < rhs);
+}
+
+static double Percentile( double const * sorted, size_t count, double quantile ) {
+	return count ? sorted[(size_t)( quantile * (double)(count - 1) + 0.5 )] : 0.0;
 }
 
-void ReleaseMallocCalloc( TestStruct ** storage ) {
-	for ( int i = 0; i < STORAGE_SIZE; ++i ) {
-		free( storage[i] );
+static bool Measure( Bench * bench, Allocator kind, Pattern pattern, size_t element_size, size_t capacity, unsigned int occupancy, Result * result ) {
+	if ( !SubjectOpen( &bench->Subject, kind, element_size, capacity ) ) {
+		return false;
 	}
+
+	// Fill up and release random objects down to the occupancy, so the free slots are scattered
+	bench->Count = 0;
+	bench->SampleCount = 0;
+	bench->Operations = 0;
+	size_t target = capacity * occupancy / 100;
+	bool valid = true;
+	if ( occupancy ) {
+		for ( size_t i = 0; i < capacity && valid; ++i ) {
+			valid = Push( bench, i );
+		}
+		for ( size_t i = 0; bench->Count > target; ++i ) {
+			Drop( bench, i );
+		}
+	}
+
+	if ( valid ) {
+		switch ( pattern ) {
+		case PATTERN_FILL:
+			valid = RunFill( bench );
+			break;
+		case PATTERN_LIFO:
+			valid = RunLifo( bench );
+			break;
+		case PATTERN_FIFO:
+			valid = RunFifo( bench );
+			break;
+		case PATTERN_BURST:
+			valid = RunBurst( bench, false );
+			break;
+		case PATTERN_BATCH:
+			valid = RunBurst( bench, true );
+			break;
+		default:
+			valid = RunRandom( bench, target );
+			break;
+		}
+	}
+
+	if ( kind != ALLOC_ARENA ) {
+		for ( size_t i = 0; i < bench->Count; ++i ) {
+			SubjectRelease( &bench->Subject, bench->Live[i] );
+		}
+	}
+	SubjectClose( &bench->Subject );
+	if ( !valid ) {
+		return false;
+	}
+
+	double sum = 0.0;
+	for ( size_t i = 0; i < bench->SampleCount; ++i ) {
+		sum += bench->Samples[i];
+	}
+	qsort( bench->Samples, bench->SampleCount, sizeof( double ), CompareSamples );
+
+	*result = (Result) {
+		.ElementSize = element_size,
+		.Capacity = capacity,
+		.Occupancy = occupancy,
+		.Operations = bench->Operations,
+		.Mean = bench->SampleCount ? sum / (double)bench->SampleCount : 0.0,
+		.P50 = Percentile( bench->Samples, bench->SampleCount, 0.50 ),
+		.P99 = Percentile( bench->Samples, bench->SampleCount, 0.99 ),
+		.P999 = Percentile( bench->Samples, bench->SampleCount, 0.999 )
+	};
+	snprintf( result->Allocator, NAME_MAX_LEN, "%s", astring[kind] );
+	snprintf( result->Pattern, NAME_MAX_LEN, "%s", pstring[pattern] );
+	return true;
 }
 
-void ReleasePoolSingle( TestStruct ** storage ) {
-	for ( int i = 0; i < STORAGE_SIZE; ++i ) {
-		PoolRelease( &pool, storage[i] );
+static void WriteCsv( char const * path, Result const * results, size_t count ) {
+	FILE * f = fopen( path, "w+" );
+	if ( !f ) {
+		Error( "Cannot write %s", path );
+		return;
+	}
+	fprintf( f, "Allocator;Pattern;ElementSize;Capacity;Occupancy;Operations;Mean;P50;P99;P999" );
+	for ( size_t i = 0; i < count; ++i ) {
+		Result const * r = &results[i];
+		fprintf( f, "\n%s;%s;%zu;%zu;%u;%zu;%.3lf;%.3lf;%.3lf;%.3lf", r->Allocator, r->Pattern, r->ElementSize, r->Capacity, r->Occupancy, r->Operations, r->Mean, r->P50, r->P99, r->P999 );
 	}
-	PoolDestroy( &pool );
+	fclose( f );
 }
 
-void ReleasePoolBatched( TestStruct ** storage ) {
-	(void)(storage);
-	PoolDestroy( &pool );
+static void WriteJson( char const * path, Result const * results, size_t count ) {
+	FILE * f = fopen( path, "w+" );
+	if ( !f ) {
+		Error( "Cannot write %s", path );
+		return;
+	}
+	fprintf( f, "[" );
+	for ( size_t i = 0; i < count; ++i ) {
+		Result const * r = &results[i];
+		fprintf( f, "%s\n\t{ \"allocator\": \"%s\", \"pattern\": \"%s\", \"element_size\": %zu, \"capacity\": %zu, \"occupancy\": %u, \"operations\": %zu, \"mean_ns\": %.3lf, \"p50_ns\": %.3lf, \"p99_ns\": %.3lf, \"p999_ns\": %.3lf }",
+			i ? "," : "", r->Allocator, r->Pattern, r->ElementSize, r->Capacity, r->Occupancy, r->Operations, r->Mean, r->P50, r->P99, r->P999 );
+	}
+	fprintf( f, "\n]\n" );
+	fclose( f );
 }
 
-void ReleaseArena( TestStruct ** storage ) {
-	(void)(storage);
-	ArenaDestroy( &arena );
+/// Reads results written by WriteCsv, returns the number of results read
+static size_t ReadCsv( char const * path, Result * results, size_t capacity ) {
+	FILE * f = fopen( path, "r" );
+	if ( !f ) {
+		return 0;
+	}
+
+	char line[512];
+	size_t count = 0;
+	while ( count < capacity && fgets( line, sizeof( line ), f ) ) {
+		Result * r = &results[count];
+		int fields = sscanf( line, "%31[^;];%31[^;];%zu;%zu;%u;%zu;%lf;%lf;%lf;%lf", r->Allocator, r->Pattern, &r->ElementSize, &r->Capacity, &r->Occupancy, &r->Operations, &r->Mean, &r->P50, &r->P99, &r->P999 );
+		// The header line does not parse past the names
+		if ( fields == 10 ) {
+			count++;
+		}
+	}
+	fclose( f );
+	return count;
 }
 
-int main(void) {
-	for ( Benchmark bench = 0; bench < BENCH_TOTAL; ++bench ) {
-		btmin[bench] = 10000000;
+/// Compares the medians against a baseline, returns the number of cases slower by more than threshold percent
+static size_t Compare( Result const * results, size_t count, Result const * baseline, size_t baseline_count, double threshold ) {
+	size_t regressions = 0;
+	printf( "%-14s %-7s %6s %8s %4s %10s %10s %8s %8s\n", "Allocator", "Pattern", "Size", "Capacity", "Occ", "Base p50", "p50", "Delta", "p99 Delta" );
+	for ( size_t i = 0; i < count; ++i ) {
+		Result const * r = &results[i];
+		Result const * b = NULL;
+		for ( size_t j = 0; j < baseline_count && !b; ++j ) {
+			if ( !strcmp( baseline[j].Allocator, r->Allocator ) && !strcmp( baseline[j].Pattern, r->Pattern ) && baseline[j].ElementSize == r->ElementSize && baseline[j].Capacity == r->Capacity && baseline[j].Occupancy == r->Occupancy ) {
+				b = &baseline[j];
+			}
+		}
+		if ( !b || b->P50 <= 0.0 ) {
+			continue;
+		}
+
+		double delta = (r->P50 - b->P50) / b->P50 * 100.0;
+		double delta_tail = b->P99 > 0.0 ? (r->P99 - b->P99) / b->P99 * 100.0 : 0.0;
+		bool regressed = delta > threshold;
+		regressions += regressed ? 1 : 0;
+		printf( "%-14s %-7s %6zu %8zu %3u%% %10.2lf %10.2lf %+7.1lf%% %+7.1lf%%%s\n", r->Allocator, r->Pattern, r->ElementSize, r->Capacity, r->Occupancy, b->P50, r->P50, delta, delta_tail, regressed ? "  REGRESSION" : "" );
 	}
+	return regressions;
+}
 
-	TestStruct ** storage = calloc( STORAGE_SIZE, sizeof( TestStruct * ) );
+#if MMEM_PROFILE
+// Object sizes of the profiler check in percent of the sampling rate, the last case allocates all of them in turn
+unsigned int const profile_sizes[] = { 25, 50, 100, 146, 200, 400 };
 
-	for ( int i = 0; i < ITERATIONS; ++i ) {
-		unsigned int seed = (unsigned int)clock();
+/// Sum of the live bytes the profiler estimates over every call site
+static uint64_t ProfileEstimate( MemoryProfile const * profile ) {
+	uint64_t live = 0;
+	for ( size_t i = 0; i < MMEM_PROFILE_SITES; ++i ) {
+		live += profile->Sites[i].Live;
+	}
+	return live;
+}
 
-		for ( Benchmark bench = 0; bench < BENCH_TOTAL; ++bench ) {
-			// Info( "%s %lf seconds", blog[bench], Measure( bench, seed, storage, i ) );
-			Measure( bench, seed, storage, i );
+static bool ProfileReport( char const * kind, size_t size, uint64_t live, uint64_t estimate ) {
+	double delta = live ? ( (double)estimate - (double)live ) / (double)live * 100.0 : 0.0;
+	bool failed = delta > PROFILE_THRESHOLD || delta < -PROFILE_THRESHOLD;
+	printf( "%-6s %8zu %12llu %12llu %+7.1lf%%%s\n", kind, size, (unsigned long long)live, (unsigned long long)estimate, delta, failed ? "  FAILED" : "" );
+	return failed;
+}
+
+/// Compares the live bytes estimated by the profiler against the actual ones for object sizes around the sampling rate
+static size_t ProfileCheck( void ) {
+	size_t failures = 0;
+	ProfileSetRate( PROFILE_RATE );
+	printf( "%-6s %8s %12s %12s %8s\n", "Kind", "Size", "Live", "Estimate", "Delta" );
+
+	// Pools release every other object, so the estimate has to follow releases as well
+	for ( size_t i = 0; i < COUNT( profile_sizes ); ++i ) {
+		size_t size = PROFILE_RATE * profile_sizes[i] / 100;
+		size_t capacity = 2 * PROFILE_LIVE / size;
+		MemoryPool pool = PoolCreate( size, capacity );
+		if ( !pool.Raw || !ProfilePool( &pool, "check" ) ) {
+			Error( "Cannot profile a pool of %zu objects of %zu bytes", capacity, size );
+			PoolDestroy( &pool );
+			failures++;
+			continue;
+		}
+		void ** objects = malloc( capacity * sizeof( void * ) );
+		for ( size_t j = 0; objects && j < capacity; ++j ) {
+			objects[j] = PoolAllocate( &pool );
 		}
+		for ( size_t j = 1; objects && j < capacity; j += 2 ) {
+			PoolRelease( &pool, objects[j] );
+		}
+		failures += ProfileReport( "pool", size, (uint64_t)( PoolSlotsInUse( &pool ) * size ), ProfileEstimate( pool.Profile ) ) ? 1 : 0;
+		free( objects );
+		PoolDestroy( &pool );
 	}
 
-	for ( Benchmark bench = 0; bench < BENCH_TOTAL; ++bench ) {
-		btmean[bench] = Sum( bttotal[bench], ITERATIONS ) / ITERATIONS;
+	// Arenas see the sizes mixed, the probability of a sample must not depend on the allocations before it
+	MemoryArena arena = ArenaCreate( 2 * PROFILE_LIVE );
+	if ( !arena.Raw || !ProfileArena( &arena, "check" ) ) {
+		Error( "Cannot profile an arena of %d bytes", 2 * PROFILE_LIVE );
+		ArenaDestroy( &arena );
+		return failures + 1;
 	}
+	uint64_t live = 0;
+	for ( size_t j = 0; live < PROFILE_LIVE; ++j ) {
+		size_t size = PROFILE_RATE * profile_sizes[j % COUNT( profile_sizes )] / 100;
+		if ( !ArenaAllocate( &arena, size ) ) {
+			break;
+		}
+		live += size;
+	}
+	failures += ProfileReport( "arena", 0, live, ProfileEstimate( arena.Profile ) ) ? 1 : 0;
+	ArenaDestroy( &arena );
+	return failures;
+}
+#endif
+
+static void Usage( char const * program ) {
+	printf( "Usage: %s [options]\n", program );
+	printf( "  --quick              Run a single size, capacity and two occupancies\n" );
+	printf( "  --allocator <name>   Only run the named allocator (malloc, pool_bitmap, pool_freelist, slab_pool, heap, arena)\n" );
+	printf( "  --pattern <name>     Only run the named pattern (fill, lifo, fifo, random, burst, batch)\n" );
+	printf( "  --csv <path>         Write the results as CSV (default mmem.bench.csv)\n" );
+	printf( "  --json <path>        Write the results as JSON as well\n" );
+	printf( "  --compare <path>     Compare the medians against a CSV baseline, fails on regressions\n" );
+	printf( "  --threshold <pct>    Median increase reported as regression (default %.0lf)\n", THRESHOLD );
+	printf( "  --repeat <n>         Run every case n times and keep the run with the lowest median (default 1)\n" );
+#if MMEM_PROFILE
+	printf( "  --profile-check      Compare the live bytes estimated by the profiler against the actual ones, fails on deviations\n" );
+#endif
+}
 
-	for ( Benchmark bench = 0; bench < BENCH_TOTAL; ++bench ) {
-		double ssq_diff = 0;
-
-		for ( int i = 0; i < ITERATIONS; ++i ) {
-			double diff = bttotal[bench][i] - btmean[bench];
-			ssq_diff += diff * diff;
+int main( int argc, char ** argv ) {
+	char const * csv = "mmem.bench.csv";
+	char const * json = NULL;
+	char const * compare = NULL;
+	char const * only_allocator = NULL;
+	char const * only_pattern = NULL;
+	double threshold = THRESHOLD;
+	unsigned long repeat = 1;
+	bool quick = false;
+
+	for ( int i = 1; i < argc; ++i ) {
+		bool value = i + 1 < argc;
+		if ( !strcmp( argv[i], "--quick" ) ) {
+			quick = true;
+		} else if ( !strcmp( argv[i], "--csv" ) && value ) {
+			csv = argv[++i];
+		} else if ( !strcmp( argv[i], "--json" ) && value ) {
+			json = argv[++i];
+		} else if ( !strcmp( argv[i], "--compare" ) && value ) {
+			compare = argv[++i];
+		} else if ( !strcmp( argv[i], "--threshold" ) && value ) {
+			threshold = strtod( argv[++i], NULL );
+		} else if ( !strcmp( argv[i], "--repeat" ) && value ) {
+			repeat = strtoul( argv[++i], NULL, 10 );
+		} else if ( !strcmp( argv[i], "--allocator" ) && value ) {
+			only_allocator = argv[++i];
+		} else if ( !strcmp( argv[i], "--pattern" ) && value ) {
+			only_pattern = argv[++i];
+#if MMEM_PROFILE
+		} else if ( !strcmp( argv[i], "--profile-check" ) ) {
+			size_t failures = ProfileCheck();
+			Info( "%zu profiler cases deviated by more than %.1lf%%", failures, PROFILE_THRESHOLD );
+			return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+#endif
+		} else {
+			Usage( argv[0] );
+			return EXIT_FAILURE;
 		}
-		btsdev[bench] = sqrt( ssq_diff / ITERATIONS );
 	}
 
-	Info( "Test finished. saving results.." );
-	FILE * f = fopen( "benchmarks.csv", "w+" );
-	fprintf( f, "Benchmark;Allocation;Free;Total;Lowest;Highest;Mean;Standard Deviation" );
-
-	for ( Benchmark bench = 0; bench < BENCH_TOTAL; ++bench ) {
-		FILE * fbench = fopen( bfile[bench], "w+" );
-		fprintf( fbench, "Iteration;Allocation;Free;Total" );
-		for ( int i = 0; i < ITERATIONS; ++i ) {
-			fprintf( fbench, "\n%d;%lf;%lf;%lf", i + 1, btalloc[bench][i], btfree[bench][i], bttotal[bench][i] );
+	size_t const * sweep_sizes = quick ? quick_sizes : sizes;
+	size_t const * sweep_capacities = quick ? quick_capacities : capacities;
+	unsigned int const * sweep_occupancies = quick ? quick_occupancies : occupancies;
+	size_t size_count = quick ? COUNT( quick_sizes ) : COUNT( sizes );
+	size_t capacity_count = quick ? COUNT( quick_capacities ) : COUNT( capacities );
+	size_t occupancy_count = quick ? COUNT( quick_occupancies ) : COUNT( occupancies );
+
+	size_t capacity_max = 0;
+	for ( size_t i = 0; i < capacity_count; ++i ) {
+		capacity_max = sweep_capacities[i] > capacity_max ? sweep_capacities[i] : capacity_max;
+	}
+
+	// Random numbers double as payloads, their count is a power of two to wrap around with a mask
+	Bench bench = { .Randoms = OPERATIONS };
+	size_t sample_max = ( 2 * capacity_max > OPERATIONS ? 2 * capacity_max : OPERATIONS ) / BATCH + 2;
+	size_t result_max = ALLOC_TOTAL * PATTERN_TOTAL * size_count * capacity_count * occupancy_count;
+	bench.Live = malloc( capacity_max * sizeof( void * ) );
+	bench.Random = malloc( bench.Randoms * sizeof( uint64_t ) );
+	bench.Samples = malloc( sample_max * sizeof( double ) );
+	Result * results = malloc( result_max * sizeof( Result ) );
+	if ( !bench.Live || !bench.Random || !bench.Samples || !results ) {
+		Error( "Out of memory" );
+		return EXIT_FAILURE;
+	}
+
+	uint64_t state = 0x9E3779B97F4A7C15u;
+	for ( size_t i = 0; i < bench.Randoms; ++i ) {
+		bench.Random[i] = XorShift( &state );
+	}
+	overhead = Calibrate();
+	Info( "Clock overhead %llu ns, %d operations per sample", (unsigned long long)overhead, BATCH );
+
+	size_t count = 0;
+	printf( "%-14s %-7s %6s %8s %4s %10s %8s %8s %8s %8s\n", "Allocator", "Pattern", "Size", "Capacity", "Occ", "Operations", "Mean", "p50", "p99", "p999" );
+	for ( Allocator kind = 0; kind < ALLOC_TOTAL; ++kind ) {
+		if ( only_allocator && strcmp( only_allocator, astring[kind] ) ) {
+			continue;
+		}
+		for ( Pattern pattern = 0; pattern < PATTERN_TOTAL; ++pattern ) {
+			// Arenas release all objects at once, they only take part in the fill pattern. Only pools have batch functions
+			bool pool = kind == ALLOC_POOL_BITMAP || kind == ALLOC_POOL_FREELIST;
+			if ( ( only_pattern && strcmp( only_pattern, pstring[pattern] ) ) || ( kind == ALLOC_ARENA && pattern != PATTERN_FILL ) || ( !pool && pattern == PATTERN_BATCH ) ) {
+				continue;
+			}
+			for ( size_t s = 0; s < size_count; ++s ) {
+				for ( size_t c = 0; c < capacity_count; ++c ) {
+					for ( size_t o = 0; o < occupancy_count; ++o ) {
+						if ( kind == ALLOC_ARENA && sweep_occupancies[o] ) {
+							continue;
+						}
+						Result * r = &results[count];
+						Result run;
+						bool measured = false;
+						for ( unsigned long n = 0; n < repeat || !n; ++n ) {
+							if ( !Measure( &bench, kind, pattern, sweep_sizes[s], sweep_capacities[c], sweep_occupancies[o], &run ) ) {
+								break;
+							}
+							if ( !measured || run.P50 < r->P50 ) {
+								*r = run;
+							}
+							measured = true;
+						}
+						if ( !measured ) {
+							Error( "%s %s size %zu capacity %zu occupancy %u failed", astring[kind], pstring[pattern], sweep_sizes[s], sweep_capacities[c], sweep_occupancies[o] );
+							continue;
+						}
+						printf( "%-14s %-7s %6zu %8zu %3u%% %10zu %8.2lf %8.2lf %8.2lf %8.2lf\n", r->Allocator, r->Pattern, r->ElementSize, r->Capacity, r->Occupancy, r->Operations, r->Mean, r->P50, r->P99, r->P999 );
+						count++;
+					}
+				}
+			}
 		}
-		fclose( fbench );
+	}
 
-		fprintf( f,
-			"\n%s;%lf;%lf;%lf;%lf;%lf;%lf;%lf",
-			bstring[bench],
-			Sum( btalloc[bench], ITERATIONS ),
-			Sum( btfree[bench], ITERATIONS ),
-			Sum( bttotal[bench], ITERATIONS),
-			btmin[bench],
-			btmax[bench],
-			btmean[bench],
-			btsdev[bench]
-		);
+	Info( "Test finished. saving results.." );
+	WriteCsv( csv, results, count );
+	if ( json ) {
+		WriteJson( json, results, count );
 	}
 
-	fclose( f );
+	int status = EXIT_SUCCESS;
+	if ( compare ) {
+		Result * baseline = malloc( RESULTS_MAX * sizeof( Result ) );
+		size_t baseline_count = baseline ? ReadCsv( compare, baseline, RESULTS_MAX ) : 0;
+		if ( !baseline_count ) {
+			Error( "No results in baseline %s", compare );
+			status = EXIT_FAILURE;
+		} else {
+			size_t regressions = Compare( results, count, baseline, baseline_count, threshold );
+			Info( "%zu of %zu cases regressed by more than %.1lf%%", regressions, count, threshold );
+			status = regressions ? EXIT_FAILURE : EXIT_SUCCESS;
+		}
+		free( baseline );
+	}
 
-    return EXIT_SUCCESS;
+	free( results );
+	free( bench.Samples );
+	free( bench.Random );
+	free( bench.Live );
+	return status;
 }
@@ -1,184 +1,3369 @@
+#if defined( __linux__ ) && !defined( _GNU_SOURCE )
+#define _GNU_SOURCE
+#endif
+
 #include "mmem.h"
+#include "mmem.bitmap.h"
 
+#include <stdint.h>
 #include <string.h>
+#if MMEM_STATS
+#include <stdarg.h>
+#include <stdio.h>
+#endif
+#if MMEM_PROFILE
+#include <math.h>
+#endif
+#if MMEM_PROFILE && ( defined( __unix__ ) || defined( __APPLE__ ) )
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#if defined( __GLIBC__ ) || defined( __APPLE__ )
+#include <execinfo.h>
+#define MMEM_BACKTRACE 1
+#endif
+#endif
+#if defined( _WIN32 )
+#include <malloc.h>
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#define MMEM_VIRTUAL_MEMORY 1
+#elif defined( __unix__ ) || defined( __APPLE__ )
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined( __linux__ )
+#include <sys/syscall.h>
+#endif
+#define MMEM_VIRTUAL_MEMORY 1
+#else
+#define MMEM_VIRTUAL_MEMORY 0
+#endif
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define MMEM_STREAM_STORES 1
+#else
+#define MMEM_STREAM_STORES 0
+#endif
+
+/// @brief Zeroes a range, large ranges with non-temporal stores so the reset does not evict the working set
+static inline void ZeroRange( void * memory, size_t const size ) {
+#if MMEM_STREAM_STORES
+	if ( size >= MMEM_ZERO_STREAM_MIN ) {
+		char * bytes = memory;
+		size_t head = (size_t)(0 - (uintptr_t)bytes) & 15;
+		size_t body = (size - head) & ~(size_t)63;
+		__m128i const zero = _mm_setzero_si128();
+
+		memset( bytes, 0x00, head );
+		for ( char * line = bytes + head; line < bytes + head + body; line += 64 ) {
+			_mm_stream_si128( (__m128i *)line, zero );
+			_mm_stream_si128( (__m128i *)(line + 16), zero );
+			_mm_stream_si128( (__m128i *)(line + 32), zero );
+			_mm_stream_si128( (__m128i *)(line + 48), zero );
+		}
+		_mm_sfence();
+		memset( bytes + head + body, 0x00, size - head - body );
+		return;
+	}
+#endif
+	memset( memory, 0x00, size );
+}
+
+// Zeroing of instances with a zero policy, constant policies fold the check away in specialized routines
+static inline void ZeroOnAllocateAs( unsigned int const zero, void * element, size_t const size ) {
+	if ( zero == MMEM_ZERO_POLICY_ONALLOCATE ) {
+		memset( element, 0x00, size );
+	}
+}
+
+static inline void ZeroOnReleaseAs( unsigned int const zero, void * element, size_t const size ) {
+	if ( zero == MMEM_ZERO_POLICY_ONRELEASE ) {
+		ZeroRange( element, size );
+	}
+}
+
+static inline void ZeroOnAllocate( void * element, size_t const size ) {
+	ZeroOnAllocateAs( MMEM_ZERO_POLICY, element, size );
+}
 
-typedef unsigned int bitslot_t;
-#define SLOT_BITS ((bitslot_t)sizeof( bitslot_t ) * 8)
+static inline void ZeroOnRelease( void * element, size_t const size ) {
+	ZeroOnReleaseAs( MMEM_ZERO_POLICY, element, size );
+}
+
+static inline void * Allocate( size_t const capacity, size_t const size ) {
+#if MMEM_ZERO_POLICY != MMEM_ZERO_POLICY_ONRELEASE
+	// calloc checks the product itself
+	return size && capacity > SIZE_MAX / size ? NULL : malloc( capacity * size );
+#else
+	return calloc( capacity, size );
+#endif
+}
 
-static inline bitslot_t bitmask( unsigned int bit ) {
-	return 1 << ( bit % SLOT_BITS );
+/// @brief Policy of the creation options, or the compile-time policy for MMEM_ZERO_DEFAULT
+static inline unsigned int ZeroPolicyOf( unsigned int const option ) {
+	return option >= MMEM_ZERO_ONALLOCATE && option <= MMEM_ZERO_MANUAL ? option - 1 : MMEM_ZERO_POLICY;
 }
 
-static inline bitslot_t bitslot( unsigned int bit ) {
-	return bit / SLOT_BITS;
+/// @brief Policy of the creation options, or the compile-time policy for MMEM_ALIGN_DEFAULT
+static inline unsigned int AlignmentPolicyOf( unsigned int const option ) {
+	switch ( option ) {
+	case MMEM_ALIGN_NONE:
+		return MMEM_ALIGNMENT_POLICY_NONE;
+	case MMEM_ALIGN_CACHELINE:
+		return MMEM_ALIGNMENT_POLICY_HEAP;
+	default:
+		return MMEM_ALIGNMENT_POLICY;
+	}
 }
 
-static inline void bitset( bitslot_t * set, unsigned int bit ) {
-	set[bitslot( bit )] |= bitmask( bit );
+#if MMEM_STATS
+// Counter updates of the statistics layer, compiled out entirely without MMEM_STATS
+#define STATS( statement ) statement
+
+/// @brief Counts an allocation, p_in_use is the number of slots or bytes in use after it
+static inline void StatsAllocation( MemoryCounters * p_counters, bool const p_success, size_t const p_in_use ) {
+	if ( !p_success ) {
+		p_counters->Failures++;
+		return;
+	}
+	p_counters->Allocations++;
+	if ( p_in_use > p_counters->Peak ) {
+		p_counters->Peak = p_in_use;
+	}
 }
 
-static inline void bitclear( bitslot_t * set, unsigned int bit ) {
-	set[bitslot( bit )] &= ~bitmask( bit );
+/// @brief Counts a batch allocation of p_allocated out of p_requested objects, a short batch counts as one failure
+static inline void StatsAllocationBatch( MemoryCounters * p_counters, size_t const p_allocated, size_t const p_requested, size_t const p_in_use ) {
+	p_counters->Allocations += p_allocated;
+	if ( p_allocated < p_requested ) {
+		p_counters->Failures++;
+	}
+	if ( p_in_use > p_counters->Peak ) {
+		p_counters->Peak = p_in_use;
+	}
 }
 
-static inline int bittest( bitslot_t * set, unsigned int bit ) {
-	return (int)( set[bitslot( bit )] & bitmask( bit ) );
+/// @brief Counts a slot search reading p_words bitmap words into the histogram bucket of its bit length
+static inline void StatsScan( MemoryCounters * p_counters, size_t p_words ) {
+	size_t bucket = 0;
+	while ( p_words && bucket < MMEM_STATS_SCAN_BUCKETS - 1 ) {
+		p_words >>= 1;
+		bucket++;
+	}
+	p_counters->Scans[bucket]++;
 }
 
-static inline bitslot_t bitslots( unsigned int bits ) {
-	return (bits + SLOT_BITS - 1) / SLOT_BITS;
+static inline void StatsZeroed( MemoryCounters * p_counters, bool const p_zeroed, size_t const p_bytes ) {
+	if ( p_zeroed ) {
+		p_counters->BytesZeroed += p_bytes;
+	}
 }
+#else
+#define STATS( statement )
+#endif
+
+#if MMEM_PROFILE
+// Hooks of the sampling profiler, compiled out entirely without MMEM_PROFILE
+#define PROFILE( statement ) statement
 
-static inline size_t Align( size_t unaligned ) {
-#if MMEM_ALIGNMENT_POLCY & MMEM_ALIGNMENT_POLICY_HEAP
-	return unaligned + (MMEM_ALIGNMENT_CACHELINE - unaligned % MMEM_ALIGNMENT_CACHELINE);
+static void ProfileForget( MemoryProfile * profile, uint64_t const position );
+static void ProfileMove( MemoryProfile * profile, void * from, void * to );
 #else
-	return unaligned;
+#define PROFILE( statement )
 #endif
+
+/// @brief Alignment every allocation of malloc/calloc is guaranteed to have
+#define MMEM_ALIGNMENT_ALLOCATOR (2 * sizeof( void * ))
+
+static inline uintptr_t AlignAddress( uintptr_t const address, size_t const alignment ) {
+	return (address + alignment - 1) & ~(uintptr_t)(alignment - 1);
 }
 
-static inline void ZeroOnAllocate( void * element, size_t const size ) {
-#if MMEM_ZERO_POLICY == MMEM_ZERO_POLICY_ONALLOCATE
-	memset( element, 0x00, size );
+static inline size_t NextPowerOfTwo( size_t value ) {
+	size_t power = 1;
+	while ( power < value ) {
+		power <<= 1;
+	}
+	return power;
+}
+
+static void * AllocateAligned( size_t const size, size_t const alignment, bool const zero ) {
+	void * ptr = NULL;
+#if defined( _WIN32 )
+	ptr = _aligned_malloc( size, alignment );
 #else
-	(void)(element); (void)(size);
-	return;
+	if ( posix_memalign( &ptr, alignment, size ) != 0 ) {
+		return NULL;
+	}
 #endif
+	if ( ptr && zero ) {
+		memset( ptr, 0x00, size );
+	}
+	return ptr;
 }
 
-static inline void ZeroOnRelease( void * element, size_t const size ) {
-#if MMEM_ZERO_POLICY == MMEM_ZERO_POLICY_ONRELEASE
-	memset( element, 0x00, size );
+static void ReleaseAligned( void * memory ) {
+#if defined( _WIN32 )
+	_aligned_free( memory );
 #else
-	(void)(element); (void)(size);
-	return;
+	free( memory );
 #endif
 }
 
-static inline void * Allocate( size_t const capacity, size_t const size ) {
-#if MMEM_ZERO_POLICY != MMEM_ZERO_POLICY_ONRELEASE
-	return malloc( Align( capacity ) * size );
+static size_t PageSize( void ) {
+#if defined( _WIN32 )
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return (size_t)info.dwPageSize;
+#elif MMEM_VIRTUAL_MEMORY
+	long page = sysconf( _SC_PAGESIZE );
+	return page > 0 ? (size_t)page : 4096;
+#else
+	return 4096;
+#endif
+}
+
+/// @brief Reserves address space without committing any memory to it
+static void * VirtualReserve( size_t const size ) {
+#if defined( _WIN32 )
+	return VirtualAlloc( NULL, size, MEM_RESERVE, PAGE_NOACCESS );
+#elif MMEM_VIRTUAL_MEMORY
+#if defined( MAP_NORESERVE )
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+#else
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#endif
+	void * memory = mmap( NULL, size, PROT_NONE, flags, -1, 0 );
+	return memory == MAP_FAILED ? NULL : memory;
+#else
+	(void)(size);
+	return NULL;
+#endif
+}
+
+static bool VirtualCommit( void * memory, size_t const size ) {
+#if defined( _WIN32 )
+	return VirtualAlloc( memory, size, MEM_COMMIT, PAGE_READWRITE ) != NULL;
+#elif MMEM_VIRTUAL_MEMORY
+	return mprotect( memory, size, PROT_READ | PROT_WRITE ) == 0;
+#else
+	(void)(memory); (void)(size);
+	return false;
+#endif
+}
+
+/// @brief Returns the pages to the operating system, they read as zero once committed again
+static void VirtualDecommit( void * memory, size_t const size ) {
+#if defined( _WIN32 )
+	VirtualFree( memory, size, MEM_DECOMMIT );
+#elif MMEM_VIRTUAL_MEMORY
+	madvise( memory, size, MADV_DONTNEED );
+	mprotect( memory, size, PROT_NONE );
+#else
+	(void)(memory); (void)(size);
+#endif
+}
+
+/// @brief Drops the contents of committed pages, which stay accessible and read as zero once touched again
+static bool VirtualDiscard( void * memory, size_t const size ) {
+#if defined( __linux__ )
+	return madvise( memory, size, MADV_DONTNEED ) == 0;
+#else
+	// Elsewhere discarded pages keep undefined contents or have to be committed again, neither suits heap memory
+	(void)(memory); (void)(size);
+	return false;
+#endif
+}
+
+static void VirtualRelease( void * memory, size_t const size ) {
+#if defined( _WIN32 )
+	(void)(size);
+	VirtualFree( memory, 0, MEM_RELEASE );
+#elif MMEM_VIRTUAL_MEMORY
+	munmap( memory, size );
+#else
+	(void)(memory); (void)(size);
+#endif
+}
+
+#if defined( __linux__ ) && !defined( MAP_HUGE_SHIFT )
+#define MAP_HUGE_SHIFT 26
+#endif
+
+/// @brief Number of bytes a built-in provider maps for a request, in whole pages of the provider
+static size_t ProviderBytes( MemoryProvider const * p_provider, size_t const p_size ) {
+	size_t page = p_provider->PageSize ? p_provider->PageSize : p_provider->Transparent ? MMEM_PAGE_2M : PageSize();
+	if ( p_size > SIZE_MAX - page ) {
+		return 0;
+	}
+	return (size_t)AlignAddress( p_size ? p_size : 1, page );
+}
+
+/// @brief Applies the NUMA policy of the provider to untouched memory, pages are placed when they are first touched
+static void ProviderPlace( MemoryProvider const * p_provider, void * p_memory, size_t const p_bytes ) {
+#if defined( __linux__ ) && defined( SYS_mbind )
+	// Policy numbers of the kernel ( MPOL_LOCAL/MPOL_BIND/MPOL_INTERLEAVE ), numaif.h is not part of the C library
+	static int const policies[] = { 0, 4, 2, 3 };
+	if ( p_provider->Numa == MMEM_NUMA_NONE || p_provider->Numa > MMEM_NUMA_INTERLEAVE ) {
+		return;
+	}
+
+	uint64_t nodes = p_provider->Nodes ? p_provider->Nodes : ~(uint64_t)0;
+	unsigned long mask[sizeof( uint64_t ) / sizeof( unsigned long )];
+	for ( size_t index = 0; index < sizeof( mask ) / sizeof( mask[0] ); ++index ) {
+		mask[index] = (unsigned long)(nodes >> (index * sizeof( unsigned long ) * 8));
+	}
+
+	// The local policy takes no nodes. Failures leave the default placement of the kernel
+	bool local = p_provider->Numa == MMEM_NUMA_LOCAL;
+	syscall( SYS_mbind, p_memory, p_bytes, policies[p_provider->Numa], local ? NULL : mask, local ? 0 : 65, 0 );
+#else
+	(void)(p_provider); (void)(p_memory); (void)(p_bytes);
+#endif
+}
+
+static void * ProviderMapAllocate( MemoryProvider const * p_provider, size_t const p_size ) {
+	size_t bytes = ProviderBytes( p_provider, p_size );
+	void * memory = NULL;
+	if ( !bytes ) {
+		return NULL;
+	}
+
+#if defined( __linux__ )
+	int const protection = PROT_READ | PROT_WRITE;
+	int const flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined( MAP_HUGETLB )
+	if ( p_provider->PageSize ) {
+		int shift = (int)MMEM_CTZ64( (uint64_t)p_provider->PageSize );
+		memory = mmap( NULL, bytes, protection, flags | MAP_HUGETLB | (shift << MAP_HUGE_SHIFT), -1, 0 );
+		memory = memory == MAP_FAILED ? NULL : memory;
+	}
+#endif
+	if ( !memory && ( p_provider->PageSize || p_provider->Transparent ) ) {
+		// Without reserved huge pages, map a huge page more to align the memory for transparent huge pages
+		char * mapped = mmap( NULL, bytes + MMEM_PAGE_2M, protection, flags, -1, 0 );
+		if ( mapped != MAP_FAILED ) {
+			char * aligned = (char *)AlignAddress( (uintptr_t)mapped, MMEM_PAGE_2M );
+			if ( aligned > mapped ) {
+				munmap( mapped, (size_t)(aligned - mapped) );
+			}
+			if ( mapped + MMEM_PAGE_2M > aligned ) {
+				munmap( aligned + bytes, (size_t)(mapped + MMEM_PAGE_2M - aligned) );
+			}
+#if defined( MADV_HUGEPAGE )
+			madvise( aligned, bytes, MADV_HUGEPAGE );
+#endif
+			memory = aligned;
+		}
+	}
+	if ( !memory ) {
+		memory = mmap( NULL, bytes, protection, flags, -1, 0 );
+		memory = memory == MAP_FAILED ? NULL : memory;
+	}
+	if ( memory ) {
+		ProviderPlace( p_provider, memory, bytes );
+	}
+#elif MMEM_VIRTUAL_MEMORY
+	memory = VirtualReserve( bytes );
+	if ( memory && !VirtualCommit( memory, bytes ) ) {
+		VirtualRelease( memory, bytes );
+		memory = NULL;
+	}
+#else
+	memory = AllocateAligned( bytes, PageSize(), MMEM_ZERO_POLICY == MMEM_ZERO_POLICY_ONRELEASE );
+#endif
+	return memory;
+}
+
+static void ProviderMapRelease( MemoryProvider const * p_provider, void * p_memory, size_t const p_size ) {
+#if MMEM_VIRTUAL_MEMORY
+	VirtualRelease( p_memory, ProviderBytes( p_provider, p_size ) );
 #else
-	return calloc( Align( capacity ), size );
+	(void)(p_provider); (void)(p_size);
+	ReleaseAligned( p_memory );
 #endif
 }
 
+MemoryProvider ProviderPages( void ) {
+	return (MemoryProvider) {
+		.Allocate = ProviderMapAllocate,
+		.Release = ProviderMapRelease,
+		.Context = NULL,
+		.PageSize = 0,
+		.Transparent = false,
+		.Numa = MMEM_NUMA_NONE,
+		.Nodes = 0
+	};
+}
+
+MemoryProvider ProviderHugePages( size_t const p_page_size ) {
+	MemoryProvider provider = ProviderPages();
+	provider.PageSize = NextPowerOfTwo( p_page_size ? p_page_size : MMEM_PAGE_2M );
+	provider.Transparent = true;
+	return provider;
+}
+
+MemoryProvider ProviderTransparentHugePages( void ) {
+	MemoryProvider provider = ProviderPages();
+	provider.Transparent = true;
+	return provider;
+}
+
+MemoryProvider ProviderNuma( MemoryProvider const p_provider, unsigned int const p_numa, uint64_t const p_nodes ) {
+	MemoryProvider provider = p_provider;
+	provider.Numa = p_numa;
+	provider.Nodes = p_nodes;
+	return provider;
+}
+
 MemoryPool PoolCreate( size_t const p_element_size, size_t const p_capacity ) {
-	return PoolCreateEx( p_element_size, p_capacity, Allocate, free );
+	return PoolCreateEx( p_element_size, p_capacity, NULL, NULL );
 }
 
-MemoryPool PoolCreateEx( size_t const p_element_size, size_t const p_capacity, AllocateFct const p_allocate_fct, ReleaseFct const p_release_fct ) {
-	return (MemoryPool) {
+/// @brief Default allocation of the library, zeroed through calloc where the alignment allows it
+static void * AllocateBlock( size_t const size, size_t const alignment, bool const zero ) {
+	if ( alignment <= MMEM_ALIGNMENT_ALLOCATOR ) {
+		return zero ? calloc( 1, size ) : malloc( size );
+	}
+	return AllocateAligned( size, alignment, zero );
+}
+
+static void PoolBind( MemoryPool * p_pool );
+
+static MemoryPool PoolInit( size_t const p_element_size, size_t const p_capacity, unsigned int const p_mode, bool const p_validate, size_t const p_alignment, AllocateFct const p_allocate_fct, ReleaseFct const p_release_fct, MemoryProvider const * p_provider, unsigned int const p_zero, unsigned int const p_policy ) {
+	size_t alignment = p_alignment ? p_alignment : 1;
+	size_t element_size = (size_t)AlignAddress( p_element_size, alignment );
+	MemoryProvider provider = p_provider ? *p_provider : (MemoryProvider) { 0 };
+	size_t bytes = 0;
+	void * base = NULL;
+	void * raw = NULL;
+
+	// The heap alignment policy only applies to memory allocated by the library itself
+	size_t block_alignment = alignment;
+	if ( ( p_policy & MMEM_ALIGNMENT_POLICY_HEAP ) && !p_allocate_fct && !provider.Allocate && block_alignment < MMEM_ALIGNMENT_CACHELINE ) {
+		block_alignment = MMEM_ALIGNMENT_CACHELINE;
+	}
+
+	// Slot counts whose bytes, including the slack to align them, exceed the address space get no memory
+	size_t slack = alignment > block_alignment ? alignment : block_alignment;
+	bool fits = element_size >= p_element_size && ( !element_size || p_capacity <= (SIZE_MAX - slack) / element_size );
+
+	if ( !fits ) {
+		base = NULL;
+	} else if ( provider.Allocate ) {
+		// Providers are not bound to any alignment, larger alignments need room to align the slots inside
+		bytes = p_capacity * element_size + ( alignment > MMEM_ALIGNMENT_ALLOCATOR ? alignment : 0 );
+		base = provider.Allocate( &provider, bytes );
+		raw = base ? (void *)AlignAddress( (uintptr_t)base, alignment ) : NULL;
+	} else if ( p_allocate_fct && block_alignment <= MMEM_ALIGNMENT_ALLOCATOR ) {
+		base = p_allocate_fct( p_capacity, element_size );
+		raw = base;
+	} else if ( p_allocate_fct ) {
+		// Foreign allocators know no alignment, ask for enough memory to align the slots inside
+		base = p_allocate_fct( p_capacity * element_size + block_alignment, 1 );
+		raw = base ? (void *)AlignAddress( (uintptr_t)base, block_alignment ) : NULL;
+	} else {
+		base = AllocateBlock( p_capacity * element_size, block_alignment, p_zero == MMEM_ZERO_POLICY_ONRELEASE );
+		raw = base;
+	}
+
+	ReleaseFct release = p_release_fct ? p_release_fct : ( !p_allocate_fct && block_alignment > MMEM_ALIGNMENT_ALLOCATOR ) ? ReleaseAligned : free;
+	MemoryBitmap * list = p_validate && base ? MemoryBitmapInit( malloc( MemoryBitmapBytes( p_capacity ) ), p_capacity ) : NULL;
+	size_t capacity = p_capacity;
+	if ( !base || ( p_validate && !list ) ) {
+		// A pool without its slots or its bitmap holds no memory and hands out none
+		if ( base && provider.Release ) {
+			provider.Release( &provider, base, bytes );
+		} else if ( base ) {
+			release( base );
+		}
+		base = NULL;
+		raw = NULL;
+		bytes = 0;
+		capacity = 0;
+	}
+
+	MemoryPool pool = {
 		.Used = 0,
 		.Cursor = 0,
-		.List = calloc( Align( bitslots( (bitslot_t)p_capacity ) ), sizeof( bitslot_t ) ),
-		.Raw = p_allocate_fct ? p_allocate_fct( p_capacity, p_element_size ) : Allocate( p_element_size, p_capacity ),
-		.ElementSize = p_element_size,
-		.Capacity = Align( p_capacity ),
-		.Release = p_release_fct ? p_release_fct : free
+		.List = list,
+		.Raw = raw,
+		.ElementSize = element_size,
+		.Capacity = capacity,
+		.Release = release,
+		.Mode = p_mode,
+		.Free = NULL,
+		.Base = base,
+		.Provider = provider,
+		.Bytes = bytes,
+		.ZeroPolicy = p_zero,
+		.AlignmentPolicy = p_policy,
+		.AllocateSlot = NULL,
+		.ReleaseSlot = NULL
 	};
+	PoolBind( &pool );
+	return pool;
+}
+
+MemoryPool PoolCreateEx( size_t const p_element_size, size_t const p_capacity, AllocateFct const p_allocate_fct, ReleaseFct const p_release_fct ) {
+	return PoolInit( p_element_size, p_capacity, MMEM_POOL_MODE_BITMAP, true, 0, p_allocate_fct, p_release_fct, NULL, MMEM_ZERO_POLICY, MMEM_ALIGNMENT_POLICY );
+}
+
+MemoryPool PoolCreateAligned( size_t const p_element_size, size_t const p_capacity, size_t const p_alignment ) {
+	return PoolCreateAlignedEx( p_element_size, p_capacity, p_alignment, NULL, NULL );
+}
+
+MemoryPool PoolCreateAlignedEx( size_t const p_element_size, size_t const p_capacity, size_t const p_alignment, AllocateFct const p_allocate_fct, ReleaseFct const p_release_fct ) {
+	return PoolInit( p_element_size, p_capacity, MMEM_POOL_MODE_BITMAP, true, p_alignment, p_allocate_fct, p_release_fct, NULL, MMEM_ZERO_POLICY, MMEM_ALIGNMENT_POLICY );
+}
+
+MemoryPool PoolCreateFreeList( size_t const p_element_size, size_t const p_capacity, bool const p_validate ) {
+	return PoolCreateFreeListEx( p_element_size, p_capacity, p_validate, NULL, NULL );
+}
+
+MemoryPool PoolCreateFreeListEx( size_t const p_element_size, size_t const p_capacity, bool const p_validate, AllocateFct const p_allocate_fct, ReleaseFct const p_release_fct ) {
+	// Released slots store the link to the next released slot in place
+	size_t element_size = p_element_size < sizeof( void * ) ? sizeof( void * ) : p_element_size;
+	return PoolInit( element_size, p_capacity, MMEM_POOL_MODE_FREELIST, p_validate, 0, p_allocate_fct, p_release_fct, NULL, MMEM_ZERO_POLICY, MMEM_ALIGNMENT_POLICY );
+}
+
+MemoryPool PoolCreateOpt( size_t const p_element_size, size_t const p_capacity, MemoryPoolOptions const * p_options ) {
+	if ( !p_options ) {
+		return PoolCreate( p_element_size, p_capacity );
+	}
+
+	size_t element_size = p_element_size;
+	bool validate = true;
+	if ( p_options->Mode == MMEM_POOL_MODE_FREELIST ) {
+		// Released slots store the link to the next released slot in place
+		element_size = element_size < sizeof( void * ) ? sizeof( void * ) : element_size;
+		validate = p_options->Validate;
+	}
+
+	MemoryProvider const * provider = p_options->Provider.Allocate ? &p_options->Provider : NULL;
+	unsigned int zero = ZeroPolicyOf( p_options->ZeroPolicy );
+	unsigned int policy = AlignmentPolicyOf( p_options->AlignmentPolicy );
+	return PoolInit( element_size, p_capacity, p_options->Mode, validate, p_options->Alignment, NULL, NULL, provider, zero, policy );
 }
 
 void PoolDestroy( MemoryPool * p_pool ) {
-	p_pool->Release( p_pool->Raw );
+	bool zero = p_pool->ZeroPolicy == MMEM_ZERO_POLICY_ONRELEASE;
+	STATS( StatsUnregister( &p_pool->Stats ) );
+	PROFILE( ProfilePoolStop( p_pool ) );
+	if ( p_pool->Provider.Release ) {
+		if ( p_pool->Base ) {
+			p_pool->Provider.Release( &p_pool->Provider, p_pool->Base, p_pool->Bytes );
+		}
+	} else {
+		p_pool->Release( p_pool->Base );
+	}
 	free( p_pool->List );
 
-#if MMEM_ZERO_POLICY == MMEM_ZERO_POLICY_ONRELEASE
-	memset( p_pool, 0x00, sizeof( MemoryPool ) );
-#endif
+	if ( zero ) {
+		memset( p_pool, 0x00, sizeof( MemoryPool ) );
+	}
 }
 
-void * PoolAllocate( MemoryPool * p_pool ) {
-	size_t cap = p_pool->Capacity;
-	bitslot_t * set = p_pool->List;
+static inline void * PoolAllocateFreeListAs( MemoryPool * p_pool, unsigned int const p_zero ) {
+	void * ptr = p_pool->Free;
+	size_t index = 0;
 
-	for ( size_t i = 0; i < cap; ++i ) {
-		unsigned int index = (unsigned int)((p_pool->Cursor + i) % cap);
-		if ( !bittest( set, index ) ) {
-			bitset( set, index );
-			p_pool->Used++;
-			p_pool->Cursor = (index + 1) % cap;
-			void * ptr = (char *)p_pool->Raw + index * p_pool->ElementSize;
-			ZeroOnAllocate( ptr, p_pool->ElementSize );
-			return ptr;
+	if ( ptr ) {
+		// Unlink the most recently released slot. The link is not necessarily pointer aligned
+		memcpy( &p_pool->Free, ptr, sizeof( void * ) );
+		if ( p_zero == MMEM_ZERO_POLICY_ONRELEASE ) {
+			memset( ptr, 0x00, sizeof( void * ) );
+			STATS( StatsZeroed( &p_pool->Stats.Counters, true, sizeof( void * ) ) );
 		}
+		if ( p_pool->List ) {
+			index = (size_t)((char *)ptr - (char *)p_pool->Raw) / p_pool->ElementSize;
+		}
+	} else if ( p_pool->Cursor < p_pool->Capacity ) {
+		// Hand out untouched slots in address order before any link was ever written
+		index = p_pool->Cursor++;
+		ptr = (char *)p_pool->Raw + index * p_pool->ElementSize;
+	} else {
+		STATS( StatsAllocation( &p_pool->Stats.Counters, false, p_pool->Used ) );
+		return NULL;
 	}
 
-	return NULL;
+	if ( p_pool->List ) {
+		MemoryBitmapSet( p_pool->List, index );
+	}
+	p_pool->Used++;
+	ZeroOnAllocateAs( p_zero, ptr, p_pool->ElementSize );
+	STATS( StatsAllocation( &p_pool->Stats.Counters, true, p_pool->Used ) );
+	STATS( StatsScan( &p_pool->Stats.Counters, 0 ) );
+	STATS( StatsZeroed( &p_pool->Stats.Counters, p_zero == MMEM_ZERO_POLICY_ONALLOCATE, p_pool->ElementSize ) );
+	return ptr;
 }
 
-void PoolRelease( MemoryPool * p_pool, void * p_element ) {
-	// Check for alignment. Misaligned pointers cannot be valid objects of this pool
-	bitslot_t offset = (bitslot_t)((char *)p_element - (char *)p_pool->Raw);
-	if ( offset % p_pool->ElementSize != 0 ) {
+static inline void PoolReleaseFreeListAs( MemoryPool * p_pool, void * p_element, unsigned int const p_zero ) {
+	size_t offset = (size_t)((uintptr_t)p_element - (uintptr_t)p_pool->Raw);
+
+	// Check for bounds. Out of bounds pointers cannot be valid objects of this pool
+	if ( offset >= p_pool->Cursor * p_pool->ElementSize ) {
 		return;
 	}
 
+	// Without the validation list, alignment and double releases are the callers responsibility
+	if ( p_pool->List ) {
+		size_t index = offset / p_pool->ElementSize;
+		if ( offset - index * p_pool->ElementSize != 0 || !MemoryBitmapTest( p_pool->List, index ) ) {
+			return;
+		}
+		MemoryBitmapClear( p_pool->List, index );
+	}
+
+	ZeroOnReleaseAs( p_zero, p_element, p_pool->ElementSize );
+	memcpy( p_element, &p_pool->Free, sizeof( void * ) );
+	p_pool->Free = p_element;
+	p_pool->Used--;
+	STATS( p_pool->Stats.Counters.Releases++ );
+	STATS( StatsZeroed( &p_pool->Stats.Counters, p_zero == MMEM_ZERO_POLICY_ONRELEASE, p_pool->ElementSize ) );
+}
+
+static inline void * PoolAllocateBitmapAs( MemoryPool * p_pool, unsigned int const p_zero ) {
+	size_t index = MemoryBitmapFind( p_pool->List );
+	if ( index == SIZE_MAX ) {
+		STATS( StatsAllocation( &p_pool->Stats.Counters, false, p_pool->Used ) );
+		return NULL;
+	}
+
+	MemoryBitmapSet( p_pool->List, index );
+	p_pool->Used++;
+	if ( index >= p_pool->Cursor ) {
+		p_pool->Cursor = index + 1;
+	}
+
+	void * ptr = (char *)p_pool->Raw + index * p_pool->ElementSize;
+	ZeroOnAllocateAs( p_zero, ptr, p_pool->ElementSize );
+	// The search reads one word per bitmap level
+	STATS( StatsAllocation( &p_pool->Stats.Counters, true, p_pool->Used ) );
+	STATS( StatsScan( &p_pool->Stats.Counters, ((MemoryBitmap *)p_pool->List)->Levels ) );
+	STATS( StatsZeroed( &p_pool->Stats.Counters, p_zero == MMEM_ZERO_POLICY_ONALLOCATE, p_pool->ElementSize ) );
+	return ptr;
+}
+
+static inline void PoolReleaseBitmapAs( MemoryPool * p_pool, void * p_element, unsigned int const p_zero ) {
 	// Check for bounds. Out of bounds pointers cannot be valid objects of this pool
-	bitslot_t index = (bitslot_t)(offset / p_pool->ElementSize);
-	if ( index >= p_pool->Capacity ) {
+	size_t offset = (size_t)((uintptr_t)p_element - (uintptr_t)p_pool->Raw);
+	size_t index = offset / p_pool->ElementSize;
+	if ( index >= p_pool->Cursor ) {
+		return;
+	}
+
+	// Check for alignment. Misaligned pointers cannot be valid objects of this pool
+	if ( offset - index * p_pool->ElementSize != 0 ) {
 		return;
 	}
 
 	// Check if the object is actually a managed object and not a unallocated/released slot.
-	if ( bittest( p_pool->List, index ) ) {
-		bitclear( p_pool->List, index );
-		ZeroOnRelease( p_element, p_pool->ElementSize );
+	if ( MemoryBitmapTest( p_pool->List, index ) ) {
+		MemoryBitmapClear( p_pool->List, index );
+		ZeroOnReleaseAs( p_zero, p_element, p_pool->ElementSize );
 		p_pool->Used--;
-		if ( index < p_pool->Cursor ) {
-			p_pool->Cursor = index;
-		}
+		STATS( p_pool->Stats.Counters.Releases++ );
+		STATS( StatsZeroed( &p_pool->Stats.Counters, p_zero == MMEM_ZERO_POLICY_ONRELEASE, p_pool->ElementSize ) );
 	}
 }
 
-void PoolReset( MemoryPool * p_pool ) {
-	p_pool->Used = 0;
-	p_pool->Cursor = 0;
+// One allocate and release routine per mode and zero policy, bound to a pool when it is created
+#define MMEM_POOL_ROUTINES( mode, policy, zero ) \
+	static void * PoolAllocate##mode##policy( MemoryPool * p_pool ) { \
+		return PoolAllocate##mode##As( p_pool, zero ); \
+	} \
+	static void PoolRelease##mode##policy( MemoryPool * p_pool, void * p_element ) { \
+		PoolRelease##mode##As( p_pool, p_element, zero ); \
+	}
 
-#if MMEM_ZERO_POLICY == MMEM_ZERO_POLICY_ONRELEASE
-	memset( p_pool->Raw, 0x00, p_pool->Capacity );
-#endif
+MMEM_POOL_ROUTINES( Bitmap, OnAllocate, MMEM_ZERO_POLICY_ONALLOCATE )
+MMEM_POOL_ROUTINES( Bitmap, OnRelease, MMEM_ZERO_POLICY_ONRELEASE )
+MMEM_POOL_ROUTINES( Bitmap, Manual, MMEM_ZERO_POLICY_MANUAL )
+MMEM_POOL_ROUTINES( FreeList, OnAllocate, MMEM_ZERO_POLICY_ONALLOCATE )
+MMEM_POOL_ROUTINES( FreeList, OnRelease, MMEM_ZERO_POLICY_ONRELEASE )
+MMEM_POOL_ROUTINES( FreeList, Manual, MMEM_ZERO_POLICY_MANUAL )
 
-	memset( p_pool->List, 0x00, bitslots( (bitslot_t)p_pool->Capacity ) );
+#undef MMEM_POOL_ROUTINES
+
+/// @brief Routines of a pool which failed to create, it has no slots to hand out
+static void * PoolAllocateNone( MemoryPool * p_pool ) {
+	STATS( StatsAllocation( &p_pool->Stats.Counters, false, p_pool->Used ) );
+	(void)p_pool;
+	return NULL;
 }
 
-MemoryArena ArenaCreate( const size_t p_capacity ) {
-	return ArenaCreateEx( p_capacity, Allocate, free );
+static void PoolReleaseNone( MemoryPool * p_pool, void * p_element ) {
+	(void)p_pool;
+	(void)p_element;
 }
 
-MemoryArena ArenaCreateEx( const size_t p_capacity, AllocateFct const p_allocate_fct, ReleaseFct const p_release_fct ) {
-	return (MemoryArena) {
-		.Used = 0,
-		.Raw = p_allocate_fct ? p_allocate_fct( p_capacity, 1 ) : Allocate( p_capacity, 1 ),
-		.Capacity = Align( p_capacity ),
-		.Release = p_release_fct ? p_release_fct : free
+static void PoolBind( MemoryPool * p_pool ) {
+	// Indexed by mode and zero policy
+	static void * (* const allocate[2][3])( MemoryPool * ) = {
+		{ PoolAllocateBitmapOnAllocate, PoolAllocateBitmapOnRelease, PoolAllocateBitmapManual },
+		{ PoolAllocateFreeListOnAllocate, PoolAllocateFreeListOnRelease, PoolAllocateFreeListManual }
 	};
+	static void (* const release[2][3])( MemoryPool *, void * ) = {
+		{ PoolReleaseBitmapOnAllocate, PoolReleaseBitmapOnRelease, PoolReleaseBitmapManual },
+		{ PoolReleaseFreeListOnAllocate, PoolReleaseFreeListOnRelease, PoolReleaseFreeListManual }
+	};
+
+	unsigned int mode = p_pool->Mode == MMEM_POOL_MODE_FREELIST ? 1 : 0;
+	unsigned int zero = p_pool->ZeroPolicy <= MMEM_ZERO_POLICY_MANUAL ? p_pool->ZeroPolicy : MMEM_ZERO_POLICY;
+	p_pool->ZeroPolicy = zero;
+	p_pool->AllocateSlot = p_pool->Raw ? allocate[mode][zero] : PoolAllocateNone;
+	p_pool->ReleaseSlot = p_pool->Raw ? release[mode][zero] : PoolReleaseNone;
 }
 
-void ArenaDestroy( MemoryArena * p_arena ) {
-	p_arena->Release( p_arena->Raw );
+void * PoolAllocate( MemoryPool * p_pool ) {
+	return p_pool->AllocateSlot( p_pool );
+}
 
-#if MMEM_ZERO_POLICY == MMEM_ZERO_POLICY_ONRELEASE
-	memset( p_arena, 0x00, sizeof( MemoryArena ) );
-#endif
+void PoolRelease( MemoryPool * p_pool, void * p_element ) {
+	p_pool->ReleaseSlot( p_pool, p_element );
 }
 
-void * ArenaAllocate( MemoryArena * p_arena, size_t p_size ) {
-	if ( p_arena->Used + p_size > p_arena->Capacity ) {
-		return NULL;
+/// @brief Zeroes every run of slots marked in use below p_cursor, released slots were already zeroed on release
+static void ZeroUsedRuns( MemoryBitmapWord const * p_bits, size_t const p_cursor, void * p_raw, size_t const p_element_size ) {
+	size_t index = 0;
+
+	while ( index < p_cursor ) {
+		MemoryBitmapWord used = p_bits[MemoryBitmapWordOf( index )] >> ( index & (MMEM_BITMAP_WORD_BITS - 1) );
+		if ( !used ) {
+			index = (MemoryBitmapWordOf( index ) + 1) << MMEM_BITMAP_WORD_SHIFT;
+			continue;
+		}
+		index += (size_t)MMEM_CTZ64( used );
+
+		size_t end = index;
+		while ( end < p_cursor ) {
+			MemoryBitmapWord released = ~p_bits[MemoryBitmapWordOf( end )] >> ( end & (MMEM_BITMAP_WORD_BITS - 1) );
+			if ( released ) {
+				end += (size_t)MMEM_CTZ64( released );
+				break;
+			}
+			end = (MemoryBitmapWordOf( end ) + 1) << MMEM_BITMAP_WORD_SHIFT;
+		}
+		if ( end > p_cursor ) {
+			end = p_cursor;
+		}
+		if ( index < end ) {
+			ZeroRange( (char *)p_raw + index * p_element_size, (end - index) * p_element_size );
+		}
+		index = end;
 	}
+}
 
-	void * ptr = (char *)p_arena->Raw + p_arena->Used;
-	ZeroOnAllocate( ptr, p_size );
+void PoolReset( MemoryPool * p_pool ) {
+	if ( p_pool->ZeroPolicy == MMEM_ZERO_POLICY_ONRELEASE ) {
+		if ( p_pool->Mode == MMEM_POOL_MODE_FREELIST ) {
+			// Released slots hold list links, only slots below the cursor were ever touched
+			ZeroRange( p_pool->Raw, p_pool->Cursor * p_pool->ElementSize );
+			STATS( StatsZeroed( &p_pool->Stats.Counters, true, p_pool->Cursor * p_pool->ElementSize ) );
+		} else if ( p_pool->List ) {
+			ZeroUsedRuns( ((MemoryBitmap *)p_pool->List)->Level[0], p_pool->Cursor, p_pool->Raw, p_pool->ElementSize );
+			STATS( StatsZeroed( &p_pool->Stats.Counters, true, p_pool->Used * p_pool->ElementSize ) );
+		}
+	}
+	STATS( p_pool->Stats.Counters.Resets++ );
+	PROFILE( ProfileForget( p_pool->Profile, 0 ) );
 
-	p_arena->Used += p_size;
-	return ptr;
+	p_pool->Used = 0;
+	p_pool->Cursor = 0;
+	p_pool->Free = NULL;
+
+	if ( p_pool->List ) {
+		MemoryBitmapClearAll( p_pool->List );
+	}
 }
 
-void ArenaReset( MemoryArena * p_arena ) {
-	p_arena->Used = 0;
+size_t PoolAllocateBatch( MemoryPool * p_pool, void ** p_elements, size_t const p_count ) {
+	size_t count = 0;
+	if ( p_pool->Mode != MMEM_POOL_MODE_BITMAP || !p_pool->List || MMEM_PROFILED( p_pool ) ) {
+		while ( count < p_count ) {
+			void * ptr = p_pool->AllocateSlot( p_pool );
+			if ( !ptr ) {
+				break;
+			}
+			p_elements[count++] = ptr;
+		}
+		return count;
+	}
 
-#if MMEM_ZERO_POLICY == MMEM_ZERO_POLICY_ONRELEASE
-	memset( p_arena->Raw, 0x00, p_arena->Capacity );
-#endif
+	MemoryBitmap * map = p_pool->List;
+	char * raw = p_pool->Raw;
+	size_t size = p_pool->ElementSize;
+	size_t cursor = p_pool->Cursor;
+	size_t run = 0;
+	size_t run_end = 0;
+	STATS( size_t words = 0 );
+
+	// Claim every unused slot of the lowest word with one, then move on to the next lowest word
+	while ( count < p_count ) {
+		size_t index = MemoryBitmapFind( map );
+		if ( index == SIZE_MAX ) {
+			break;
+		}
+
+		size_t word = MemoryBitmapWordOf( index );
+		MemoryBitmapWord unused = ~map->Level[0][word];
+		MemoryBitmapWord claimed = 0;
+		while ( unused && count < p_count ) {
+			size_t slot = (word << MMEM_BITMAP_WORD_SHIFT) | MMEM_CTZ64( unused );
+			claimed |= unused & (0 - unused);
+			unused &= unused - 1;
+			p_elements[count++] = raw + slot * size;
+
+			// Zero every run of adjacent slots with one call
+			if ( slot != run_end ) {
+				ZeroOnAllocateAs( p_pool->ZeroPolicy, raw + run * size, (run_end - run) * size );
+				run = slot;
+			}
+			run_end = slot + 1;
+		}
+		MemoryBitmapSetWord( map, word, claimed );
+		if ( run_end > cursor ) {
+			cursor = run_end;
+		}
+		STATS( words += map->Levels );
+	}
+	ZeroOnAllocateAs( p_pool->ZeroPolicy, raw + run * size, (run_end - run) * size );
+
+	p_pool->Used += count;
+	p_pool->Cursor = cursor;
+	STATS( StatsAllocationBatch( &p_pool->Stats.Counters, count, p_count, p_pool->Used ) );
+	STATS( StatsScan( &p_pool->Stats.Counters, words ) );
+	STATS( StatsZeroed( &p_pool->Stats.Counters, p_pool->ZeroPolicy == MMEM_ZERO_POLICY_ONALLOCATE, count * size ) );
+	return count;
 }
+
+size_t PoolReleaseBatch( MemoryPool * p_pool, void ** p_elements, size_t const p_count ) {
+	if ( p_pool->Mode != MMEM_POOL_MODE_BITMAP || !p_pool->List || MMEM_PROFILED( p_pool ) ) {
+		size_t used = p_pool->Used;
+		for ( size_t i = 0; i < p_count; ++i ) {
+			if ( p_elements[i] ) {
+				p_pool->ReleaseSlot( p_pool, p_elements[i] );
+			}
+		}
+		return used - p_pool->Used;
+	}
+
+	MemoryBitmap * map = p_pool->List;
+	char * raw = p_pool->Raw;
+	size_t size = p_pool->ElementSize;
+	size_t released = 0;
+	size_t word = SIZE_MAX;
+	MemoryBitmapWord cleared = 0;
+	size_t run = 0;
+	size_t run_end = 0;
+
+	for ( size_t i = 0; i < p_count; ++i ) {
+		// Out of bounds, misaligned and unallocated pointers cannot be valid objects of this pool
+		size_t offset = (size_t)((uintptr_t)p_elements[i] - (uintptr_t)raw);
+		size_t index = offset / size;
+		if ( !p_elements[i] || index >= p_pool->Cursor || offset - index * size != 0 ) {
+			continue;
+		}
+
+		// Bits of the same word are cleared at once, a release already pending counts as released
+		if ( MemoryBitmapWordOf( index ) != word ) {
+			if ( cleared ) {
+				MemoryBitmapClearWord( map, word, cleared );
+			}
+			word = MemoryBitmapWordOf( index );
+			cleared = 0;
+		}
+		MemoryBitmapWord bit = MemoryBitmapMask( index );
+		if ( !( map->Level[0][word] & bit ) || ( cleared & bit ) ) {
+			continue;
+		}
+		cleared |= bit;
+		released++;
+
+		if ( index != run_end ) {
+			ZeroOnReleaseAs( p_pool->ZeroPolicy, raw + run * size, (run_end - run) * size );
+			run = index;
+		}
+		run_end = index + 1;
+	}
+	if ( cleared ) {
+		MemoryBitmapClearWord( map, word, cleared );
+	}
+	ZeroOnReleaseAs( p_pool->ZeroPolicy, raw + run * size, (run_end - run) * size );
+
+	p_pool->Used -= released;
+	STATS( p_pool->Stats.Counters.Releases += released );
+	STATS( StatsZeroed( &p_pool->Stats.Counters, p_pool->ZeroPolicy == MMEM_ZERO_POLICY_ONRELEASE, released * size ) );
+	return released;
+}
+
+MemoryPoolIterator PoolIterate( MemoryPool * p_pool ) {
+	return PoolIterateChunk( p_pool, 0, 1 );
+}
+
+MemoryPoolIterator PoolIterateChunk( MemoryPool * p_pool, size_t const p_chunk, size_t const p_chunks ) {
+	MemoryPoolIterator iterator = {
+		.Bits = NULL,
+		.Raw = p_pool->Raw,
+		.ElementSize = p_pool->ElementSize,
+		.Word = 0,
+		.Words = 0,
+		.Tail = MMEM_BITMAP_WORD_FULL,
+		.Live = 0
+	};
+	if ( !p_pool->List || !p_chunks || p_chunk >= p_chunks ) {
+		return iterator;
+	}
+
+	// Only slots below the high-water mark were ever handed out, padding bits above it are set
+	size_t words = MemoryBitmapWords( p_pool->Cursor );
+	size_t first = words * p_chunk / p_chunks;
+	size_t last = words * (p_chunk + 1) / p_chunks;
+	if ( first == last ) {
+		return iterator;
+	}
+
+	iterator.Bits = ((MemoryBitmap *)p_pool->List)->Level[0];
+	iterator.Word = first;
+	iterator.Words = last;
+	if ( last == words && (p_pool->Cursor & (MMEM_BITMAP_WORD_BITS - 1)) ) {
+		iterator.Tail = MemoryBitmapMask( p_pool->Cursor ) - 1;
+	}
+	iterator.Live = iterator.Bits[first];
+	if ( first + 1 == last ) {
+		iterator.Live &= iterator.Tail;
+	}
+	return iterator;
+}
+
+void PoolForEach( MemoryPool * p_pool, VisitFct const p_visit, void * p_context ) {
+	PoolForEachChunk( p_pool, 0, 1, p_visit, p_context );
+}
+
+void PoolForEachChunk( MemoryPool * p_pool, size_t const p_chunk, size_t const p_chunks, VisitFct const p_visit, void * p_context ) {
+	MemoryPoolIterator iterator = PoolIterateChunk( p_pool, p_chunk, p_chunks );
+	for ( void * element = PoolIteratorNext( &iterator ); element; element = PoolIteratorNext( &iterator ) ) {
+		p_visit( element, p_context );
+	}
+}
+
+size_t PoolCompact( MemoryPool * p_pool, size_t const p_budget, RelocateFct const p_relocate, void * p_context ) {
+	if ( p_pool->Mode != MMEM_POOL_MODE_BITMAP || !p_pool->List ) {
+		return 0;
+	}
+
+	// Move the highest used slot into the lowest unused slot until the used slots form a prefix
+	MemoryBitmap * map = p_pool->List;
+	size_t moved = 0;
+	size_t top = MemoryBitmapLast( map, p_pool->Cursor );
+	while ( top != SIZE_MAX && moved < p_budget ) {
+		size_t hole = MemoryBitmapFind( map );
+		if ( hole > top ) {
+			break;
+		}
+
+		void * from = (char *)p_pool->Raw + top * p_pool->ElementSize;
+		void * to = (char *)p_pool->Raw + hole * p_pool->ElementSize;
+		memcpy( to, from, p_pool->ElementSize );
+		MemoryBitmapSet( map, hole );
+		MemoryBitmapClear( map, top );
+		if ( p_relocate ) {
+			p_relocate( from, to, p_context );
+		}
+		PROFILE( ProfileMove( p_pool->Profile, from, to ) );
+		ZeroOnReleaseAs( p_pool->ZeroPolicy, from, p_pool->ElementSize );
+		moved++;
+		top = MemoryBitmapLast( map, top );
+	}
+
+	// Slots above the last used one are untouched again, which makes their pages eligible for PoolTrim
+	p_pool->Cursor = top == SIZE_MAX ? 0 : top + 1;
+	return moved;
+}
+
+size_t PoolTrim( MemoryPool * p_pool ) {
+	size_t page = PageSize();
+	uintptr_t start = AlignAddress( (uintptr_t)p_pool->Raw + p_pool->Cursor * p_pool->ElementSize, page );
+	uintptr_t end = ((uintptr_t)p_pool->Raw + p_pool->Capacity * p_pool->ElementSize) & ~(uintptr_t)(page - 1);
+	if ( start >= end || !VirtualDiscard( (void *)start, (size_t)(end - start) ) ) {
+		return 0;
+	}
+	return (size_t)(end - start);
+}
+
+MemoryHandlePool PoolHandleCreate( size_t const p_element_size, size_t const p_capacity ) {
+	size_t capacity = p_capacity <= (size_t)MMEM_HANDLE_INDEX_MASK + 1 ? p_capacity : (size_t)MMEM_HANDLE_INDEX_MASK + 1;
+	MemoryHandlePool pool = {
+		.Pool = PoolCreate( p_element_size, capacity ),
+		.Entries = malloc( capacity * sizeof( MemoryHandleEntry ) ),
+		.Owners = malloc( capacity * sizeof( uint32_t ) ),
+		.Unused = 0,
+		.Capacity = (uint32_t)capacity
+	};
+	if ( !pool.Pool.Raw || !pool.Entries || !pool.Owners ) {
+		PoolHandleDestroy( &pool );
+		return pool;
+	}
+
+	// Generation 0 is never valid, so the null handle never resolves
+	for ( uint32_t index = 0; index < pool.Capacity; ++index ) {
+		pool.Entries[index].Slot = index + 1;
+		pool.Entries[index].Generation = 1;
+	}
+	return pool;
+}
+
+void PoolHandleDestroy( MemoryHandlePool * p_pool ) {
+	// The slot pool is cleared once destroyed, so destroying a failed or destroyed pool again releases nothing twice
+	if ( p_pool->Pool.Release || p_pool->Pool.Provider.Release ) {
+		PoolDestroy( &p_pool->Pool );
+	}
+	memset( &p_pool->Pool, 0x00, sizeof( MemoryPool ) );
+	free( p_pool->Entries );
+	free( p_pool->Owners );
+	p_pool->Entries = NULL;
+	p_pool->Owners = NULL;
+	p_pool->Unused = 0;
+	p_pool->Capacity = 0;
+}
+
+MemoryHandle PoolHandleAllocate( MemoryHandlePool * p_pool ) {
+	if ( p_pool->Unused >= p_pool->Capacity ) {
+		return MMEM_HANDLE_NULL;
+	}
+	void * ptr = PoolAllocate( &p_pool->Pool );
+	if ( !ptr ) {
+		return MMEM_HANDLE_NULL;
+	}
+
+	uint32_t index = p_pool->Unused;
+	uint32_t slot = (uint32_t)((size_t)((char *)ptr - (char *)p_pool->Pool.Raw) / p_pool->Pool.ElementSize);
+	MemoryHandleEntry * entry = &p_pool->Entries[index];
+	p_pool->Unused = entry->Slot;
+	entry->Slot = slot;
+	p_pool->Owners[slot] = index;
+	return (entry->Generation << MMEM_HANDLE_INDEX_BITS) | index;
+}
+
+bool PoolHandleRelease( MemoryHandlePool * p_pool, MemoryHandle const p_handle ) {
+	void * ptr = PoolHandleGet( p_pool, p_handle );
+	if ( !ptr ) {
+		return false;
+	}
+	PoolRelease( &p_pool->Pool, ptr );
+
+	// Every copy of the handle turns stale, a wrapping generation skips the never valid generation 0
+	uint32_t index = p_handle & MMEM_HANDLE_INDEX_MASK;
+	MemoryHandleEntry * entry = &p_pool->Entries[index];
+	entry->Generation = (entry->Generation + 1) & MMEM_HANDLE_GENERATION_MASK;
+	if ( !entry->Generation ) {
+		entry->Generation = 1;
+	}
+	entry->Slot = p_pool->Unused;
+	p_pool->Unused = index;
+	return true;
+}
+
+/// @brief Points the handle of a moved object to its new slot
+static void HandleRelocate( void * p_from, void * p_to, void * p_context ) {
+	MemoryHandlePool * pool = p_context;
+	size_t from = (size_t)((char *)p_from - (char *)pool->Pool.Raw) / pool->Pool.ElementSize;
+	size_t to = (size_t)((char *)p_to - (char *)pool->Pool.Raw) / pool->Pool.ElementSize;
+	uint32_t index = pool->Owners[from];
+	pool->Entries[index].Slot = (uint32_t)to;
+	pool->Owners[to] = index;
+}
+
+size_t PoolHandleCompact( MemoryHandlePool * p_pool, size_t const p_budget ) {
+	return PoolCompact( &p_pool->Pool, p_budget, HandleRelocate, p_pool );
+}
+
+/// @brief Offset of the first slot in a slab, behind the header and the slot bitmap
+static inline size_t SlabDataOffset( size_t const capacity ) {
+	return (size_t)AlignAddress( sizeof( MemorySlab ) + MemoryBitmapBytes( capacity ), MMEM_ALIGNMENT_CACHELINE );
+}
+
+static inline size_t SlabCapacity( size_t const slab_size, size_t const element_size ) {
+	size_t capacity = slab_size / element_size;
+	while ( capacity && SlabDataOffset( capacity ) + capacity * element_size > slab_size ) {
+		size_t excess = (SlabDataOffset( capacity ) + capacity * element_size - slab_size + element_size - 1) / element_size;
+		capacity = excess < capacity ? capacity - excess : 0;
+	}
+	return capacity;
+}
+
+static inline void SlabLink( MemorySlab ** list, MemorySlab * slab ) {
+	slab->Prev = NULL;
+	slab->Next = *list;
+	if ( *list ) {
+		(*list)->Prev = slab;
+	}
+	*list = slab;
+}
+
+static inline void SlabUnlink( MemorySlab ** list, MemorySlab * slab ) {
+	if ( slab->Prev ) {
+		slab->Prev->Next = slab->Next;
+	} else {
+		*list = slab->Next;
+	}
+	if ( slab->Next ) {
+		slab->Next->Prev = slab->Prev;
+	}
+	slab->Prev = NULL;
+	slab->Next = NULL;
+}
+
+static MemorySlab * SlabCreate( MemorySlabPool * p_pool ) {
+	if ( p_pool->MaxSlabs && p_pool->Slabs >= p_pool->MaxSlabs ) {
+		return NULL;
+	}
+
+	void * base = NULL;
+	MemorySlab * slab = NULL;
+	if ( p_pool->Allocate ) {
+		// Foreign allocators know no alignment, ask for enough memory to align the slab inside
+		base = p_pool->Allocate( p_pool->SlabSize * 2, 1 );
+		slab = base ? (MemorySlab *)AlignAddress( (uintptr_t)base, p_pool->SlabSize ) : NULL;
+	} else {
+		base = AllocateAligned( p_pool->SlabSize, p_pool->SlabSize, MMEM_ZERO_POLICY == MMEM_ZERO_POLICY_ONRELEASE );
+		slab = base;
+	}
+	if ( !slab ) {
+		return NULL;
+	}
+
+	size_t capacity = p_pool->SlabCapacity;
+	slab->Pool = (MemoryPool) {
+		.Used = 0,
+		.Cursor = 0,
+		.List = MemoryBitmapInit( slab + 1, capacity ),
+		.Raw = (char *)slab + SlabDataOffset( capacity ),
+		.ElementSize = p_pool->ElementSize,
+		.Capacity = capacity,
+		.Release = NULL,
+		.Mode = MMEM_POOL_MODE_BITMAP,
+		.Free = NULL,
+		.Base = NULL,
+		.Provider = { 0 },
+		.Bytes = 0,
+		.ZeroPolicy = MMEM_ZERO_POLICY,
+		.AlignmentPolicy = MMEM_ALIGNMENT_POLICY,
+		.AllocateSlot = NULL,
+		.ReleaseSlot = NULL
+	};
+	PoolBind( &slab->Pool );
+	slab->Owner = p_pool->Id;
+	slab->Base = base;
+	SlabLink( &p_pool->Partial, slab );
+
+	p_pool->Slabs++;
+	p_pool->EmptySlabs++;
+	p_pool->Capacity += capacity;
+	return slab;
+}
+
+static void SlabDestroy( MemorySlabPool * p_pool, MemorySlab ** p_list, MemorySlab * p_slab ) {
+	SlabUnlink( p_list, p_slab );
+	p_pool->Slabs--;
+	p_pool->Capacity -= p_slab->Pool.Capacity;
+	p_pool->Release( p_slab->Base );
+}
+
+MemorySlabPool SlabPoolCreate( size_t const p_element_size, size_t const p_slab_size ) {
+	return SlabPoolCreateEx( p_element_size, p_slab_size, 0, 1, NULL, NULL );
+}
+
+/// @brief Last identity handed to a growable pool, 0 is never handed out
+static uint64_t SlabPoolIds = 0;
+
+MemorySlabPool SlabPoolCreateEx( size_t const p_element_size, size_t const p_slab_size, size_t const p_max_slabs, size_t const p_keep_empty, AllocateFct const p_allocate_fct, ReleaseFct const p_release_fct ) {
+	size_t element_size = p_element_size ? p_element_size : 1;
+	size_t slab_size = NextPowerOfTwo( p_slab_size ? p_slab_size : MMEM_SLAB_SIZE_DEFAULT );
+
+	// Grow the slab until at least one element fits behind the header
+	while ( SlabCapacity( slab_size, element_size ) == 0 ) {
+		slab_size <<= 1;
+	}
+
+	return (MemorySlabPool) {
+		.Used = 0,
+		.Capacity = 0,
+		.ElementSize = element_size,
+		.SlabSize = slab_size,
+		.SlabCapacity = SlabCapacity( slab_size, element_size ),
+		.Slabs = 0,
+		.EmptySlabs = 0,
+		.MaxSlabs = p_max_slabs,
+		.KeepEmpty = p_keep_empty,
+		.Id = MMEM_ATOMIC_FETCH_ADD( &SlabPoolIds, 1 ) + 1,
+		.Partial = NULL,
+		.Full = NULL,
+		.Allocate = p_allocate_fct,
+		.Release = p_release_fct ? p_release_fct : p_allocate_fct ? free : ReleaseAligned
+	};
+}
+
+void SlabPoolDestroy( MemorySlabPool * p_pool ) {
+	while ( p_pool->Partial ) {
+		SlabDestroy( p_pool, &p_pool->Partial, p_pool->Partial );
+	}
+	while ( p_pool->Full ) {
+		SlabDestroy( p_pool, &p_pool->Full, p_pool->Full );
+	}
+
+#if MMEM_ZERO_POLICY == MMEM_ZERO_POLICY_ONRELEASE
+	memset( p_pool, 0x00, sizeof( MemorySlabPool ) );
+#endif
+}
+
+void * SlabPoolAllocate( MemorySlabPool * p_pool ) {
+	MemorySlab * slab = p_pool->Partial;
+	if ( !slab ) {
+		slab = SlabCreate( p_pool );
+		if ( !slab ) {
+			return NULL;
+		}
+	}
+
+	void * ptr = PoolAllocate( &slab->Pool );
+	if ( slab->Pool.Used == 1 ) {
+		p_pool->EmptySlabs--;
+	}
+	if ( slab->Pool.Used == slab->Pool.Capacity ) {
+		SlabUnlink( &p_pool->Partial, slab );
+		SlabLink( &p_pool->Full, slab );
+	}
+
+	p_pool->Used++;
+	return ptr;
+}
+
+void SlabPoolRelease( MemorySlabPool * p_pool, void * p_element ) {
+	if ( !p_element ) {
+		return;
+	}
+
+	// Slabs are aligned to their size, the header is found by masking the address
+	MemorySlab * slab = (MemorySlab *)((uintptr_t)p_element & ~(uintptr_t)(p_pool->SlabSize - 1));
+	if ( slab->Owner != p_pool->Id ) {
+		return;
+	}
+
+	size_t used = slab->Pool.Used;
+	PoolRelease( &slab->Pool, p_element );
+	if ( slab->Pool.Used == used ) {
+		return;
+	}
+	p_pool->Used--;
+
+	if ( used == slab->Pool.Capacity ) {
+		SlabUnlink( &p_pool->Full, slab );
+		SlabLink( &p_pool->Partial, slab );
+	}
+
+	if ( slab->Pool.Used == 0 ) {
+		if ( p_pool->EmptySlabs >= p_pool->KeepEmpty ) {
+			SlabDestroy( p_pool, &p_pool->Partial, slab );
+		} else {
+			p_pool->EmptySlabs++;
+		}
+	}
+}
+
+void SlabPoolReset( MemorySlabPool * p_pool ) {
+	while ( p_pool->Full ) {
+		MemorySlab * slab = p_pool->Full;
+		SlabUnlink( &p_pool->Full, slab );
+		SlabLink( &p_pool->Partial, slab );
+	}
+
+	MemorySlab * slab = p_pool->Partial;
+	p_pool->EmptySlabs = 0;
+	while ( slab ) {
+		MemorySlab * next = slab->Next;
+		if ( p_pool->EmptySlabs >= p_pool->KeepEmpty ) {
+			SlabDestroy( p_pool, &p_pool->Partial, slab );
+		} else {
+			PoolReset( &slab->Pool );
+			p_pool->EmptySlabs++;
+		}
+		slab = next;
+	}
+
+	p_pool->Used = 0;
+}
+
+void SlabPoolTrim( MemorySlabPool * p_pool ) {
+	MemorySlab * slab = p_pool->Partial;
+	while ( slab ) {
+		MemorySlab * next = slab->Next;
+		if ( slab->Pool.Used == 0 ) {
+			SlabDestroy( p_pool, &p_pool->Partial, slab );
+			p_pool->EmptySlabs--;
+		}
+		slab = next;
+	}
+}
+
+static inline MemoryArenaBlock * ArenaBlockCreate( MemoryArena * p_arena, size_t const p_capacity ) {
+	size_t bytes = sizeof( MemoryArenaBlock ) + p_capacity;
+	MemoryArenaBlock * block = NULL;
+	if ( p_arena->Provider.Allocate ) {
+		block = p_arena->Provider.Allocate( &p_arena->Provider, bytes );
+	} else if ( p_arena->Allocate ) {
+		block = p_arena->Allocate( bytes, 1 );
+	} else {
+		// The header fills whole cache lines, so cache aligned blocks keep their data cache aligned
+		size_t alignment = ( p_arena->AlignmentPolicy & MMEM_ALIGNMENT_POLICY_HEAP ) ? MMEM_ALIGNMENT_CACHELINE : MMEM_ALIGNMENT_ALLOCATOR;
+		block = AllocateBlock( bytes, alignment, p_arena->ZeroPolicy == MMEM_ZERO_POLICY_ONRELEASE );
+	}
+	if ( block ) {
+		block->Next = NULL;
+		block->Capacity = p_capacity;
+		block->Used = 0;
+	}
+	return block;
+}
+
+static inline void ArenaBlockRelease( MemoryArena * p_arena, MemoryArenaBlock * p_block ) {
+	if ( p_arena->Provider.Release ) {
+		p_arena->Provider.Release( &p_arena->Provider, p_block, sizeof( MemoryArenaBlock ) + p_block->Capacity );
+	} else {
+		p_arena->Release( p_block );
+	}
+}
+
+static inline void ArenaEnter( MemoryArena * p_arena, MemoryArenaBlock * p_block ) {
+	p_arena->Current = p_block;
+	p_arena->Raw = p_block + 1;
+	p_arena->Capacity = p_block->Capacity;
+	p_arena->Used = 0;
+}
+
+/// @brief Zeroes released bytes of the arena as its zero policy demands
+static inline void ArenaZero( MemoryArena * p_arena, void * p_memory, size_t const p_size ) {
+	ZeroOnReleaseAs( p_arena->ZeroPolicy, p_memory, p_size );
+	STATS( StatsZeroed( &p_arena->Stats.Counters, p_arena->ZeroPolicy == MMEM_ZERO_POLICY_ONRELEASE, p_size ) );
+}
+
+/// @brief Commits further chunks of a virtual arena until p_size more bytes fit
+static bool ArenaCommit( MemoryArena * p_arena, size_t const p_size ) {
+	if ( p_size > p_arena->Reserved - p_arena->Used ) {
+		return false;
+	}
+
+	// Committed memory always ends on a page boundary, the header sits at the start of the reservation
+	size_t header = sizeof( MemoryArenaBlock );
+	size_t committed = (size_t)AlignAddress( header + p_arena->Used + p_size, MMEM_ARENA_COMMIT_CHUNK ) - header;
+	if ( committed > p_arena->Reserved ) {
+		committed = p_arena->Reserved;
+	}
+	if ( !VirtualCommit( (char *)p_arena->Raw + p_arena->Capacity, committed - p_arena->Capacity ) ) {
+		return false;
+	}
+
+	p_arena->Capacity = committed;
+	p_arena->Current->Capacity = committed;
+	STATS( p_arena->Stats.Counters.Grows++ );
+	return true;
+}
+
+/// @brief Shrinks a virtual arena to p_used bytes, decommitting the pages above the retained ones
+static void ArenaDecommit( MemoryArena * p_arena, size_t const p_used ) {
+	size_t header = sizeof( MemoryArenaBlock );
+	size_t keep = (size_t)AlignAddress( header + p_used, PageSize() ) - header;
+	if ( keep < p_arena->Retained ) {
+		keep = p_arena->Retained;
+	}
+
+	if ( keep < p_arena->Capacity ) {
+		VirtualDecommit( (char *)p_arena->Raw + keep, p_arena->Capacity - keep );
+		p_arena->Capacity = keep;
+		p_arena->Current->Capacity = keep;
+	}
+
+	// Only the bytes still committed need zeroing, decommitted pages come back zeroed
+	if ( p_arena->Used > p_used ) {
+		ArenaZero( p_arena, (char *)p_arena->Raw + p_used, (p_arena->Used < keep ? p_arena->Used : keep) - p_used );
+	}
+	p_arena->Used = p_used;
+}
+
+/// @brief Moves the arena on to a block with at least p_size bytes, reusing spare blocks first
+static bool ArenaGrow( MemoryArena * p_arena, size_t const p_size ) {
+	MemoryArenaBlock * current = p_arena->Current;
+	if ( p_arena->Reserved ) {
+		return ArenaCommit( p_arena, p_size );
+	}
+	if ( p_arena->Growth <= 0.0 || !current ) {
+		return false;
+	}
+
+	// Spare blocks too small for this request are dropped, the following blocks are larger
+	while ( current->Next && current->Next->Capacity < p_size ) {
+		MemoryArenaBlock * small = current->Next;
+		current->Next = small->Next;
+		p_arena->Spare -= small->Capacity;
+		ArenaBlockRelease( p_arena, small );
+	}
+
+	MemoryArenaBlock * next = current->Next;
+	if ( next ) {
+		p_arena->Spare -= next->Capacity;
+	} else {
+		double grown = (double)p_arena->Capacity * ( p_arena->Growth < 1.0 ? 1.0 : p_arena->Growth );
+		size_t capacity = (size_t)grown;
+		next = ArenaBlockCreate( p_arena, capacity > p_size ? capacity : p_size );
+		if ( !next ) {
+			return false;
+		}
+		current->Next = next;
+	}
+
+	current->Used = p_arena->Used;
+	p_arena->UsedBefore += p_arena->Used;
+	ArenaEnter( p_arena, next );
+	STATS( p_arena->Stats.Counters.Grows++ );
+	return true;
+}
+
+/// @brief Element size of every heap size class, spaced at most 25% apart above 64 bytes
+static size_t const HeapClassSizes[MMEM_HEAP_CLASSES] = {
+	8, 16, 24, 32, 40, 48, 56, 64,
+	80, 96, 112, 128, 160, 192, 224, 256,
+	320, 384, 448, 512, 640, 768, 896, 1024,
+	1280, 1536, 1792, 2048, 2560, 3072, 3584, 4096
+};
+
+static inline MemorySlab * HeapSlabOf( MemoryHeap * p_heap, void * p_element ) {
+	// Every size class shares the slab size
+	return (MemorySlab *)((uintptr_t)p_element & ~(uintptr_t)(p_heap->Pools[0].SlabSize - 1));
+}
+
+static inline MemoryHeapLarge * HeapLargeOf( MemoryHeap * p_heap, void * p_element ) {
+	// The word in front of a pooled object lies inside its slab, so reading the tag is safe for both kinds
+	MemoryHeapLarge * header = (MemoryHeapLarge *)p_element - 1;
+	if ( header->Tag != ((uint64_t)(uintptr_t)header ^ MMEM_HEAP_LARGE_TAG) ) {
+		return NULL;
+	}
+	// Pooled data matching the tag by chance is no member of the list of large objects
+	return ( header->Prev ? header->Prev->Next == header : p_heap->Large == header ) ? header : NULL;
+}
+
+static void * HeapAllocateLarge( MemoryHeap * p_heap, size_t const p_size ) {
+	if ( p_size > SIZE_MAX - sizeof( MemoryHeapLarge ) ) {
+		return NULL;
+	}
+
+	// Large objects keep the natural alignment of the allocator, the header keeps it for the object
+	size_t bytes = sizeof( MemoryHeapLarge ) + p_size;
+	MemoryHeapLarge * header = p_heap->Allocate ? p_heap->Allocate( bytes, 1 ) : AllocateBlock( bytes, MMEM_ALIGNMENT_ALLOCATOR, MMEM_ZERO_POLICY == MMEM_ZERO_POLICY_ONRELEASE );
+	if ( !header ) {
+		return NULL;
+	}
+
+	header->Prev = NULL;
+	header->Next = p_heap->Large;
+	if ( p_heap->Large ) {
+		p_heap->Large->Prev = header;
+	}
+	p_heap->Large = header;
+	header->Size = p_size;
+	header->Tag = (uint64_t)(uintptr_t)header ^ MMEM_HEAP_LARGE_TAG;
+	p_heap->LargeUsed += p_size;
+
+	void * ptr = header + 1;
+	ZeroOnAllocate( ptr, p_size );
+	return ptr;
+}
+
+static void HeapReleaseLarge( MemoryHeap * p_heap, MemoryHeapLarge * p_header ) {
+	if ( p_header->Prev ) {
+		p_header->Prev->Next = p_header->Next;
+	} else {
+		p_heap->Large = p_header->Next;
+	}
+	if ( p_header->Next ) {
+		p_header->Next->Prev = p_header->Prev;
+	}
+	p_heap->LargeUsed -= p_header->Size;
+	// A stale tag would let a released header pass for a large object
+	p_header->Tag = 0;
+	p_heap->Release( p_header );
+}
+
+MemoryHeap HeapOpen( void ) {
+	return HeapOpenEx( 0, NULL, NULL );
+}
+
+MemoryHeap HeapOpenEx( size_t const p_slab_size, AllocateFct const p_allocate_fct, ReleaseFct const p_release_fct ) {
+	MemoryHeap heap = {
+		.LargeUsed = 0,
+		.Large = NULL,
+		.Allocate = p_allocate_fct,
+		.Release = p_release_fct ? p_release_fct : free
+	};
+
+	// Every class shares the slab size of the largest class, which needs the largest slab to fit
+	size_t slab_size = SlabPoolCreate( MMEM_HEAP_SMALL_MAX, p_slab_size ).SlabSize;
+	for ( size_t cls = 0; cls < MMEM_HEAP_CLASSES; ++cls ) {
+		heap.Pools[cls] = SlabPoolCreateEx( HeapClassSizes[cls], slab_size, 0, 1, NULL, NULL );
+	}
+
+	size_t cls = 0;
+	for ( size_t index = 0; index <= (MMEM_HEAP_SMALL_MAX >> 3); ++index ) {
+		while ( HeapClassSizes[cls] < (index << 3) ) {
+			cls++;
+		}
+		heap.Classes[index] = (uint8_t)cls;
+	}
+	return heap;
+}
+
+void HeapClose( MemoryHeap * p_heap ) {
+	for ( size_t cls = 0; cls < MMEM_HEAP_CLASSES; ++cls ) {
+		SlabPoolDestroy( &p_heap->Pools[cls] );
+	}
+	while ( p_heap->Large ) {
+		HeapReleaseLarge( p_heap, p_heap->Large );
+	}
+
+#if MMEM_ZERO_POLICY == MMEM_ZERO_POLICY_ONRELEASE
+	memset( p_heap, 0x00, sizeof( MemoryHeap ) );
+#endif
+}
+
+void * HeapAllocate( MemoryHeap * p_heap, size_t const p_size ) {
+	if ( p_size <= MMEM_HEAP_SMALL_MAX ) {
+		return SlabPoolAllocate( &p_heap->Pools[p_heap->Classes[(p_size + 7) >> 3]] );
+	}
+	return HeapAllocateLarge( p_heap, p_size );
+}
+
+void HeapRelease( MemoryHeap * p_heap, void * p_element ) {
+	if ( !p_element ) {
+		return;
+	}
+
+	MemoryHeapLarge * large = HeapLargeOf( p_heap, p_element );
+	if ( large ) {
+		HeapReleaseLarge( p_heap, large );
+		return;
+	}
+
+	// Slabs of a size class hold elements of exactly the class size, which maps back to the class
+	MemorySlab * slab = HeapSlabOf( p_heap, p_element );
+	if ( slab->Pool.ElementSize <= MMEM_HEAP_SMALL_MAX ) {
+		SlabPoolRelease( &p_heap->Pools[p_heap->Classes[(slab->Pool.ElementSize + 7) >> 3]], p_element );
+	}
+}
+
+void * HeapResize( MemoryHeap * p_heap, void * p_element, size_t const p_size ) {
+	if ( !p_element ) {
+		return HeapAllocate( p_heap, p_size );
+	}
+	if ( !p_size ) {
+		HeapRelease( p_heap, p_element );
+		return NULL;
+	}
+
+	size_t usable = HeapUsableSize( p_heap, p_element );
+	if ( usable <= MMEM_HEAP_SMALL_MAX ) {
+		// Objects stay in place as long as they keep their size class
+		if ( p_size <= MMEM_HEAP_SMALL_MAX && HeapClassSizes[p_heap->Classes[(p_size + 7) >> 3]] == usable ) {
+			return p_element;
+		}
+	} else if ( p_size > MMEM_HEAP_SMALL_MAX && p_size <= usable && p_size >= usable / 2 ) {
+		return p_element;
+	}
+
+	void * ptr = HeapAllocate( p_heap, p_size );
+	if ( ptr ) {
+		memcpy( ptr, p_element, usable < p_size ? usable : p_size );
+		HeapRelease( p_heap, p_element );
+	}
+	return ptr;
+}
+
+size_t HeapUsableSize( MemoryHeap * p_heap, void * p_element ) {
+	if ( !p_element ) {
+		return 0;
+	}
+
+	MemoryHeapLarge * large = HeapLargeOf( p_heap, p_element );
+	return large ? large->Size : HeapSlabOf( p_heap, p_element )->Pool.ElementSize;
+}
+
+void HeapTrim( MemoryHeap * p_heap ) {
+	for ( size_t cls = 0; cls < MMEM_HEAP_CLASSES; ++cls ) {
+		SlabPoolTrim( &p_heap->Pools[cls] );
+	}
+}
+
+size_t HeapBytesInUse( MemoryHeap * p_heap ) {
+	size_t used = p_heap->LargeUsed;
+	for ( size_t cls = 0; cls < MMEM_HEAP_CLASSES; ++cls ) {
+		used += p_heap->Pools[cls].Used * p_heap->Pools[cls].ElementSize;
+	}
+	return used;
+}
+
+/// @brief Head of the queue of an id no cache is attached under, objects are never queued to it
+#define MMEM_REMOTE_CLOSED ((void *)(uintptr_t)1)
+
+/// @brief Word each thread continues its search at, stored plus one so zero marks an unset hint
+static MMEM_THREAD_LOCAL size_t ConcurrentHint;
+
+static inline size_t ConcurrentStart( size_t const words ) {
+	if ( !ConcurrentHint ) {
+		// Spread fresh threads by the address of their thread local storage
+		uintptr_t seed = (uintptr_t)&ConcurrentHint;
+		seed ^= seed >> 17;
+		seed *= (uintptr_t)0x9E3779B97F4A7C15ULL;
+		ConcurrentHint = (size_t)(seed >> 16) + 1;
+	}
+	return (ConcurrentHint - 1) % words;
+}
+
+MemoryPoolConcurrent PoolConcurrentCreate( size_t const p_element_size, size_t const p_capacity ) {
+	return PoolConcurrentCreateEx( p_element_size, p_capacity, Allocate, free );
+}
+
+MemoryPoolConcurrent PoolConcurrentCreateEx( size_t const p_element_size, size_t const p_capacity, AllocateFct const p_allocate_fct, ReleaseFct const p_release_fct ) {
+	// Objects queued to a thread cache by other threads store the link to the next object in place
+	size_t element_size = p_element_size < sizeof( void * ) ? sizeof( void * ) : p_element_size;
+	size_t words = MemoryBitmapWords( p_capacity ) ? MemoryBitmapWords( p_capacity ) : 1;
+	ReleaseFct release = p_release_fct ? p_release_fct : free;
+	uint64_t * list = calloc( words, sizeof( uint64_t ) );
+	uint64_t * owners = calloc( words, sizeof( uint64_t ) );
+	MemoryPoolRemote * remotes = AllocateAligned( (MMEM_CACHE_MAX + 1) * sizeof( MemoryPoolRemote ), MMEM_ALIGNMENT_CACHELINE, false );
+	bool fits = p_capacity <= SIZE_MAX / element_size;
+	void * raw = !fits ? NULL : p_allocate_fct ? p_allocate_fct( p_capacity, element_size ) : Allocate( element_size, p_capacity );
+	if ( !list || !owners || !remotes || !raw ) {
+		// A pool missing any part holds no memory and hands out none
+		if ( raw ) {
+			release( raw );
+		}
+		free( list );
+		free( owners );
+		ReleaseAligned( remotes );
+		return (MemoryPoolConcurrent) {
+			.List = NULL,
+			.Words = 0,
+			.Raw = NULL,
+			.ElementSize = element_size,
+			.Capacity = 0,
+			.Release = release,
+			.Owners = NULL,
+			.Remotes = NULL
+		};
+	}
+	memset( remotes, 0x00, (MMEM_CACHE_MAX + 1) * sizeof( MemoryPoolRemote ) );
+	for ( size_t id = 0; id <= MMEM_CACHE_MAX; ++id ) {
+		remotes[id].Head = MMEM_REMOTE_CLOSED;
+	}
+
+	// Mark padding as used, it is never claimed
+	for ( size_t bit = p_capacity; bit < words * MMEM_BITMAP_WORD_BITS; ++bit ) {
+		list[MemoryBitmapWordOf( bit )] |= MemoryBitmapMask( bit );
+	}
+
+	return (MemoryPoolConcurrent) {
+		.List = list,
+		.Words = words,
+		.Raw = raw,
+		.ElementSize = element_size,
+		.Capacity = p_capacity,
+		.Release = release,
+		.Owners = owners,
+		.Remotes = remotes
+	};
+}
+
+void PoolConcurrentDestroy( MemoryPoolConcurrent * p_pool ) {
+	p_pool->Release( p_pool->Raw );
+	free( p_pool->List );
+	free( p_pool->Owners );
+	ReleaseAligned( p_pool->Remotes );
+
+#if MMEM_ZERO_POLICY == MMEM_ZERO_POLICY_ONRELEASE
+	memset( p_pool, 0x00, sizeof( MemoryPoolConcurrent ) );
+#endif
+}
+
+void * PoolConcurrentAllocate( MemoryPoolConcurrent * p_pool ) {
+	size_t words = p_pool->Words;
+	if ( !words ) {
+		return NULL;
+	}
+	size_t word = ConcurrentStart( words );
+
+	for ( size_t i = 0; i < words; ++i ) {
+		uint64_t bits = MMEM_ATOMIC_LOAD( &p_pool->List[word] );
+		while ( bits != MMEM_BITMAP_WORD_FULL ) {
+			// Claim the lowest clear bit, another thread may have claimed it first
+			uint64_t mask = ~bits & (bits + 1);
+			uint64_t old = MMEM_ATOMIC_FETCH_OR( &p_pool->List[word], mask );
+			if ( !( old & mask ) ) {
+				ConcurrentHint = word + 1;
+				void * ptr = (char *)p_pool->Raw + ((word << MMEM_BITMAP_WORD_SHIFT) | MMEM_CTZ64( mask )) * p_pool->ElementSize;
+				ZeroOnAllocate( ptr, p_pool->ElementSize );
+				return ptr;
+			}
+			bits = old | mask;
+		}
+		if ( ++word == words ) {
+			word = 0;
+		}
+	}
+
+	return NULL;
+}
+
+void PoolConcurrentRelease( MemoryPoolConcurrent * p_pool, void * p_element ) {
+	// Check for bounds. Out of bounds pointers cannot be valid objects of this pool
+	size_t offset = (size_t)((uintptr_t)p_element - (uintptr_t)p_pool->Raw);
+	size_t index = offset / p_pool->ElementSize;
+	if ( index >= p_pool->Capacity ) {
+		return;
+	}
+
+	// Check for alignment. Misaligned pointers cannot be valid objects of this pool
+	if ( offset - index * p_pool->ElementSize != 0 ) {
+		return;
+	}
+
+	// Check if the object is actually a managed object. The slot is zeroed before it is published as free
+	uint64_t mask = MemoryBitmapMask( index );
+	if ( !( MMEM_ATOMIC_LOAD( &p_pool->List[MemoryBitmapWordOf( index )] ) & mask ) ) {
+		return;
+	}
+	ZeroOnRelease( p_element, p_pool->ElementSize );
+	MMEM_ATOMIC_FETCH_AND( &p_pool->List[MemoryBitmapWordOf( index )], ~mask );
+}
+
+void PoolConcurrentReset( MemoryPoolConcurrent * p_pool ) {
+	if ( !p_pool->List ) {
+		return;
+	}
+#if MMEM_ZERO_POLICY == MMEM_ZERO_POLICY_ONRELEASE
+	// Slots held by caches or queued to them are still marked, every other slot was zeroed on release
+	ZeroUsedRuns( p_pool->List, p_pool->Capacity, p_pool->Raw, p_pool->ElementSize );
+#endif
+
+	memset( p_pool->List, 0x00, p_pool->Words * sizeof( uint64_t ) );
+	for ( size_t bit = p_pool->Capacity; bit < p_pool->Words * MMEM_BITMAP_WORD_BITS; ++bit ) {
+		p_pool->List[MemoryBitmapWordOf( bit )] |= MemoryBitmapMask( bit );
+	}
+
+	memset( p_pool->Owners, 0x00, p_pool->Words * sizeof( uint64_t ) );
+	for ( size_t id = 0; id <= MMEM_CACHE_MAX; ++id ) {
+		p_pool->Remotes[id].Head = p_pool->Remotes[id].Attached ? NULL : MMEM_REMOTE_CLOSED;
+	}
+}
+
+size_t PoolConcurrentSlotsInUse( MemoryPoolConcurrent * p_pool ) {
+	size_t used = 0;
+	for ( size_t word = 0; word < p_pool->Words; ++word ) {
+		used += MMEM_POPCOUNT64( MMEM_ATOMIC_LOAD( &p_pool->List[word] ) );
+	}
+	return used - (p_pool->Words * MMEM_BITMAP_WORD_BITS - p_pool->Capacity);
+}
+
+/// @brief Index of the slot the element occupies, SIZE_MAX for foreign or misaligned pointers
+static inline size_t ConcurrentIndex( MemoryPoolConcurrent const * p_pool, void const * p_element ) {
+	size_t offset = (size_t)((uintptr_t)p_element - (uintptr_t)p_pool->Raw);
+	size_t index = offset / p_pool->ElementSize;
+	if ( index >= p_pool->Capacity || offset - index * p_pool->ElementSize != 0 ) {
+		return SIZE_MAX;
+	}
+	return index;
+}
+
+/// @brief Publishes the slots of the elements as free, with one atomic operation per run of elements in the same word
+static void ConcurrentReleaseBatch( MemoryPoolConcurrent * p_pool, void * const * p_elements, size_t const p_count ) {
+	size_t word = SIZE_MAX;
+	uint64_t mask = 0;
+
+	for ( size_t i = 0; i < p_count; ++i ) {
+		size_t index = (size_t)((uintptr_t)p_elements[i] - (uintptr_t)p_pool->Raw) / p_pool->ElementSize;
+		if ( MemoryBitmapWordOf( index ) != word ) {
+			if ( mask ) {
+				MMEM_ATOMIC_FETCH_AND( &p_pool->List[word], ~mask );
+			}
+			word = MemoryBitmapWordOf( index );
+			mask = 0;
+		}
+		mask |= MemoryBitmapMask( index );
+	}
+
+	if ( mask ) {
+		MMEM_ATOMIC_FETCH_AND( &p_pool->List[word], ~mask );
+	}
+}
+
+/// @brief Queues an object to another cache, false if the cache detached meanwhile
+static inline bool RemotePush( MemoryPoolRemote * p_remote, void * p_element ) {
+	void * head = MMEM_ATOMIC_LOAD_PTR( &p_remote->Head );
+	do {
+		if ( head == MMEM_REMOTE_CLOSED ) {
+			return false;
+		}
+		memcpy( p_element, &head, sizeof( void * ) );
+	} while ( !MMEM_ATOMIC_CAS_PTR( &p_remote->Head, &head, p_element ) );
+	return true;
+}
+
+/// @brief Takes a list of queued objects, the magazine takes as many as fit and the pool the rest
+static void CacheTake( MemoryPoolCache * p_cache, void * p_node ) {
+	void * node = p_node;
+	while ( node ) {
+		void * next = NULL;
+		memcpy( &next, node, sizeof( void * ) );
+#if MMEM_ZERO_POLICY == MMEM_ZERO_POLICY_ONRELEASE
+		memset( node, 0x00, sizeof( void * ) );
+#endif
+		if ( p_cache->Count < MMEM_CACHE_MAGAZINE ) {
+			p_cache->Magazine[p_cache->Count++] = node;
+		} else {
+			ConcurrentReleaseBatch( p_cache->Pool, &node, 1 );
+		}
+		node = next;
+	}
+}
+
+/// @brief Takes every object queued by other threads
+static void CacheDrain( MemoryPoolCache * p_cache ) {
+	MemoryPoolRemote * remote = &p_cache->Pool->Remotes[p_cache->Id];
+	if ( MMEM_ATOMIC_LOAD_PTR( &remote->Head ) ) {
+		CacheTake( p_cache, MMEM_ATOMIC_EXCHANGE_PTR( &remote->Head, NULL ) );
+	}
+}
+
+/// @brief Claims the free slots of one state word at once, as many as the magazine can take
+static void CacheRefill( MemoryPoolCache * p_cache ) {
+	MemoryPoolConcurrent * pool = p_cache->Pool;
+	size_t space = MMEM_CACHE_MAGAZINE - p_cache->Count;
+	size_t words = pool->Words;
+	size_t word = ConcurrentStart( words );
+
+	for ( size_t i = 0; i < words; ++i ) {
+		uint64_t bits = MMEM_ATOMIC_LOAD( &pool->List[word] );
+		while ( bits != MMEM_BITMAP_WORD_FULL ) {
+			uint64_t take = 0;
+			uint64_t rest = ~bits;
+			for ( size_t n = 0; n < space && rest; ++n ) {
+				uint64_t lowest = rest & (0 - rest);
+				take |= lowest;
+				rest ^= lowest;
+			}
+
+			uint64_t got = take & ~MMEM_ATOMIC_FETCH_OR( &pool->List[word], take );
+			if ( got ) {
+				ConcurrentHint = word + 1;
+				MMEM_ATOMIC_STORE( &pool->Owners[word], (uint64_t)p_cache->Id );
+				// Push the highest slot first, so the lowest address is handed out first
+				char * base = (char *)pool->Raw + (word << MMEM_BITMAP_WORD_SHIFT) * pool->ElementSize;
+				void * slots[MMEM_BITMAP_WORD_BITS];
+				size_t count = 0;
+				while ( got ) {
+					slots[count++] = base + MMEM_CTZ64( got ) * pool->ElementSize;
+					got &= got - 1;
+				}
+				while ( count ) {
+					p_cache->Magazine[p_cache->Count++] = slots[--count];
+				}
+				return;
+			}
+			bits |= take;
+		}
+		if ( ++word == words ) {
+			word = 0;
+		}
+	}
+}
+
+bool PoolCacheAttach( MemoryPoolCache * p_cache, MemoryPoolConcurrent * p_pool ) {
+	if ( !p_pool->Remotes ) {
+		return false;
+	}
+	for ( size_t id = 1; id <= MMEM_CACHE_MAX; ++id ) {
+		uint64_t expected = 0;
+		if ( MMEM_ATOMIC_CAS( &p_pool->Remotes[id].Attached, &expected, 1 ) ) {
+			(void)MMEM_ATOMIC_EXCHANGE_PTR( &p_pool->Remotes[id].Head, NULL );
+			p_cache->Pool = p_pool;
+			p_cache->Id = id;
+			p_cache->Count = 0;
+			return true;
+		}
+	}
+	return false;
+}
+
+void PoolCacheDetach( MemoryPoolCache * p_cache ) {
+	if ( !p_cache->Id ) {
+		return;
+	}
+
+	// Threads that saw the cache attached and find the queue closed keep their objects themselves
+	MemoryPoolRemote * remote = &p_cache->Pool->Remotes[p_cache->Id];
+	PoolCacheFlush( p_cache );
+	CacheTake( p_cache, MMEM_ATOMIC_EXCHANGE_PTR( &remote->Head, MMEM_REMOTE_CLOSED ) );
+	ConcurrentReleaseBatch( p_cache->Pool, p_cache->Magazine, p_cache->Count );
+	p_cache->Count = 0;
+	MMEM_ATOMIC_STORE( &remote->Attached, (uint64_t)0 );
+	p_cache->Id = 0;
+}
+
+void * PoolCacheAllocate( MemoryPoolCache * p_cache ) {
+	if ( !p_cache->Count ) {
+		CacheDrain( p_cache );
+		if ( !p_cache->Count ) {
+			CacheRefill( p_cache );
+			if ( !p_cache->Count ) {
+				return NULL;
+			}
+		}
+	}
+
+	void * ptr = p_cache->Magazine[--p_cache->Count];
+	ZeroOnAllocate( ptr, p_cache->Pool->ElementSize );
+	return ptr;
+}
+
+void PoolCacheRelease( MemoryPoolCache * p_cache, void * p_element ) {
+	MemoryPoolConcurrent * pool = p_cache->Pool;
+	size_t index = ConcurrentIndex( pool, p_element );
+	if ( index == SIZE_MAX ) {
+		return;
+	}
+
+	// Slots free in the pool were not handed out, slots waiting in a magazine or queue cannot be told apart
+	if ( !( MMEM_ATOMIC_LOAD( &pool->List[MemoryBitmapWordOf( index )] ) & MemoryBitmapMask( index ) ) ) {
+		return;
+	}
+	ZeroOnRelease( p_element, pool->ElementSize );
+
+	// Slots last claimed by another attached cache go back to it, so its working set stays local
+	uint64_t owner = MMEM_ATOMIC_LOAD( &pool->Owners[MemoryBitmapWordOf( index )] );
+	if ( owner && owner != p_cache->Id && MMEM_ATOMIC_LOAD( &pool->Remotes[owner].Attached ) && RemotePush( &pool->Remotes[owner], p_element ) ) {
+		return;
+	}
+
+	if ( p_cache->Count == MMEM_CACHE_MAGAZINE ) {
+		// Flush the older half, the recently released slots are the ones still in cache
+		size_t half = MMEM_CACHE_MAGAZINE / 2;
+		ConcurrentReleaseBatch( pool, p_cache->Magazine, half );
+		memmove( p_cache->Magazine, p_cache->Magazine + half, (MMEM_CACHE_MAGAZINE - half) * sizeof( void * ) );
+		p_cache->Count -= half;
+	}
+	p_cache->Magazine[p_cache->Count++] = p_element;
+}
+
+void PoolCacheFlush( MemoryPoolCache * p_cache ) {
+	ConcurrentReleaseBatch( p_cache->Pool, p_cache->Magazine, p_cache->Count );
+	p_cache->Count = 0;
+
+	CacheDrain( p_cache );
+	ConcurrentReleaseBatch( p_cache->Pool, p_cache->Magazine, p_cache->Count );
+	p_cache->Count = 0;
+}
+
+MemoryArena ArenaCreate( const size_t p_capacity ) {
+	return ArenaCreateEx( p_capacity, NULL, NULL );
+}
+
+MemoryArena ArenaCreateEx( const size_t p_capacity, AllocateFct const p_allocate_fct, ReleaseFct const p_release_fct ) {
+	return ArenaCreateGrowableEx( p_capacity, 0.0, 0, p_allocate_fct, p_release_fct );
+}
+
+MemoryArena ArenaCreateGrowable( size_t const p_capacity, double const p_growth, size_t const p_retain ) {
+	return ArenaCreateGrowableEx( p_capacity, p_growth, p_retain, NULL, NULL );
+}
+
+static inline void * ArenaAllocateAs( MemoryArena * p_arena, size_t const p_size, unsigned int const p_zero ) {
+	if ( p_arena->Used + p_size > p_arena->Capacity && !ArenaGrow( p_arena, p_size ) ) {
+		STATS( StatsAllocation( &p_arena->Stats.Counters, false, 0 ) );
+		return NULL;
+	}
+
+	void * ptr = (char *)p_arena->Raw + p_arena->Used;
+	ZeroOnAllocateAs( p_zero, ptr, p_size );
+
+	p_arena->Used += p_size;
+	STATS( StatsAllocation( &p_arena->Stats.Counters, true, p_arena->UsedBefore + p_arena->Used ) );
+	STATS( StatsZeroed( &p_arena->Stats.Counters, p_zero == MMEM_ZERO_POLICY_ONALLOCATE, p_size ) );
+	return ptr;
+}
+
+static inline void * ArenaAllocateAlignedAs( MemoryArena * p_arena, size_t const p_size, size_t const p_alignment, unsigned int const p_zero ) {
+	size_t mask = p_alignment ? p_alignment - 1 : 0;
+	size_t padding = (size_t)(0 - ((uintptr_t)p_arena->Raw + p_arena->Used)) & mask;
+
+	if ( p_arena->Used + padding + p_size > p_arena->Capacity ) {
+		// A new block is only guaranteed to be aligned to the allocator, reserve room for the padding
+		if ( !ArenaGrow( p_arena, p_size + mask ) ) {
+			STATS( StatsAllocation( &p_arena->Stats.Counters, false, 0 ) );
+			return NULL;
+		}
+		padding = (size_t)(0 - ((uintptr_t)p_arena->Raw + p_arena->Used)) & mask;
+	}
+
+	void * ptr = (char *)p_arena->Raw + p_arena->Used + padding;
+	ZeroOnAllocateAs( p_zero, ptr, p_size );
+
+	p_arena->Used += padding + p_size;
+	STATS( StatsAllocation( &p_arena->Stats.Counters, true, p_arena->UsedBefore + p_arena->Used ) );
+	STATS( StatsZeroed( &p_arena->Stats.Counters, p_zero == MMEM_ZERO_POLICY_ONALLOCATE, p_size ) );
+	return ptr;
+}
+
+// Only zeroing on allocation touches the allocation routines, the other policies share the plain ones
+static void * ArenaAllocateZeroing( MemoryArena * p_arena, size_t p_size ) {
+	return ArenaAllocateAs( p_arena, p_size, MMEM_ZERO_POLICY_ONALLOCATE );
+}
+
+static void * ArenaAllocatePlain( MemoryArena * p_arena, size_t p_size ) {
+	return ArenaAllocateAs( p_arena, p_size, MMEM_ZERO_POLICY_MANUAL );
+}
+
+static void * ArenaAllocateAlignedZeroing( MemoryArena * p_arena, size_t p_size, size_t p_alignment ) {
+	return ArenaAllocateAlignedAs( p_arena, p_size, p_alignment, MMEM_ZERO_POLICY_ONALLOCATE );
+}
+
+static void * ArenaAllocateAlignedPlain( MemoryArena * p_arena, size_t p_size, size_t p_alignment ) {
+	return ArenaAllocateAlignedAs( p_arena, p_size, p_alignment, MMEM_ZERO_POLICY_MANUAL );
+}
+
+static void ArenaBind( MemoryArena * p_arena, unsigned int const p_zero, unsigned int const p_policy ) {
+	bool zeroing = p_zero == MMEM_ZERO_POLICY_ONALLOCATE;
+	p_arena->ZeroPolicy = p_zero <= MMEM_ZERO_POLICY_MANUAL ? p_zero : MMEM_ZERO_POLICY;
+	p_arena->AlignmentPolicy = p_policy;
+	p_arena->AllocateBytes = zeroing ? ArenaAllocateZeroing : ArenaAllocatePlain;
+	p_arena->AllocateAlignedBytes = zeroing ? ArenaAllocateAlignedZeroing : ArenaAllocateAlignedPlain;
+}
+
+static MemoryArena ArenaInit( size_t const p_capacity, double const p_growth, size_t const p_retain, AllocateFct const p_allocate_fct, ReleaseFct const p_release_fct, MemoryProvider const * p_provider, unsigned int const p_zero, unsigned int const p_policy ) {
+	MemoryArena arena = {
+		.Used = 0,
+		.Raw = NULL,
+		.Capacity = 0,
+		.Release = p_release_fct ? p_release_fct : ( !p_allocate_fct && ( p_policy & MMEM_ALIGNMENT_POLICY_HEAP ) ) ? ReleaseAligned : free,
+		.Allocate = p_allocate_fct,
+		.First = NULL,
+		.Current = NULL,
+		.UsedBefore = 0,
+		.Spare = 0,
+		.Growth = p_growth,
+		.Retain = p_retain,
+		.Reserved = 0,
+		.Retained = 0,
+		.Provider = p_provider ? *p_provider : (MemoryProvider) { 0 }
+	};
+	ArenaBind( &arena, p_zero, p_policy );
+
+	arena.First = ArenaBlockCreate( &arena, p_capacity );
+	if ( arena.First ) {
+		ArenaEnter( &arena, arena.First );
+	}
+	return arena;
+}
+
+MemoryArena ArenaCreateGrowableEx( size_t const p_capacity, double const p_growth, size_t const p_retain, AllocateFct const p_allocate_fct, ReleaseFct const p_release_fct ) {
+	return ArenaInit( p_capacity, p_growth, p_retain, p_allocate_fct, p_release_fct, NULL, MMEM_ZERO_POLICY, MMEM_ALIGNMENT_POLICY );
+}
+
+MemoryArena ArenaCreateOpt( size_t const p_capacity, MemoryArenaOptions const * p_options ) {
+	if ( !p_options ) {
+		return ArenaCreate( p_capacity );
+	}
+
+	MemoryProvider const * provider = p_options->Provider.Allocate ? &p_options->Provider : NULL;
+	unsigned int zero = ZeroPolicyOf( p_options->ZeroPolicy );
+	unsigned int policy = AlignmentPolicyOf( p_options->AlignmentPolicy );
+	return ArenaInit( p_capacity, p_options->Growth, p_options->Retain, NULL, NULL, provider, zero, policy );
+}
+
+MemoryArena ArenaCreateVirtual( size_t const p_reserve, size_t const p_retain ) {
+	MemoryArena arena = {
+		.Used = 0,
+		.Raw = NULL,
+		.Capacity = 0,
+		.Release = NULL,
+		.Allocate = NULL,
+		.First = NULL,
+		.Current = NULL,
+		.UsedBefore = 0,
+		.Spare = 0,
+		.Growth = 0.0,
+		.Retain = 0,
+		.Reserved = 0,
+		.Retained = 0,
+		.Provider = { 0 }
+	};
+	ArenaBind( &arena, MMEM_ZERO_POLICY, MMEM_ALIGNMENT_POLICY );
+
+	size_t header = sizeof( MemoryArenaBlock );
+	size_t page = PageSize();
+	if ( p_reserve > SIZE_MAX - header - page ) {
+		return arena;
+	}
+
+	size_t reserved = (size_t)AlignAddress( header + p_reserve, page );
+	MemoryArenaBlock * block = VirtualReserve( reserved );
+	if ( !block ) {
+		return arena;
+	}
+
+	// The first chunk holds the header, so it is committed right away
+	size_t committed = MMEM_ARENA_COMMIT_CHUNK < reserved ? MMEM_ARENA_COMMIT_CHUNK : reserved;
+	if ( !VirtualCommit( block, committed ) ) {
+		VirtualRelease( block, reserved );
+		return arena;
+	}
+
+	block->Next = NULL;
+	block->Capacity = committed - header;
+	block->Used = 0;
+
+	size_t retained = (size_t)AlignAddress( header + p_retain, page );
+	arena.First = block;
+	arena.Reserved = reserved - header;
+	arena.Retained = (retained < reserved ? retained : reserved) - header;
+	ArenaEnter( &arena, block );
+	return arena;
+}
+
+void ArenaDestroy( MemoryArena * p_arena ) {
+	bool zero = p_arena->ZeroPolicy == MMEM_ZERO_POLICY_ONRELEASE;
+	STATS( StatsUnregister( &p_arena->Stats ) );
+	PROFILE( ProfileArenaStop( p_arena ) );
+	if ( p_arena->Reserved ) {
+		VirtualRelease( p_arena->First, sizeof( MemoryArenaBlock ) + p_arena->Reserved );
+	} else {
+		MemoryArenaBlock * block = p_arena->First;
+		while ( block ) {
+			MemoryArenaBlock * next = block->Next;
+			ArenaBlockRelease( p_arena, block );
+			block = next;
+		}
+	}
+
+	if ( zero ) {
+		memset( p_arena, 0x00, sizeof( MemoryArena ) );
+	}
+}
+
+void * ArenaAllocate( MemoryArena * p_arena, size_t p_size ) {
+	return p_arena->AllocateBytes( p_arena, p_size );
+}
+
+void * ArenaAllocateAligned( MemoryArena * p_arena, size_t p_size, size_t p_alignment ) {
+	return p_arena->AllocateAlignedBytes( p_arena, p_size, p_alignment );
+}
+
+void ArenaRewind( MemoryArena * p_arena, MemoryArenaMarker const p_marker ) {
+	if ( !p_marker.Block ) {
+		return;
+	}
+	STATS( p_arena->Stats.Counters.Releases++ );
+	PROFILE( ProfileForget( p_arena->Profile, p_marker.UsedBefore + p_marker.Used ) );
+
+	if ( p_arena->Reserved ) {
+		if ( p_marker.Used < p_arena->Used ) {
+			ArenaDecommit( p_arena, p_marker.Used );
+		}
+		return;
+	}
+
+	if ( p_marker.Block == p_arena->Current ) {
+		if ( p_marker.Used < p_arena->Used ) {
+			ArenaZero( p_arena, (char *)p_arena->Raw + p_marker.Used, p_arena->Used - p_marker.Used );
+			p_arena->Used = p_marker.Used;
+		}
+		return;
+	}
+
+	// The blocks entered after the marker was taken become spare blocks again
+	ArenaZero( p_arena, p_arena->Raw, p_arena->Used );
+	p_arena->Spare += p_arena->Capacity;
+	for ( MemoryArenaBlock * block = p_marker.Block->Next; block != p_arena->Current; block = block->Next ) {
+		ArenaZero( p_arena, block + 1, block->Used );
+		block->Used = 0;
+		p_arena->Spare += block->Capacity;
+	}
+	p_arena->Current->Used = 0;
+
+	MemoryArenaBlock * marked = p_marker.Block;
+	ArenaZero( p_arena, (char *)(marked + 1) + p_marker.Used, marked->Used - p_marker.Used );
+	ArenaEnter( p_arena, marked );
+	p_arena->Used = p_marker.Used;
+	p_arena->UsedBefore = p_marker.UsedBefore;
+}
+
+void ArenaReset( MemoryArena * p_arena ) {
+	if ( !p_arena->First ) {
+		return;
+	}
+	STATS( p_arena->Stats.Counters.Resets++ );
+	PROFILE( ProfileForget( p_arena->Profile, 0 ) );
+
+	if ( p_arena->Reserved ) {
+		ArenaDecommit( p_arena, 0 );
+		return;
+	}
+
+	p_arena->Current->Used = p_arena->Used;
+
+	// Every block holds its high-water mark, bytes above it are untouched or were zeroed on rewind
+	MemoryArenaBlock * block = p_arena->First;
+	size_t retained = 0;
+	p_arena->Spare = 0;
+	while ( block->Next ) {
+		MemoryArenaBlock * next = block->Next;
+		if ( retained >= p_arena->Retain ) {
+			block->Next = next->Next;
+			ArenaBlockRelease( p_arena, next );
+			continue;
+		}
+		ArenaZero( p_arena, next + 1, next->Used );
+		next->Used = 0;
+		p_arena->Spare += next->Capacity;
+		retained++;
+		block = next;
+	}
+
+	ArenaZero( p_arena, p_arena->First + 1, p_arena->First->Used );
+
+	p_arena->First->Used = 0;
+	p_arena->UsedBefore = 0;
+	ArenaEnter( p_arena, p_arena->First );
+}
+
+/// @brief Header in front of every stack allocation, it restores the end the allocation was taken from
+typedef struct {
+	/// @brief Number of bytes used from the end before the allocation
+	size_t Used;
+	/// @brief Offset of the allocation made before from the same end
+	size_t Top;
+} MemoryStackHeader;
+
+MemoryStack StackCreate( size_t const p_capacity ) {
+	return StackCreateEx( p_capacity, NULL, NULL );
+}
+
+MemoryStack StackCreateEx( size_t const p_capacity, AllocateFct const p_allocate_fct, ReleaseFct const p_release_fct ) {
+	// Headers are stored in place, so the block and its capacity are kept to multiples of the header size
+	size_t capacity = p_capacity & ~(size_t)(MMEM_STACK_ALIGNMENT - 1);
+	void * base = NULL;
+	void * raw = NULL;
+	if ( p_allocate_fct ) {
+		// Foreign allocators know no alignment, ask for enough memory to align the block inside
+		base = p_allocate_fct( capacity + MMEM_STACK_ALIGNMENT, 1 );
+		raw = base ? (void *)AlignAddress( (uintptr_t)base, MMEM_STACK_ALIGNMENT ) : NULL;
+	} else {
+		base = AllocateBlock( capacity, MMEM_STACK_ALIGNMENT, MMEM_ZERO_POLICY == MMEM_ZERO_POLICY_ONRELEASE );
+		raw = base;
+	}
+
+	MemoryStack stack = {
+		.Raw = raw,
+		.Capacity = raw ? capacity : 0,
+		.Front = 0,
+		.Back = 0,
+		.FrontTop = 0,
+		.BackTop = 0,
+		.Base = base,
+		.Release = p_release_fct ? p_release_fct : free,
+		.ZeroPolicy = MMEM_ZERO_POLICY
+	};
+	return stack;
+}
+
+void StackDestroy( MemoryStack * p_stack ) {
+	bool zero = p_stack->ZeroPolicy == MMEM_ZERO_POLICY_ONRELEASE;
+	if ( p_stack->Base ) {
+		p_stack->Release( p_stack->Base );
+	}
+
+	if ( zero ) {
+		memset( p_stack, 0x00, sizeof( MemoryStack ) );
+	}
+}
+
+void * StackPushFront( MemoryStack * p_stack, size_t const p_size ) {
+	return StackPushFrontAligned( p_stack, p_size, MMEM_STACK_ALIGNMENT );
+}
+
+void * StackPushFrontAligned( MemoryStack * p_stack, size_t const p_size, size_t const p_alignment ) {
+	size_t alignment = p_alignment > MMEM_STACK_ALIGNMENT ? p_alignment : MMEM_STACK_ALIGNMENT;
+	size_t limit = p_stack->Capacity - p_stack->Back;
+	uintptr_t raw = (uintptr_t)p_stack->Raw;
+	size_t offset = (size_t)(AlignAddress( raw + p_stack->Front + sizeof( MemoryStackHeader ), alignment ) - raw);
+	if ( offset > limit || p_size > limit - offset ) {
+		return NULL;
+	}
+
+	MemoryStackHeader * header = (MemoryStackHeader *)(raw + offset) - 1;
+	header->Used = p_stack->Front;
+	header->Top = p_stack->FrontTop;
+
+	void * ptr = header + 1;
+	ZeroOnAllocateAs( p_stack->ZeroPolicy, ptr, p_size );
+	p_stack->Front = offset + p_size;
+	p_stack->FrontTop = offset;
+	return ptr;
+}
+
+void * StackPushBack( MemoryStack * p_stack, size_t const p_size ) {
+	return StackPushBackAligned( p_stack, p_size, MMEM_STACK_ALIGNMENT );
+}
+
+void * StackPushBackAligned( MemoryStack * p_stack, size_t const p_size, size_t const p_alignment ) {
+	size_t alignment = p_alignment > MMEM_STACK_ALIGNMENT ? p_alignment : MMEM_STACK_ALIGNMENT;
+	size_t limit = p_stack->Capacity - p_stack->Back;
+	uintptr_t raw = (uintptr_t)p_stack->Raw;
+	if ( p_size > limit - p_stack->Front ) {
+		return NULL;
+	}
+
+	// The top end grows downwards, its objects are aligned by rounding their address down
+	uintptr_t address = (raw + limit - p_size) & ~(uintptr_t)(alignment - 1);
+	if ( address < raw + p_stack->Front + sizeof( MemoryStackHeader ) ) {
+		return NULL;
+	}
+
+	size_t offset = (size_t)(address - raw);
+	MemoryStackHeader * header = (MemoryStackHeader *)address - 1;
+	header->Used = p_stack->Back;
+	header->Top = p_stack->BackTop;
+
+	void * ptr = header + 1;
+	ZeroOnAllocateAs( p_stack->ZeroPolicy, ptr, p_size );
+	p_stack->Back = p_stack->Capacity - (offset - sizeof( MemoryStackHeader ));
+	p_stack->BackTop = offset;
+	return ptr;
+}
+
+void StackPopFront( MemoryStack * p_stack ) {
+	if ( !p_stack->FrontTop ) {
+		return;
+	}
+
+	MemoryStackHeader header = ((MemoryStackHeader *)((char *)p_stack->Raw + p_stack->FrontTop))[-1];
+	ZeroOnReleaseAs( p_stack->ZeroPolicy, (char *)p_stack->Raw + header.Used, p_stack->Front - header.Used );
+	p_stack->Front = header.Used;
+	p_stack->FrontTop = header.Top;
+}
+
+void StackPopBack( MemoryStack * p_stack ) {
+	if ( !p_stack->BackTop ) {
+		return;
+	}
+
+	MemoryStackHeader header = ((MemoryStackHeader *)((char *)p_stack->Raw + p_stack->BackTop))[-1];
+	ZeroOnReleaseAs( p_stack->ZeroPolicy, (char *)p_stack->Raw + p_stack->Capacity - p_stack->Back, p_stack->Back - header.Used );
+	p_stack->Back = header.Used;
+	p_stack->BackTop = header.Top;
+}
+
+void * StackResizeFront( MemoryStack * p_stack, size_t const p_size ) {
+	size_t top = p_stack->FrontTop;
+	if ( !top || p_size > p_stack->Capacity - p_stack->Back - top ) {
+		return NULL;
+	}
+
+	char * ptr = (char *)p_stack->Raw + top;
+	size_t used = top + p_size;
+	if ( used > p_stack->Front ) {
+		ZeroOnAllocateAs( p_stack->ZeroPolicy, (char *)p_stack->Raw + p_stack->Front, used - p_stack->Front );
+	} else {
+		ZeroOnReleaseAs( p_stack->ZeroPolicy, (char *)p_stack->Raw + used, p_stack->Front - used );
+	}
+	p_stack->Front = used;
+	return ptr;
+}
+
+void StackReset( MemoryStack * p_stack ) {
+	StackRewindFront( p_stack, (MemoryStackMarker) { 0 } );
+	StackRewindBack( p_stack, (MemoryStackMarker) { 0 } );
+}
+
+void StackRewindFront( MemoryStack * p_stack, MemoryStackMarker const p_marker ) {
+	if ( p_marker.Used >= p_stack->Front ) {
+		return;
+	}
+
+	ZeroOnReleaseAs( p_stack->ZeroPolicy, (char *)p_stack->Raw + p_marker.Used, p_stack->Front - p_marker.Used );
+	p_stack->Front = p_marker.Used;
+	p_stack->FrontTop = p_marker.Top;
+}
+
+void StackRewindBack( MemoryStack * p_stack, MemoryStackMarker const p_marker ) {
+	if ( p_marker.Used >= p_stack->Back ) {
+		return;
+	}
+
+	ZeroOnReleaseAs( p_stack->ZeroPolicy, (char *)p_stack->Raw + p_stack->Capacity - p_stack->Back, p_stack->Back - p_marker.Used );
+	p_stack->Back = p_marker.Used;
+	p_stack->BackTop = p_marker.Top;
+}
+
+MemoryFrameArena FrameArenaCreate( size_t const p_count, size_t const p_capacity ) {
+	return FrameArenaCreateOpt( p_count, p_capacity, NULL );
+}
+
+MemoryFrameArena FrameArenaCreateOpt( size_t const p_count, size_t const p_capacity, MemoryArenaOptions const * p_options ) {
+	MemoryFrameArena frames = {
+		.Frames = NULL,
+		.Count = 0,
+		.Frame = 0,
+		.Current = NULL,
+		.Stats = { 0 },
+		.Retired = 0
+	};
+	if ( !p_count || p_count > SIZE_MAX / sizeof( MemoryArena ) ) {
+		return frames;
+	}
+
+	MemoryArena * arenas = AllocateAligned( p_count * sizeof( MemoryArena ), MMEM_ALIGNMENT_CACHELINE, false );
+	if ( !arenas ) {
+		return frames;
+	}
+	for ( size_t i = 0; i < p_count; ++i ) {
+		arenas[i] = ArenaCreateOpt( p_capacity, p_options );
+		if ( !arenas[i].First ) {
+			while ( i-- ) {
+				ArenaDestroy( &arenas[i] );
+			}
+			ReleaseAligned( arenas );
+			return frames;
+		}
+	}
+
+	frames.Frames = arenas;
+	frames.Count = p_count;
+	return frames;
+}
+
+void FrameArenaDestroy( MemoryFrameArena * p_frames ) {
+	for ( size_t i = 0; i < p_frames->Count; ++i ) {
+		ArenaDestroy( &p_frames->Frames[i] );
+	}
+	ReleaseAligned( p_frames->Frames );
+
+	p_frames->Frames = NULL;
+	p_frames->Count = 0;
+	p_frames->Current = NULL;
+}
+
+bool FrameBegin( MemoryFrameArena * p_frames ) {
+	if ( p_frames->Current || !p_frames->Count ) {
+		return false;
+	}
+
+	// Frame n reuses the sub-arena of frame n - Count, the acquiring load orders the reset after the reads of the consumers
+	uint64_t frame = p_frames->Frame;
+	if ( frame >= p_frames->Count && MMEM_ATOMIC_LOAD( &p_frames->Retired ) <= frame - p_frames->Count ) {
+		p_frames->Stats.Stalls++;
+		return false;
+	}
+
+	MemoryArena * arena = &p_frames->Frames[(size_t)(frame % p_frames->Count)];
+	ArenaReset( arena );
+	p_frames->Current = arena;
+	return true;
+}
+
+uint64_t FrameEnd( MemoryFrameArena * p_frames ) {
+	if ( !p_frames->Current ) {
+		return UINT64_MAX;
+	}
+
+	uint64_t used = ArenaBytesInUse( p_frames->Current );
+	MemoryFrameStats * stats = &p_frames->Stats;
+	stats->Frames++;
+	stats->Last = used;
+	stats->Total += used;
+	if ( used > stats->Peak ) {
+		stats->Peak = used;
+	}
+
+	p_frames->Current = NULL;
+	return p_frames->Frame++;
+}
+
+void FrameRetire( MemoryFrameArena * p_frames, uint64_t const p_frame ) {
+	if ( p_frame == UINT64_MAX ) {
+		return;
+	}
+
+	uint64_t retired = MMEM_ATOMIC_LOAD( &p_frames->Retired );
+	while ( retired <= p_frame && !MMEM_ATOMIC_CAS( &p_frames->Retired, &retired, p_frame + 1 ) ) {
+		MMEM_ATOMIC_PAUSE();
+	}
+}
+
+#if MMEM_STATS
+/// @brief Most recently registered instance, guarded by StatsLock
+static MemoryStats * StatsHead = NULL;
+static uint64_t StatsLock = 0;
+
+static void StatsLockAcquire( void ) {
+	while ( MMEM_ATOMIC_EXCHANGE( &StatsLock, 1 ) ) {
+		MMEM_ATOMIC_PAUSE();
+	}
+}
+
+static void StatsLockRelease( void ) {
+	MMEM_ATOMIC_STORE( &StatsLock, 0 );
+}
+
+/// @brief Tells if the statistics are linked into the registry by the instance that embeds them, not by a copy of it
+static inline bool StatsLinked( MemoryStats const * p_stats ) {
+	switch ( p_stats->Kind ) {
+	case MMEM_STATS_POOL:
+		return p_stats->Owner && &((MemoryPool *)p_stats->Owner)->Stats == p_stats;
+	case MMEM_STATS_ARENA:
+		return p_stats->Owner && &((MemoryArena *)p_stats->Owner)->Stats == p_stats;
+	default:
+		return false;
+	}
+}
+
+static void StatsRegister( MemoryStats * p_stats, void * p_owner, unsigned int const p_kind, char const * p_name ) {
+	StatsLockAcquire();
+	if ( !StatsLinked( p_stats ) ) {
+		p_stats->Kind = p_kind;
+		p_stats->Owner = p_owner;
+		p_stats->Prev = NULL;
+		p_stats->Next = StatsHead;
+		if ( StatsHead ) {
+			StatsHead->Prev = p_stats;
+		}
+		StatsHead = p_stats;
+	}
+	p_stats->Name = p_name;
+	StatsLockRelease();
+}
+
+void StatsRegisterPool( MemoryPool * p_pool, char const * p_name ) {
+	StatsRegister( &p_pool->Stats, p_pool, MMEM_STATS_POOL, p_name );
+}
+
+void StatsRegisterArena( MemoryArena * p_arena, char const * p_name ) {
+	StatsRegister( &p_arena->Stats, p_arena, MMEM_STATS_ARENA, p_name );
+}
+
+void StatsUnregister( MemoryStats * p_stats ) {
+	StatsLockAcquire();
+	if ( StatsLinked( p_stats ) ) {
+		if ( p_stats->Prev ) {
+			p_stats->Prev->Next = p_stats->Next;
+		} else {
+			StatsHead = p_stats->Next;
+		}
+		if ( p_stats->Next ) {
+			p_stats->Next->Prev = p_stats->Prev;
+		}
+		p_stats->Name = NULL;
+		p_stats->Owner = NULL;
+		p_stats->Prev = NULL;
+		p_stats->Next = NULL;
+	}
+	StatsLockRelease();
+}
+
+static MemoryStatsSnapshot StatsTake( MemoryStats const * p_stats ) {
+	MemoryStatsSnapshot snapshot = {
+		.Name = p_stats->Name,
+		.Kind = p_stats->Kind,
+		.Counters = p_stats->Counters,
+		.InUse = 0,
+		.Capacity = 0
+	};
+	if ( p_stats->Kind == MMEM_STATS_POOL ) {
+		MemoryPool * pool = p_stats->Owner;
+		snapshot.InUse = PoolSlotsInUse( pool );
+		snapshot.Capacity = pool->Capacity;
+	} else {
+		MemoryArena * arena = p_stats->Owner;
+		snapshot.InUse = ArenaBytesInUse( arena );
+		snapshot.Capacity = snapshot.InUse + ArenaBytesAvailable( arena );
+	}
+	return snapshot;
+}
+
+size_t StatsSnapshot( MemoryStatsSnapshot * p_snapshots, size_t const p_capacity ) {
+	size_t count = 0;
+	StatsLockAcquire();
+	for ( MemoryStats const * stats = StatsHead; stats; stats = stats->Next ) {
+		if ( p_snapshots && count < p_capacity ) {
+			p_snapshots[count] = StatsTake( stats );
+		}
+		count++;
+	}
+	StatsLockRelease();
+	return count;
+}
+
+/// @brief Output of StatsDump, Length keeps counting once the buffer is full
+typedef struct {
+	char * Buffer;
+	size_t Size;
+	size_t Length;
+} StatsOutput;
+
+static void StatsPrint( StatsOutput * p_output, char const * p_format, ... ) {
+	size_t left = p_output->Length < p_output->Size ? p_output->Size - p_output->Length : 0;
+	va_list args;
+	va_start( args, p_format );
+	int written = vsnprintf( left ? p_output->Buffer + p_output->Length : NULL, left, p_format, args );
+	va_end( args );
+	if ( written > 0 ) {
+		p_output->Length += (size_t)written;
+	}
+}
+
+static void StatsPrintString( StatsOutput * p_output, char const * p_string ) {
+	StatsPrint( p_output, "\"" );
+	for ( unsigned char const * c = (unsigned char const *)p_string; c && *c; ++c ) {
+		if ( *c == '"' || *c == '\\' ) {
+			StatsPrint( p_output, "\\%c", *c );
+		} else if ( *c < 0x20 ) {
+			StatsPrint( p_output, "\\u%04x", (unsigned int)*c );
+		} else {
+			StatsPrint( p_output, "%c", *c );
+		}
+	}
+	StatsPrint( p_output, "\"" );
+}
+
+size_t StatsDump( char * p_buffer, size_t const p_size ) {
+	StatsOutput output = { .Buffer = p_buffer, .Size = p_size, .Length = 0 };
+	if ( p_size ) {
+		p_buffer[0] = '\0';
+	}
+
+	StatsLockAcquire();
+	StatsPrint( &output, "[" );
+	for ( MemoryStats const * stats = StatsHead; stats; stats = stats->Next ) {
+		MemoryStatsSnapshot snapshot = StatsTake( stats );
+		MemoryCounters const * counters = &snapshot.Counters;
+
+		StatsPrint( &output, "%s\n\t{ \"name\": ", stats == StatsHead ? "" : "," );
+		StatsPrintString( &output, snapshot.Name );
+		StatsPrint( &output, ", \"kind\": \"%s\", \"in_use\": %llu, \"capacity\": %llu", snapshot.Kind == MMEM_STATS_POOL ? "pool" : "arena",
+			(unsigned long long)snapshot.InUse, (unsigned long long)snapshot.Capacity );
+		StatsPrint( &output, ", \"allocations\": %llu, \"releases\": %llu, \"failures\": %llu, \"resets\": %llu, \"grows\": %llu, \"peak\": %llu, \"bytes_zeroed\": %llu",
+			(unsigned long long)counters->Allocations, (unsigned long long)counters->Releases, (unsigned long long)counters->Failures,
+			(unsigned long long)counters->Resets, (unsigned long long)counters->Grows, (unsigned long long)counters->Peak,
+			(unsigned long long)counters->BytesZeroed );
+		StatsPrint( &output, ", \"scans\": [" );
+		for ( size_t bucket = 0; bucket < MMEM_STATS_SCAN_BUCKETS; ++bucket ) {
+			StatsPrint( &output, "%s%llu", bucket ? ", " : "", (unsigned long long)counters->Scans[bucket] );
+		}
+		StatsPrint( &output, "] }" );
+	}
+	StatsPrint( &output, "%s]\n", StatsHead ? "\n" : "" );
+	StatsLockRelease();
+	return output.Length;
+}
+#endif
+
+#if MMEM_PROFILE
+/// @brief Most recently profiled instance, guarded by ProfileLock
+static MemoryProfile * ProfileHead = NULL;
+static uint64_t ProfileLock = 0;
+/// @brief Mean sampling interval in bytes
+static uint64_t ProfileRate = MMEM_PROFILE_RATE;
+/// @brief Non-zero while a signal requested a report that its handler could not write
+static uint64_t ProfilePending = 0;
+static char const * ProfileSignalPath = NULL;
+static unsigned int ProfileSignalFormat = MMEM_PROFILE_LIVE;
+
+#define MMEM_PROFILE_GOLDEN 0x9E3779B97F4A7C15ull
+#if defined( __GNUC__ ) || defined( __clang__ )
+#define MMEM_RETURN_ADDRESS() __builtin_return_address( 0 )
+#else
+#define MMEM_RETURN_ADDRESS() NULL
+#endif
+/// @brief Number of entries of a new sample table (power of two)
+#define MMEM_PROFILE_TABLE 64
+/// @brief Number of bytes staged before a report is written to a file
+#define MMEM_PROFILE_STAGE 4096
+
+static void ProfileLockAcquire( void ) {
+	while ( MMEM_ATOMIC_EXCHANGE( &ProfileLock, 1 ) ) {
+		MMEM_ATOMIC_PAUSE();
+	}
+}
+
+static void ProfileLockRelease( void ) {
+	MMEM_ATOMIC_STORE( &ProfileLock, 0 );
+}
+
+void ProfileSetRate( size_t const p_rate ) {
+	MMEM_ATOMIC_STORE( &ProfileRate, (uint64_t)( p_rate ? p_rate : 1 ) );
+}
+
+/**
+ * @brief Draws the next sampling interval from a geometric distribution with a mean of rate - 1 bytes
+ * @details The distribution is memoryless, every allocation of size bytes is sampled with the probability
+ * 1 - (1 - 1 / rate)^size no matter what was allocated before it, which ProfileWeight undoes.
+ */
+static int64_t ProfileInterval( MemoryProfile * p_profile ) {
+	uint64_t rate = MMEM_ATOMIC_LOAD( &ProfileRate );
+	uint64_t x = p_profile->Random;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	p_profile->Random = x;
+	if ( rate <= 1 ) {
+		return 0;
+	}
+	// Uniform in (0, 1], so the logarithm is finite
+	double uniform = (double)( ( ( x * 0x2545F4914F6CDD1Dull ) >> 11 ) + 1 ) * 0x1.0p-53;
+	double interval = floor( log( uniform ) / log1p( -1.0 / (double)rate ) );
+	return interval < (double)INT64_MAX ? (int64_t)interval : INT64_MAX;
+}
+
+/// @brief Estimated number of bytes a sample stands for, its size divided by the probability it was sampled with
+static uint64_t ProfileWeight( size_t const p_size, uint64_t const p_rate ) {
+	if ( p_rate <= 1 || !p_size ) {
+		return p_size;
+	}
+	double probability = -expm1( (double)p_size * log1p( -1.0 / (double)p_rate ) );
+	return (uint64_t)( (double)p_size / probability + 0.5 );
+}
+
+static inline size_t ProfileSlot( void const * p_address, size_t const p_mask ) {
+	return (size_t)( ( (uint64_t)(uintptr_t)p_address * MMEM_PROFILE_GOLDEN ) >> 32 ) & p_mask;
+}
+
+/// @brief Adds the bytes of a sample to the live bytes of its site, or takes them off again
+static void ProfileAccount( MemoryProfileSample const * p_sample, bool const p_live ) {
+	MemoryProfileSite * site = p_sample->Site;
+	if ( p_live ) {
+		site->LiveSamples++;
+		site->LiveSampledBytes += p_sample->Size;
+		site->Live += p_sample->Weight;
+		if ( site->Live > site->Peak ) {
+			site->Peak = site->Live;
+		}
+		return;
+	}
+	site->LiveSamples--;
+	site->LiveSampledBytes -= p_sample->Size;
+	site->Live -= p_sample->Weight;
+}
+
+/// @brief Frees the entry of a sample, later entries of the probe run move up
+static void ProfileUnlink( MemoryProfile * p_profile, size_t p_index ) {
+	MemoryProfileSample * samples = p_profile->Samples;
+	size_t mask = p_profile->Capacity - 1;
+	p_profile->Count--;
+
+	// Backward shift deletion keeps every entry reachable from its home slot without tombstones
+	size_t next = ( p_index + 1 ) & mask;
+	while ( samples[next].Address ) {
+		size_t home = ProfileSlot( samples[next].Address, mask );
+		if ( ( ( next - home ) & mask ) >= ( ( next - p_index ) & mask ) ) {
+			samples[p_index] = samples[next];
+			p_index = next;
+		}
+		next = ( next + 1 ) & mask;
+	}
+	samples[p_index].Address = NULL;
+}
+
+static inline size_t ProfileFind( MemoryProfile const * p_profile, void const * p_address ) {
+	// Most released objects lie outside the bounds of the live samples and skip the table
+	if ( (uintptr_t)p_address < (uintptr_t)p_profile->Low || (uintptr_t)p_address > (uintptr_t)p_profile->High ) {
+		return SIZE_MAX;
+	}
+	size_t mask = p_profile->Capacity - 1;
+	for ( size_t index = ProfileSlot( p_address, mask ); p_profile->Samples[index].Address; index = ( index + 1 ) & mask ) {
+		if ( p_profile->Samples[index].Address == p_address ) {
+			return index;
+		}
+	}
+	return SIZE_MAX;
+}
+
+static void ProfilePlace( MemoryProfileSample * p_samples, size_t const p_mask, MemoryProfileSample const * p_sample ) {
+	size_t index = ProfileSlot( p_sample->Address, p_mask );
+	while ( p_samples[index].Address ) {
+		index = ( index + 1 ) & p_mask;
+	}
+	p_samples[index] = *p_sample;
+}
+
+static bool ProfileInsert( MemoryProfile * p_profile, MemoryProfileSample const * p_sample ) {
+	// Keep the table at most half full, so probe runs stay short
+	if ( ( p_profile->Count + 1 ) * 2 > p_profile->Capacity ) {
+		size_t capacity = p_profile->Capacity ? p_profile->Capacity * 2 : MMEM_PROFILE_TABLE;
+		MemoryProfileSample * samples = calloc( capacity, sizeof( MemoryProfileSample ) );
+		if ( !samples ) {
+			return false;
+		}
+		for ( size_t index = 0; index < p_profile->Capacity; ++index ) {
+			if ( p_profile->Samples[index].Address ) {
+				ProfilePlace( samples, capacity - 1, &p_profile->Samples[index] );
+			}
+		}
+		free( p_profile->Samples );
+		p_profile->Samples = samples;
+		p_profile->Capacity = capacity;
+	}
+
+	ProfilePlace( p_profile->Samples, p_profile->Capacity - 1, p_sample );
+	if ( !p_profile->Count++ ) {
+		p_profile->Low = p_sample->Address;
+		p_profile->High = p_sample->Address;
+	} else if ( (uintptr_t)p_sample->Address < (uintptr_t)p_profile->Low ) {
+		p_profile->Low = p_sample->Address;
+	} else if ( (uintptr_t)p_sample->Address > (uintptr_t)p_profile->High ) {
+		p_profile->High = p_sample->Address;
+	}
+	return true;
+}
+
+/// @brief Drops every live sample at or above the given arena position, every sample for position 0
+static void ProfileForget( MemoryProfile * p_profile, uint64_t const p_position ) {
+	if ( !p_profile || !p_profile->Count ) {
+		return;
+	}
+
+	// A removal only moves entries of the scanned position or entries already kept, so the position is checked again
+	size_t index = 0;
+	while ( index < p_profile->Capacity ) {
+		MemoryProfileSample const * sample = &p_profile->Samples[index];
+		if ( sample->Address && sample->Position >= p_position ) {
+			ProfileAccount( sample, false );
+			ProfileUnlink( p_profile, index );
+			continue;
+		}
+		index++;
+	}
+}
+
+/// @brief Follows a sampled pool object moved by compaction
+static void ProfileMove( MemoryProfile * p_profile, void * p_from, void * p_to ) {
+	if ( !p_profile || !p_profile->Count ) {
+		return;
+	}
+
+	size_t index = ProfileFind( p_profile, p_from );
+	if ( index == SIZE_MAX ) {
+		return;
+	}
+	// The table keeps its capacity, so inserting the moved sample again never fails
+	MemoryProfileSample sample = p_profile->Samples[index];
+	ProfileUnlink( p_profile, index );
+	sample.Address = p_to;
+	ProfileInsert( p_profile, &sample );
+}
+
+/// @brief Finds or claims the site of the call stack, NULL once every site is taken by other stacks
+static MemoryProfileSite * ProfileSiteOf( MemoryProfile * p_profile, void * const * p_frames, size_t const p_depth ) {
+	uint64_t hash = p_depth;
+	for ( size_t i = 0; i < p_depth; ++i ) {
+		hash = ( hash ^ (uint64_t)(uintptr_t)p_frames[i] ) * MMEM_PROFILE_GOLDEN;
+	}
+	hash ^= hash >> 29;
+
+	size_t mask = MMEM_PROFILE_SITES - 1;
+	size_t index = (size_t)hash & mask;
+	for ( size_t probe = 0; probe < MMEM_PROFILE_SITES; ++probe, index = ( index + 1 ) & mask ) {
+		MemoryProfileSite * site = &p_profile->Sites[index];
+		if ( !site->Depth ) {
+			// Reports read sites without the owner, so the depth publishes the site once its frames are written
+			memcpy( site->Frames, p_frames, p_depth * sizeof( void * ) );
+			site->Hash = hash;
+			site->Depth = p_depth;
+			return site;
+		}
+		if ( site->Hash == hash && site->Depth == p_depth && !memcmp( site->Frames, p_frames, p_depth * sizeof( void * ) ) ) {
+			return site;
+		}
+	}
+	return NULL;
+}
+
+static void ProfileWriteFile( char const * path, unsigned int const format );
+
+/// @brief Records a sampled allocation, called by the profiling routines whose frames are skipped
+static MMEM_NOINLINE void ProfileSample( MemoryProfile * p_profile, void * p_address, size_t const p_size, uint64_t const p_position, void * p_caller ) {
+	uint64_t rate = MMEM_ATOMIC_LOAD( &ProfileRate );
+	p_profile->Countdown = ProfileInterval( p_profile );
+
+	void * frames[MMEM_PROFILE_DEPTH + 2];
+	size_t depth = 0;
+#if MMEM_BACKTRACE
+	int captured = backtrace( frames, MMEM_PROFILE_DEPTH + 2 );
+	depth = captured > 2 ? (size_t)captured - 2 : 0;
+	memmove( frames, frames + 2, depth * sizeof( void * ) );
+#elif defined( _WIN32 )
+	depth = (size_t)CaptureStackBackTrace( 2, MMEM_PROFILE_DEPTH, frames, NULL );
+#endif
+	if ( !depth ) {
+		// Only the caller of the profiling routine is known without unwinding
+		frames[0] = p_caller;
+		depth = 1;
+	}
+
+	MemoryProfileSite * site = ProfileSiteOf( p_profile, frames, depth );
+	if ( !site ) {
+		p_profile->Dropped++;
+		return;
+	}
+
+	// An address still sampled was released unnoticed, such as a rewound arena reused at a different position
+	size_t stale = p_profile->Count ? ProfileFind( p_profile, p_address ) : SIZE_MAX;
+	if ( stale != SIZE_MAX ) {
+		ProfileAccount( &p_profile->Samples[stale], false );
+		ProfileUnlink( p_profile, stale );
+	}
+
+	MemoryProfileSample sample = {
+		.Address = p_address,
+		.Position = p_position,
+		.Size = p_size,
+		.Weight = ProfileWeight( p_size, rate ),
+		.Site = site
+	};
+	site->Samples++;
+	site->SampledBytes += sample.Size;
+	site->Allocated += sample.Weight;
+	if ( ProfileInsert( p_profile, &sample ) ) {
+		ProfileAccount( &sample, true );
+	} else {
+		p_profile->Dropped++;
+	}
+
+	if ( MMEM_ATOMIC_LOAD( &ProfilePending ) && MMEM_ATOMIC_EXCHANGE( &ProfilePending, 0 ) ) {
+		ProfileWriteFile( ProfileSignalPath, ProfileSignalFormat );
+	}
+}
+
+/// @brief Counts an allocation of a profiled pool down to the next sample
+static inline void * ProfilePoolAllocated( MemoryPool * p_pool, void * p_element, void * p_caller ) {
+	MemoryProfile * profile = p_pool->Profile;
+	if ( p_element ) {
+		profile->Countdown -= (int64_t)p_pool->ElementSize;
+		if ( profile->Countdown < 0 ) {
+			ProfileSample( profile, p_element, p_pool->ElementSize, 0, p_caller );
+		}
+	}
+	return p_element;
+}
+
+/// @brief Drops the sample of an object about to be released by a profiled pool
+static inline void ProfilePoolReleasing( MemoryPool * p_pool, void * p_element ) {
+	MemoryProfile * profile = p_pool->Profile;
+	if ( profile->Count ) {
+		size_t index = ProfileFind( profile, p_element );
+		if ( index != SIZE_MAX ) {
+			ProfileAccount( &profile->Samples[index], false );
+			ProfileUnlink( profile, index );
+		}
+	}
+}
+
+/// @brief Counts an allocation of a profiled arena down to the next sample
+static inline void * ProfileArenaAllocated( MemoryArena * p_arena, void * p_memory, size_t const p_size, void * p_caller ) {
+	MemoryProfile * profile = p_arena->Profile;
+	if ( p_memory ) {
+		profile->Countdown -= (int64_t)p_size;
+		if ( profile->Countdown < 0 ) {
+			// The last byte of the allocation lies at or above every marker taken before it, and below every later one
+			uint64_t position = ArenaBytesInUse( p_arena ) - ( p_size ? 1 : 0 );
+			ProfileSample( profile, p_memory, p_size, position, p_caller );
+		}
+	}
+	return p_memory;
+}
+
+// Profiling routines specialized like the routines they stand in for, so profiling adds no further indirect call
+#define MMEM_PROFILE_POOL_ROUTINES( mode, policy, zero ) \
+	static void * ProfilePoolAllocate##mode##policy( MemoryPool * p_pool ) { \
+		return ProfilePoolAllocated( p_pool, PoolAllocate##mode##As( p_pool, zero ), MMEM_RETURN_ADDRESS() ); \
+	} \
+	static void ProfilePoolRelease##mode##policy( MemoryPool * p_pool, void * p_element ) { \
+		ProfilePoolReleasing( p_pool, p_element ); \
+		PoolRelease##mode##As( p_pool, p_element, zero ); \
+	}
+
+MMEM_PROFILE_POOL_ROUTINES( Bitmap, OnAllocate, MMEM_ZERO_POLICY_ONALLOCATE )
+MMEM_PROFILE_POOL_ROUTINES( Bitmap, OnRelease, MMEM_ZERO_POLICY_ONRELEASE )
+MMEM_PROFILE_POOL_ROUTINES( Bitmap, Manual, MMEM_ZERO_POLICY_MANUAL )
+MMEM_PROFILE_POOL_ROUTINES( FreeList, OnAllocate, MMEM_ZERO_POLICY_ONALLOCATE )
+MMEM_PROFILE_POOL_ROUTINES( FreeList, OnRelease, MMEM_ZERO_POLICY_ONRELEASE )
+MMEM_PROFILE_POOL_ROUTINES( FreeList, Manual, MMEM_ZERO_POLICY_MANUAL )
+
+#undef MMEM_PROFILE_POOL_ROUTINES
+
+#define MMEM_PROFILE_ARENA_ROUTINES( policy, zero ) \
+	static void * ProfileArenaAllocate##policy( MemoryArena * p_arena, size_t p_size ) { \
+		return ProfileArenaAllocated( p_arena, ArenaAllocateAs( p_arena, p_size, zero ), p_size, MMEM_RETURN_ADDRESS() ); \
+	} \
+	static void * ProfileArenaAllocateAligned##policy( MemoryArena * p_arena, size_t p_size, size_t p_alignment ) { \
+		return ProfileArenaAllocated( p_arena, ArenaAllocateAlignedAs( p_arena, p_size, p_alignment, zero ), p_size, MMEM_RETURN_ADDRESS() ); \
+	}
+
+MMEM_PROFILE_ARENA_ROUTINES( Zeroing, MMEM_ZERO_POLICY_ONALLOCATE )
+MMEM_PROFILE_ARENA_ROUTINES( Plain, MMEM_ZERO_POLICY_MANUAL )
+
+#undef MMEM_PROFILE_ARENA_ROUTINES
+
+static MemoryProfile * ProfileCreate( char const * p_name ) {
+	MemoryProfile * profile = calloc( 1, sizeof( MemoryProfile ) );
+	if ( !profile ) {
+		return NULL;
+	}
+	profile->Sites = calloc( MMEM_PROFILE_SITES, sizeof( MemoryProfileSite ) );
+	if ( !profile->Sites ) {
+		free( profile );
+		return NULL;
+	}
+
+	profile->Name = p_name;
+	profile->Random = ( (uint64_t)(uintptr_t)profile * MMEM_PROFILE_GOLDEN ) | 1;
+	profile->Countdown = ProfileInterval( profile );
+
+	ProfileLockAcquire();
+	profile->Next = ProfileHead;
+	if ( ProfileHead ) {
+		ProfileHead->Prev = profile;
+	}
+	ProfileHead = profile;
+	ProfileLockRelease();
+	return profile;
+}
+
+static void ProfileDestroy( MemoryProfile * p_profile ) {
+	ProfileLockAcquire();
+	if ( p_profile->Prev ) {
+		p_profile->Prev->Next = p_profile->Next;
+	} else {
+		ProfileHead = p_profile->Next;
+	}
+	if ( p_profile->Next ) {
+		p_profile->Next->Prev = p_profile->Prev;
+	}
+	ProfileLockRelease();
+
+	free( p_profile->Samples );
+	free( p_profile->Sites );
+	free( p_profile );
+}
+
+bool ProfilePool( MemoryPool * p_pool, char const * p_name ) {
+	// Indexed by mode and zero policy, like the routines of PoolBind
+	static void * (* const allocate[2][3])( MemoryPool * ) = {
+		{ ProfilePoolAllocateBitmapOnAllocate, ProfilePoolAllocateBitmapOnRelease, ProfilePoolAllocateBitmapManual },
+		{ ProfilePoolAllocateFreeListOnAllocate, ProfilePoolAllocateFreeListOnRelease, ProfilePoolAllocateFreeListManual }
+	};
+	static void (* const release[2][3])( MemoryPool *, void * ) = {
+		{ ProfilePoolReleaseBitmapOnAllocate, ProfilePoolReleaseBitmapOnRelease, ProfilePoolReleaseBitmapManual },
+		{ ProfilePoolReleaseFreeListOnAllocate, ProfilePoolReleaseFreeListOnRelease, ProfilePoolReleaseFreeListManual }
+	};
+
+	if ( p_pool->Profile || !p_pool->AllocateSlot || !p_pool->Raw ) {
+		return false;
+	}
+	MemoryProfile * profile = ProfileCreate( p_name );
+	if ( !profile ) {
+		return false;
+	}
+
+	unsigned int mode = p_pool->Mode == MMEM_POOL_MODE_FREELIST ? 1 : 0;
+	p_pool->AllocateSlot = allocate[mode][p_pool->ZeroPolicy];
+	p_pool->ReleaseSlot = release[mode][p_pool->ZeroPolicy];
+	p_pool->Profile = profile;
+	return true;
+}
+
+bool ProfileArena( MemoryArena * p_arena, char const * p_name ) {
+	if ( p_arena->Profile || !p_arena->AllocateBytes ) {
+		return false;
+	}
+	MemoryProfile * profile = ProfileCreate( p_name );
+	if ( !profile ) {
+		return false;
+	}
+
+	bool zeroing = p_arena->ZeroPolicy == MMEM_ZERO_POLICY_ONALLOCATE;
+	p_arena->AllocateBytes = zeroing ? ProfileArenaAllocateZeroing : ProfileArenaAllocatePlain;
+	p_arena->AllocateAlignedBytes = zeroing ? ProfileArenaAllocateAlignedZeroing : ProfileArenaAllocateAlignedPlain;
+	p_arena->Profile = profile;
+	return true;
+}
+
+void ProfilePoolStop( MemoryPool * p_pool ) {
+	MemoryProfile * profile = p_pool->Profile;
+	if ( !profile ) {
+		return;
+	}
+
+	p_pool->Profile = NULL;
+	PoolBind( p_pool );
+	ProfileDestroy( profile );
+}
+
+void ProfileArenaStop( MemoryArena * p_arena ) {
+	MemoryProfile * profile = p_arena->Profile;
+	if ( !profile ) {
+		return;
+	}
+
+	p_arena->Profile = NULL;
+	ArenaBind( p_arena, p_arena->ZeroPolicy, p_arena->AlignmentPolicy );
+	ProfileDestroy( profile );
+}
+
+/// @brief Output of the reports, written to a buffer like snprintf or staged and written to a file descriptor
+typedef struct {
+	char * Buffer;
+	size_t Size;
+	size_t Length;
+	int File;
+} ProfileOutput;
+
+// Reports are written from signal handlers as well, so they format by hand and never allocate
+static void ProfileFlush( ProfileOutput * p_output ) {
+#if defined( __unix__ ) || defined( __APPLE__ )
+	size_t written = 0;
+	while ( written < p_output->Length ) {
+		ssize_t result = write( p_output->File, p_output->Buffer + written, p_output->Length - written );
+		if ( result < 0 && errno == EINTR ) {
+			continue;
+		}
+		if ( result <= 0 ) {
+			break;
+		}
+		written += (size_t)result;
+	}
+#endif
+	p_output->Length = 0;
+}
+
+static void ProfilePut( ProfileOutput * p_output, char const * p_text, size_t p_length ) {
+	if ( p_output->File < 0 ) {
+		// Like snprintf, the buffer keeps room for the terminator and the length counts the bytes cut off as well
+		size_t left = p_output->Length + 1 < p_output->Size ? p_output->Size - 1 - p_output->Length : 0;
+		if ( left ) {
+			memcpy( p_output->Buffer + p_output->Length, p_text, p_length < left ? p_length : left );
+		}
+		p_output->Length += p_length;
+		return;
+	}
+
+	while ( p_length ) {
+		if ( p_output->Length == p_output->Size ) {
+			ProfileFlush( p_output );
+		}
+		size_t left = p_output->Size - p_output->Length;
+		size_t count = p_length < left ? p_length : left;
+		memcpy( p_output->Buffer + p_output->Length, p_text, count );
+		p_output->Length += count;
+		p_text += count;
+		p_length -= count;
+	}
+}
+
+static void ProfilePutString( ProfileOutput * p_output, char const * p_string ) {
+	ProfilePut( p_output, p_string ? p_string : "(null)", p_string ? strlen( p_string ) : 6 );
+}
+
+static void ProfilePutNumber( ProfileOutput * p_output, uint64_t p_value ) {
+	char digits[20];
+	size_t count = 0;
+	do {
+		digits[sizeof( digits ) - ++count] = (char)( '0' + p_value % 10 );
+		p_value /= 10;
+	} while ( p_value );
+	ProfilePut( p_output, digits + sizeof( digits ) - count, count );
+}
+
+static void ProfilePutAddress( ProfileOutput * p_output, void const * p_address ) {
+	char digits[2 + 2 * sizeof( uintptr_t )];
+	uintptr_t value = (uintptr_t)p_address;
+	size_t count = 0;
+	do {
+		digits[sizeof( digits ) - ++count] = "0123456789abcdef"[value & 0xF];
+		value >>= 4;
+	} while ( value );
+	digits[sizeof( digits ) - ++count] = 'x';
+	digits[sizeof( digits ) - ++count] = '0';
+	ProfilePut( p_output, digits + sizeof( digits ) - count, count );
+}
+
+/// @brief Writes the report of every profiled instance, the registry has to be locked
+static void ProfileReport( ProfileOutput * p_output, unsigned int const p_format ) {
+	if ( p_format != MMEM_PROFILE_PPROF ) {
+		for ( MemoryProfile const * profile = ProfileHead; profile; profile = profile->Next ) {
+			for ( size_t index = 0; index < MMEM_PROFILE_SITES; ++index ) {
+				MemoryProfileSite const * site = &profile->Sites[index];
+				uint64_t bytes = p_format == MMEM_PROFILE_PEAK ? site->Peak : site->Live;
+				if ( !site->Depth || !bytes ) {
+					continue;
+				}
+				ProfilePutString( p_output, profile->Name );
+				for ( size_t frame = site->Depth; frame-- > 0; ) {
+					ProfilePut( p_output, ";", 1 );
+					ProfilePutAddress( p_output, site->Frames[frame] );
+				}
+				ProfilePut( p_output, " ", 1 );
+				ProfilePutNumber( p_output, bytes );
+				ProfilePut( p_output, "\n", 1 );
+			}
+		}
+		return;
+	}
+
+	// Legacy heap profile of pprof, which scales the sampled counts up with the rate in the header
+	uint64_t totals[4] = { 0 };
+	for ( MemoryProfile const * profile = ProfileHead; profile; profile = profile->Next ) {
+		for ( size_t index = 0; index < MMEM_PROFILE_SITES; ++index ) {
+			MemoryProfileSite const * site = &profile->Sites[index];
+			totals[0] += site->LiveSamples;
+			totals[1] += site->LiveSampledBytes;
+			totals[2] += site->Samples;
+			totals[3] += site->SampledBytes;
+		}
+	}
+	ProfilePutString( p_output, "heap profile: " );
+	ProfilePutNumber( p_output, totals[0] );
+	ProfilePutString( p_output, ": " );
+	ProfilePutNumber( p_output, totals[1] );
+	ProfilePutString( p_output, " [" );
+	ProfilePutNumber( p_output, totals[2] );
+	ProfilePutString( p_output, ": " );
+	ProfilePutNumber( p_output, totals[3] );
+	ProfilePutString( p_output, "] @ heap_v2/" );
+	ProfilePutNumber( p_output, MMEM_ATOMIC_LOAD( &ProfileRate ) );
+	ProfilePut( p_output, "\n", 1 );
+
+	for ( MemoryProfile const * profile = ProfileHead; profile; profile = profile->Next ) {
+		for ( size_t index = 0; index < MMEM_PROFILE_SITES; ++index ) {
+			MemoryProfileSite const * site = &profile->Sites[index];
+			if ( !site->Depth || !site->Samples ) {
+				continue;
+			}
+			ProfilePutNumber( p_output, site->LiveSamples );
+			ProfilePutString( p_output, ": " );
+			ProfilePutNumber( p_output, site->LiveSampledBytes );
+			ProfilePutString( p_output, " [" );
+			ProfilePutNumber( p_output, site->Samples );
+			ProfilePutString( p_output, ": " );
+			ProfilePutNumber( p_output, site->SampledBytes );
+			ProfilePutString( p_output, "] @" );
+			for ( size_t frame = 0; frame < site->Depth; ++frame ) {
+				ProfilePut( p_output, " ", 1 );
+				ProfilePutAddress( p_output, site->Frames[frame] );
+			}
+			ProfilePut( p_output, "\n", 1 );
+		}
+	}
+
+#if defined( __linux__ )
+	// The mapped libraries let pprof symbolize the addresses
+	int maps = open( "/proc/self/maps", O_RDONLY );
+	if ( maps >= 0 ) {
+		char chunk[512];
+		ssize_t count = 0;
+		ProfilePutString( p_output, "\nMAPPED_LIBRARIES:\n" );
+		while ( ( count = read( maps, chunk, sizeof( chunk ) ) ) > 0 || ( count < 0 && errno == EINTR ) ) {
+			if ( count > 0 ) {
+				ProfilePut( p_output, chunk, (size_t)count );
+			}
+		}
+		close( maps );
+	}
+#endif
+}
+
+size_t ProfileDump( char * p_buffer, size_t const p_size, unsigned int const p_format ) {
+	ProfileOutput output = { .Buffer = p_buffer, .Size = p_size, .Length = 0, .File = -1 };
+
+	ProfileLockAcquire();
+	ProfileReport( &output, p_format );
+	ProfileLockRelease();
+
+	if ( p_size ) {
+		p_buffer[output.Length < p_size ? output.Length : p_size - 1] = '\0';
+	}
+	return output.Length;
+}
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+/// @brief Writes a report to a file, the registry must not be locked by the calling thread
+static bool ProfileWriteLocked( char const * p_path, unsigned int const p_format, bool const p_wait ) {
+	if ( p_wait ) {
+		ProfileLockAcquire();
+	} else if ( MMEM_ATOMIC_EXCHANGE( &ProfileLock, 1 ) ) {
+		return false;
+	}
+
+	int file = open( p_path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	if ( file >= 0 ) {
+		char stage[MMEM_PROFILE_STAGE];
+		ProfileOutput output = { .Buffer = stage, .Size = sizeof( stage ), .Length = 0, .File = file };
+		ProfileReport( &output, p_format );
+		ProfileFlush( &output );
+		close( file );
+	}
+	ProfileLockRelease();
+	return true;
+}
+
+static void ProfileWriteFile( char const * p_path, unsigned int const p_format ) {
+	if ( p_path ) {
+		ProfileWriteLocked( p_path, p_format, true );
+	}
+}
+
+static void ProfileSignalHandler( int p_signal ) {
+	(void)p_signal;
+	int error = errno;
+	// The interrupted code may hold the registry, the next sample writes the report then
+	if ( !ProfileWriteLocked( ProfileSignalPath, ProfileSignalFormat, false ) ) {
+		MMEM_ATOMIC_STORE( &ProfilePending, 1 );
+	}
+	errno = error;
+}
+
+bool ProfileDumpOnSignal( int const p_signal, char const * p_path, unsigned int const p_format ) {
+	if ( !p_path ) {
+		return false;
+	}
+	ProfileSignalPath = p_path;
+	ProfileSignalFormat = p_format;
+
+	struct sigaction action;
+	memset( &action, 0x00, sizeof( action ) );
+	action.sa_handler = ProfileSignalHandler;
+	action.sa_flags = SA_RESTART;
+	sigemptyset( &action.sa_mask );
+	return sigaction( p_signal, &action, NULL ) == 0;
+}
+#else
+static void ProfileWriteFile( char const * p_path, unsigned int const p_format ) {
+	(void)p_path;
+	(void)p_format;
+}
+
+bool ProfileDumpOnSignal( int const p_signal, char const * p_path, unsigned int const p_format ) {
+	(void)p_signal;
+	(void)p_path;
+	(void)p_format;
+	return false;
+}
+#endif
+#endif
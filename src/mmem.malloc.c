@@ -0,0 +1,424 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "mmem.h"
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+ * Drop-in replacement of the C allocation functions, preloaded or linked ahead of the C library:
+ *     LD_PRELOAD=libmmem_malloc.so ./service
+ *     cc -o service service.c -L. -lmmem_malloc
+ * Every thread allocates from a heap of its own without locks. Objects released by another thread are queued to
+ * the owning heap with one atomic operation and taken back on its next allocation.
+ * Objects up to MALLOC_MEDIUM_MAX are served by size classes, including the padding larger alignments need.
+ * Larger objects are mapped one by one.
+ * Memory comes from mmap only, the allocator of the C library is never called.
+ */
+
+#define MALLOC_EXPORT __attribute__(( visibility( "default" ) ))
+// Alignment of every object, the alignment of max_align_t
+#define MALLOC_ALIGNMENT 16
+// Slab size of every size class, large enough to hold several objects of the largest medium class
+#define MALLOC_SLAB_SIZE (1024 * 1024)
+// Largest size served by a size class, larger objects are mapped one by one
+#define MALLOC_MEDIUM_MAX (128 * 1024)
+// Number of size classes above MMEM_HEAP_SMALL_MAX
+#define MALLOC_MEDIUM_CLASSES 20
+// Pools per heap the identity of a pool can tell apart, heaps are page aligned to leave room for the index
+#define MALLOC_POOLS 64
+
+/**
+ * @brief Heap of one thread, handed on to the next new thread once its thread exited
+ */
+MMEM_STRUCT ThreadHeap {
+	/// @brief Size class pools, only accessed by the thread owning the heap
+	MemoryHeap Heap;
+	/// @brief Size class pools above MMEM_HEAP_SMALL_MAX, only accessed by the thread owning the heap
+	MemorySlabPool Medium[MALLOC_MEDIUM_CLASSES];
+	/// @brief Objects released by other threads, linked through their first word
+	void * Remote MMEM_ALIGNED( MMEM_ALIGNMENT_CACHELINE );
+	/// @brief Next heap left behind by an exited thread
+	struct ThreadHeap * Next;
+} ThreadHeap;
+
+/**
+ * @brief Header of a directly mapped object, at the slab aligned start of its mapping
+ * @details The slab header without owner tells the object apart from size class objects.
+ */
+typedef struct {
+	/// @brief Slab header, its owner is NULL
+	MemorySlab Slab;
+	/// @brief Number of bytes mapped from the header on
+	size_t Mapped;
+} DirectHeader;
+
+static MMEM_THREAD_LOCAL ThreadHeap * local __attribute__(( tls_model( "initial-exec" ) )) = NULL;
+
+static size_t slab_size = 0;
+static size_t page_size = 0;
+static uint8_t classes[(MMEM_HEAP_SMALL_MAX >> 3) + 1];
+static uint8_t medium[(MALLOC_MEDIUM_MAX >> 10) + 1];
+/// @brief Element size of every medium class, spaced 25% apart like the classes of the heap
+static size_t const medium_sizes[MALLOC_MEDIUM_CLASSES] = {
+	5120, 6144, 7168, 8192, 10240, 12288, 14336, 16384, 20480, 24576,
+	28672, 32768, 40960, 49152, 57344, 65536, 81920, 98304, 114688, 131072
+};
+static ThreadHeap * abandoned = NULL;
+static int abandoned_lock = 0;
+static pthread_key_t key;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+
+static inline uintptr_t AlignUp( uintptr_t const p_address, size_t const p_alignment ) {
+	return (p_address + p_alignment - 1) & ~(uintptr_t)(p_alignment - 1);
+}
+
+static inline bool PowerOfTwo( size_t const p_value ) {
+	return p_value && !(p_value & (p_value - 1));
+}
+
+static void Setup( void ) {
+	if ( MMEM_ATOMIC_LOAD( &slab_size ) ) {
+		return;
+	}
+
+	// Every thread computes the same values, whoever stores first wins nothing
+	MemoryHeap heap = HeapOpenEx( MALLOC_SLAB_SIZE, NULL, NULL );
+	memcpy( classes, heap.Classes, sizeof( classes ) );
+	size_t cls = 0;
+	for ( size_t index = 0; index <= (MALLOC_MEDIUM_MAX >> 10); ++index ) {
+		while ( medium_sizes[cls] < (index << 10) ) {
+			cls++;
+		}
+		medium[index] = (uint8_t)cls;
+	}
+	page_size = (size_t)sysconf( _SC_PAGESIZE );
+	MMEM_ATOMIC_STORE( &slab_size, heap.Pools[0].SlabSize );
+}
+
+/// @brief The slab header of an object, objects never start a slab, direct objects end their first slab at most
+static inline MemorySlab * SlabOf( void * p_memory ) {
+	return (MemorySlab *)(((uintptr_t)p_memory - 1) & ~(uintptr_t)(slab_size - 1));
+}
+
+/**
+ * @brief Maps a slab for the size class pools
+ * @details Slab pools ask foreign allocators for twice the slab size and use the slab aligned part only.
+ * The mapping is trimmed to that part right away, so no address space is held in vain.
+ */
+static void * SlabMap( size_t const p_count, size_t const p_size ) {
+	size_t bytes = p_count * p_size;
+	char * mapping = mmap( NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if ( mapping == MAP_FAILED ) {
+		return NULL;
+	}
+
+	char * slab = (char *)AlignUp( (uintptr_t)mapping, slab_size );
+	if ( slab > mapping ) {
+		munmap( mapping, (size_t)(slab - mapping) );
+	}
+	munmap( slab + slab_size, (size_t)(mapping + bytes - (slab + slab_size)) );
+	return slab;
+}
+
+static void SlabUnmap( void * p_slab ) {
+	munmap( p_slab, slab_size );
+}
+
+static void * DirectAllocate( size_t const p_size, size_t const p_alignment ) {
+	size_t header = sizeof( DirectHeader );
+	if ( p_alignment > SIZE_MAX / 4 || p_size > SIZE_MAX / 2 - slab_size - p_alignment ) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	size_t bytes = AlignUp( p_size + header + slab_size + p_alignment, page_size );
+	char * mapping = mmap( NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if ( mapping == MAP_FAILED ) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	// The header sits at the slab boundary below the object, so SlabOf finds it like a slab header
+	uintptr_t ptr = AlignUp( AlignUp( (uintptr_t)mapping, slab_size ) + header, p_alignment );
+	char * start = (char *)((ptr - 1) & ~(uintptr_t)(slab_size - 1));
+	char * end = (char *)AlignUp( ptr + p_size, page_size );
+	if ( start > mapping ) {
+		munmap( mapping, (size_t)(start - mapping) );
+	}
+	if ( end < mapping + bytes ) {
+		munmap( end, (size_t)(mapping + bytes - end) );
+	}
+
+	// Fresh mappings are zeroed, the owner is NULL already
+	DirectHeader * direct = (DirectHeader *)start;
+	direct->Mapped = (size_t)(end - start);
+	return (void *)ptr;
+}
+
+static void ThreadExit( void * p_heap ) {
+	ThreadHeap * heap = p_heap;
+	local = NULL;
+
+	while ( MMEM_ATOMIC_EXCHANGE( &abandoned_lock, 1 ) ) {
+		MMEM_ATOMIC_PAUSE();
+	}
+	heap->Next = abandoned;
+	abandoned = heap;
+	MMEM_ATOMIC_STORE( &abandoned_lock, 0 );
+}
+
+static void KeyCreate( void ) {
+	pthread_key_create( &key, ThreadExit );
+}
+
+/// @brief Adopts a heap left behind by an exited thread or maps a new one for the calling thread
+static ThreadHeap * HeapAdopt( void ) {
+	Setup();
+	pthread_once( &key_once, KeyCreate );
+
+	while ( MMEM_ATOMIC_EXCHANGE( &abandoned_lock, 1 ) ) {
+		MMEM_ATOMIC_PAUSE();
+	}
+	ThreadHeap * heap = abandoned;
+	if ( heap ) {
+		abandoned = heap->Next;
+	}
+	MMEM_ATOMIC_STORE( &abandoned_lock, 0 );
+
+	if ( !heap ) {
+		heap = mmap( NULL, sizeof( ThreadHeap ), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+		if ( heap == MAP_FAILED ) {
+			return NULL;
+		}
+		heap->Heap = HeapOpenEx( MALLOC_SLAB_SIZE, NULL, NULL );
+		for ( size_t cls = 0; cls < MMEM_HEAP_CLASSES; ++cls ) {
+			heap->Heap.Pools[cls].Allocate = SlabMap;
+			heap->Heap.Pools[cls].Release = SlabUnmap;
+			// Heaps are mapped and never unmapped, their page aligned address and the pool index identify a pool
+			heap->Heap.Pools[cls].Id = (uint64_t)(uintptr_t)heap | cls;
+		}
+		for ( size_t cls = 0; cls < MALLOC_MEDIUM_CLASSES; ++cls ) {
+			heap->Medium[cls] = SlabPoolCreateEx( medium_sizes[cls], slab_size, 0, 1, SlabMap, SlabUnmap );
+			heap->Medium[cls].Id = (uint64_t)(uintptr_t)heap | (MMEM_HEAP_CLASSES + cls);
+		}
+	}
+	heap->Next = NULL;
+
+	// Set before the key, which may allocate and has to find the heap then
+	local = heap;
+	pthread_setspecific( key, heap );
+	return heap;
+}
+
+/// @brief The heap owning a size class slab, taken from the identity of the slab's pool
+static inline ThreadHeap * HeapOwning( MemorySlab * p_slab ) {
+	return (ThreadHeap *)(uintptr_t)( p_slab->Owner & ~(uint64_t)(MALLOC_POOLS - 1) );
+}
+
+/// @brief The size class pool owning a slab
+static inline MemorySlabPool * PoolOwning( MemorySlab * p_slab ) {
+	size_t index = (size_t)(p_slab->Owner & (MALLOC_POOLS - 1));
+	ThreadHeap * heap = HeapOwning( p_slab );
+	return index < MMEM_HEAP_CLASSES ? &heap->Heap.Pools[index] : &heap->Medium[index - MMEM_HEAP_CLASSES];
+}
+
+/// @brief The size class pool serving a size up to MALLOC_MEDIUM_MAX
+static inline MemorySlabPool * PoolOf( ThreadHeap * p_heap, size_t const p_size ) {
+	if ( p_size <= MMEM_HEAP_SMALL_MAX ) {
+		return &p_heap->Heap.Pools[classes[(p_size + 7) >> 3]];
+	}
+	return &p_heap->Medium[medium[(p_size + 1023) >> 10]];
+}
+
+/// @brief The start of the slot holding an object, objects of larger alignments are padded inside their slot
+static inline void * SlotOf( MemorySlab * p_slab, void * p_memory ) {
+	size_t offset = (size_t)((char *)p_memory - (char *)p_slab->Pool.Raw);
+	return (char *)p_slab->Pool.Raw + offset - offset % p_slab->Pool.ElementSize;
+}
+
+/// @brief Releases the objects queued by other threads to the heap of the calling thread
+static void HeapDrain( ThreadHeap * p_heap ) {
+	void * node = MMEM_ATOMIC_EXCHANGE_PTR( &p_heap->Remote, NULL );
+	while ( node ) {
+		void * next;
+		memcpy( &next, node, sizeof( void * ) );
+		SlabPoolRelease( PoolOwning( SlabOf( node ) ), node );
+		node = next;
+	}
+}
+
+static void * Allocate( size_t const p_size, size_t const p_alignment ) {
+	size_t size = AlignUp( p_size ? p_size : 1, p_alignment );
+	if ( size > MALLOC_MEDIUM_MAX || size < p_size ) {
+		Setup();
+		return DirectAllocate( p_size, p_alignment );
+	}
+
+	ThreadHeap * heap = local;
+	if ( !heap ) {
+		heap = HeapAdopt();
+		if ( !heap ) {
+			errno = ENOMEM;
+			return NULL;
+		}
+	}
+	if ( MMEM_ATOMIC_LOAD_PTR( &heap->Remote ) ) {
+		HeapDrain( heap );
+	}
+
+	// Slots start cache aligned, classes of a multiple of the alignment keep every slot aligned
+	MemorySlabPool * pool = PoolOf( heap, size );
+	if ( p_alignment > MMEM_ALIGNMENT_CACHELINE || pool->ElementSize % p_alignment ) {
+		// Every slot is 16 byte aligned, a slot larger by the rest of the alignment holds an aligned object
+		size_t padding = p_alignment - MALLOC_ALIGNMENT;
+		if ( size > MALLOC_MEDIUM_MAX - padding ) {
+			return DirectAllocate( p_size, p_alignment );
+		}
+		pool = PoolOf( heap, size + padding );
+	}
+
+	void * ptr = SlabPoolAllocate( pool );
+	if ( !ptr ) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	return (void *)AlignUp( (uintptr_t)ptr, p_alignment );
+}
+
+static inline size_t UsableSize( void * p_memory ) {
+	MemorySlab * slab = SlabOf( p_memory );
+	if ( slab->Owner ) {
+		return (size_t)((char *)SlotOf( slab, p_memory ) + slab->Pool.ElementSize - (char *)p_memory);
+	}
+	return (size_t)((char *)slab + ((DirectHeader *)slab)->Mapped - (char *)p_memory);
+}
+
+MALLOC_EXPORT void * malloc( size_t size ) {
+	return Allocate( size, MALLOC_ALIGNMENT );
+}
+
+MALLOC_EXPORT void free( void * memory ) {
+	if ( !memory ) {
+		return;
+	}
+
+	MemorySlab * slab = SlabOf( memory );
+	if ( !slab->Owner ) {
+		munmap( slab, ((DirectHeader *)slab)->Mapped );
+		return;
+	}
+
+	// Pools release slots by their start only
+	memory = SlotOf( slab, memory );
+	ThreadHeap * owner = HeapOwning( slab );
+	if ( owner == local ) {
+		SlabPoolRelease( PoolOwning( slab ), memory );
+		return;
+	}
+
+	void * head = MMEM_ATOMIC_LOAD_PTR( &owner->Remote );
+	do {
+		memcpy( memory, &head, sizeof( void * ) );
+	} while ( !MMEM_ATOMIC_CAS_PTR( &owner->Remote, &head, memory ) );
+}
+
+MALLOC_EXPORT void * calloc( size_t count, size_t size ) {
+	if ( count && size > SIZE_MAX / count ) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	void * ptr = Allocate( count * size, MALLOC_ALIGNMENT );
+	// Direct mappings are zeroed by the kernel
+	if ( ptr && SlabOf( ptr )->Owner ) {
+		memset( ptr, 0x00, count * size );
+	}
+	return ptr;
+}
+
+MALLOC_EXPORT void * realloc( void * memory, size_t size ) {
+	if ( !memory ) {
+		return malloc( size );
+	}
+	if ( !size ) {
+		free( memory );
+		return NULL;
+	}
+
+	// Objects stay in place while they keep more than half of their usable size
+	size_t usable = UsableSize( memory );
+	if ( size <= usable && size > usable / 2 ) {
+		return memory;
+	}
+
+	void * ptr = malloc( size );
+	if ( ptr ) {
+		memcpy( ptr, memory, usable < size ? usable : size );
+		free( memory );
+	}
+	return ptr;
+}
+
+MALLOC_EXPORT void * reallocarray( void * memory, size_t count, size_t size ) {
+	if ( count && size > SIZE_MAX / count ) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	return realloc( memory, count * size );
+}
+
+MALLOC_EXPORT int posix_memalign( void ** memory, size_t alignment, size_t size ) {
+	if ( !PowerOfTwo( alignment ) || alignment < sizeof( void * ) ) {
+		return EINVAL;
+	}
+
+	void * ptr = Allocate( size, alignment < MALLOC_ALIGNMENT ? MALLOC_ALIGNMENT : alignment );
+	if ( !ptr ) {
+		return ENOMEM;
+	}
+	*memory = ptr;
+	return 0;
+}
+
+MALLOC_EXPORT void * aligned_alloc( size_t alignment, size_t size ) {
+	if ( !PowerOfTwo( alignment ) ) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return Allocate( size, alignment < MALLOC_ALIGNMENT ? MALLOC_ALIGNMENT : alignment );
+}
+
+MALLOC_EXPORT void * memalign( size_t alignment, size_t size ) {
+	// Like the C library, alignments are rounded up to the next power of two
+	size_t power = MALLOC_ALIGNMENT;
+	while ( power < alignment && power <= SIZE_MAX / 2 ) {
+		power <<= 1;
+	}
+	return Allocate( size, power );
+}
+
+MALLOC_EXPORT void * valloc( size_t size ) {
+	Setup();
+	return Allocate( size, page_size );
+}
+
+MALLOC_EXPORT void * pvalloc( size_t size ) {
+	Setup();
+	size_t rounded = AlignUp( size ? size : 1, page_size );
+	if ( rounded < size ) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	return Allocate( rounded, page_size );
+}
+
+MALLOC_EXPORT size_t malloc_usable_size( void * memory ) {
+	return memory ? UsableSize( memory ) : 0;
+}
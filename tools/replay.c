@@ -0,0 +1,533 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "mmem.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/*
+ * Replays an allocation trace written by libmmem_trace.so against several allocation strategies:
+ *     mmem_replay service.trace [--strategy <name>]
+ * Every strategy runs in a child process of its own, so its peak RSS is not mixed up with the others. Traces of
+ * several threads are replayed serially in the recorded order, since pools and arenas are not shared between threads.
+ */
+
+// Granularity of the pool size classes
+#define REPLAY_CLASS_STEP  16
+// Largest size served by a pool, larger objects are allocated with malloc
+#define REPLAY_CLASS_MAX   4096
+#define REPLAY_CLASSES     (REPLAY_CLASS_MAX / REPLAY_CLASS_STEP)
+// Capacity of one arena of the arena strategy, objects above a quarter of it are allocated with malloc
+#define REPLAY_EPOCH       (1 * MMEM_MB_FACTOR)
+#define REPLAY_NONE        UINT32_MAX
+
+#define OP_ALLOCATE 0
+#define OP_CALLOC   1
+#define OP_RESIZE   2
+#define OP_RELEASE  3
+
+typedef enum {
+	STRATEGY_MALLOC,
+	STRATEGY_POOL,
+	STRATEGY_HEAP,
+	STRATEGY_ARENA,
+	STRATEGY_TOTAL
+} Strategy;
+
+char const * const sstring[STRATEGY_TOTAL] = {
+	"malloc",
+	"pool",
+	"heap",
+	"arena"
+};
+
+/// Trace event with its addresses replaced by object ids, ids index the object arrays directly
+typedef struct {
+	uint32_t Op;
+	uint32_t Id;
+	uint32_t Previous;
+	uint64_t Size;
+} ReplayOp;
+
+/// Live objects of the trace by address, open addressing with linear probing
+typedef struct {
+	uint64_t * Keys;
+	uint32_t * Values;
+	size_t Mask;
+	size_t Count;
+} Table;
+
+typedef struct {
+	MemoryArena Arena;
+	size_t Live;
+} Epoch;
+
+typedef struct {
+	ReplayOp * Ops;
+	size_t OpCount;
+	size_t Objects;
+	uint32_t Threads;
+	uint64_t PeakLive;
+	uint64_t Leaked;
+	double Lifetime;
+	/// Most objects of every pool size class alive at once
+	size_t ClassPeak[REPLAY_CLASSES];
+	/// Replay state, indexed by object id
+	void ** Pointers;
+	uint64_t * Sizes;
+	uint32_t * Owners;
+	MemoryPool Pools[REPLAY_CLASSES];
+	MemoryHeap Heap;
+	Epoch * Epochs;
+	size_t EpochCount;
+	size_t EpochCapacity;
+	uint32_t Current;
+	uint32_t * Empty;
+	size_t EmptyCount;
+} Replay;
+
+static inline uint64_t Now( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline size_t Hash( Table const * table, uint64_t key ) {
+	return (size_t)( ( key >> 4 ) * 0x9E3779B97F4A7C15u >> 17 ) & table->Mask;
+}
+
+static bool TableInit( Table * table, size_t capacity ) {
+	table->Keys = calloc( capacity, sizeof( uint64_t ) );
+	table->Values = malloc( capacity * sizeof( uint32_t ) );
+	table->Mask = capacity - 1;
+	table->Count = 0;
+	return table->Keys && table->Values;
+}
+
+static void TableFree( Table * table ) {
+	free( table->Keys );
+	free( table->Values );
+}
+
+static bool TableInsert( Table * table, uint64_t key, uint32_t value );
+
+static bool TableGrow( Table * table ) {
+	Table grown;
+	if ( !TableInit( &grown, (table->Mask + 1) * 2 ) ) {
+		TableFree( &grown );
+		return false;
+	}
+	for ( size_t i = 0; i <= table->Mask; ++i ) {
+		if ( table->Keys[i] ) {
+			TableInsert( &grown, table->Keys[i], table->Values[i] );
+		}
+	}
+	TableFree( table );
+	*table = grown;
+	return true;
+}
+
+/// Inserts or replaces the value of a key, keys are never 0
+static bool TableInsert( Table * table, uint64_t key, uint32_t value ) {
+	if ( (table->Count + 1) * 2 > table->Mask + 1 && !TableGrow( table ) ) {
+		return false;
+	}
+	size_t i = Hash( table, key );
+	while ( table->Keys[i] && table->Keys[i] != key ) {
+		i = (i + 1) & table->Mask;
+	}
+	table->Count += table->Keys[i] ? 0 : 1;
+	table->Keys[i] = key;
+	table->Values[i] = value;
+	return true;
+}
+
+/// Removes a key and moves the following entries of its probe sequence back, so no tombstones are needed
+static bool TableRemove( Table * table, uint64_t key, uint32_t * value ) {
+	size_t i = Hash( table, key );
+	while ( table->Keys[i] != key ) {
+		if ( !table->Keys[i] ) {
+			return false;
+		}
+		i = (i + 1) & table->Mask;
+	}
+	*value = table->Values[i];
+	table->Keys[i] = 0;
+	table->Count--;
+
+	for ( size_t j = (i + 1) & table->Mask; table->Keys[j]; j = (j + 1) & table->Mask ) {
+		size_t home = Hash( table, table->Keys[j] );
+		// Entries whose home lies cyclically in (i, j] stay where they are
+		if ( ( j > i && ( home <= i || home > j ) ) || ( j < i && ( home <= i && home > j ) ) ) {
+			table->Keys[i] = table->Keys[j];
+			table->Values[i] = table->Values[j];
+			table->Keys[j] = 0;
+			i = j;
+		}
+	}
+	return true;
+}
+
+static inline size_t ClassOf( uint64_t size ) {
+	return size ? (size_t)( (size - 1) / REPLAY_CLASS_STEP ) : 0;
+}
+
+/// Counts the live objects of the pool size classes, objects above the largest class are not pooled
+static inline void ClassCount( Replay * replay, size_t * live, uint64_t size, bool allocate ) {
+	if ( size > REPLAY_CLASS_MAX ) {
+		return;
+	}
+	size_t index = ClassOf( size );
+	if ( allocate && ++live[index] > replay->ClassPeak[index] ) {
+		replay->ClassPeak[index] = live[index];
+	} else if ( !allocate ) {
+		live[index]--;
+	}
+}
+
+/// Reads a trace and turns its addresses into object ids, gathering what the strategies need to be sized
+static bool Load( Replay * replay, char const * path ) {
+	FILE * f = fopen( path, "rb" );
+	if ( !f ) {
+		fprintf( stderr, "Cannot open %s\n", path );
+		return false;
+	}
+
+	TraceHeader header;
+	if ( fread( &header, sizeof( header ), 1, f ) != 1 || header.Magic != TRACE_MAGIC || header.Version != TRACE_VERSION ) {
+		fprintf( stderr, "%s is no trace of version %d\n", path, TRACE_VERSION );
+		fclose( f );
+		return false;
+	}
+
+	fseek( f, 0, SEEK_END );
+	long end = ftell( f );
+	fseek( f, (long)sizeof( header ), SEEK_SET );
+	size_t events = end > (long)sizeof( header ) ? ((size_t)end - sizeof( header )) / sizeof( TraceEvent ) : 0;
+
+	Table live;
+	size_t class_live[REPLAY_CLASSES] = { 0 };
+	uint64_t * born = malloc( ( events + 1 ) * sizeof( uint64_t ) );
+	replay->Ops = malloc( ( events + 1 ) * sizeof( ReplayOp ) );
+	replay->Sizes = malloc( ( events + 1 ) * sizeof( uint64_t ) );
+	if ( !born || !replay->Ops || !replay->Sizes || !TableInit( &live, 1024 ) ) {
+		fprintf( stderr, "Out of memory\n" );
+		fclose( f );
+		return false;
+	}
+
+	uint64_t live_bytes = 0;
+	uint64_t freed = 0;
+	double lifetimes = 0.0;
+	TraceEvent event;
+	while ( fread( &event, sizeof( event ), 1, f ) == 1 ) {
+		replay->Threads = event.Thread > replay->Threads ? event.Thread : replay->Threads;
+		bool resize = event.Op == TRACE_REALLOC && event.Previous;
+		if ( resize && !event.Address && event.Size ) {
+			// A failed realloc keeps the previous memory
+			continue;
+		}
+
+		// Memory allocated before the shim was loaded is unknown, releasing it is skipped
+		uint32_t previous = REPLAY_NONE;
+		if ( ( event.Op == TRACE_FREE || resize ) && TableRemove( &live, event.Op == TRACE_FREE ? event.Address : event.Previous, &previous ) ) {
+			live_bytes -= replay->Sizes[previous];
+			lifetimes += (double)(event.Time - born[previous]);
+			freed++;
+		}
+		if ( event.Op == TRACE_FREE || !event.Address ) {
+			// Also realloc to 0, which only released the previous memory
+			if ( previous != REPLAY_NONE ) {
+				ClassCount( replay, class_live, replay->Sizes[previous], false );
+				replay->Ops[replay->OpCount++] = (ReplayOp) { .Op = OP_RELEASE, .Id = previous, .Previous = REPLAY_NONE, .Size = 0 };
+			}
+			continue;
+		}
+
+		uint32_t id = (uint32_t)replay->Objects++;
+		if ( !TableInsert( &live, event.Address, id ) ) {
+			fprintf( stderr, "Out of memory\n" );
+			fclose( f );
+			return false;
+		}
+		replay->Sizes[id] = event.Size;
+		born[id] = event.Time;
+		live_bytes += event.Size;
+		replay->PeakLive = live_bytes > replay->PeakLive ? live_bytes : replay->PeakLive;
+		// Resizing allocates before it releases the previous object
+		ClassCount( replay, class_live, event.Size, true );
+		if ( previous != REPLAY_NONE ) {
+			ClassCount( replay, class_live, replay->Sizes[previous], false );
+		}
+
+		uint32_t op = event.Op == TRACE_CALLOC ? OP_CALLOC : previous != REPLAY_NONE ? OP_RESIZE : OP_ALLOCATE;
+		replay->Ops[replay->OpCount++] = (ReplayOp) { .Op = op, .Id = id, .Previous = previous, .Size = event.Size };
+	}
+	fclose( f );
+
+	replay->Leaked = replay->Objects - freed;
+	replay->Lifetime = freed ? lifetimes / (double)freed : 0.0;
+	TableFree( &live );
+	free( born );
+
+	replay->Pointers = calloc( replay->Objects + 1, sizeof( void * ) );
+	replay->Owners = malloc( ( replay->Objects + 1 ) * sizeof( uint32_t ) );
+	return replay->Pointers && replay->Owners;
+}
+
+/// Kilobytes of a line of /proc/self/status, 0 if it is not available
+static size_t Status( char const * key ) {
+	FILE * f = fopen( "/proc/self/status", "r" );
+	if ( !f ) {
+		return 0;
+	}
+	char line[256];
+	size_t value = 0;
+	size_t length = strlen( key );
+	while ( fgets( line, sizeof( line ), f ) ) {
+		if ( !strncmp( line, key, length ) ) {
+			value = (size_t)strtoull( line + length, NULL, 10 );
+			break;
+		}
+	}
+	fclose( f );
+	return value;
+}
+
+/// Resets the peak RSS of the process to its current RSS
+static void ResetPeak( void ) {
+	FILE * f = fopen( "/proc/self/clear_refs", "w" );
+	if ( f ) {
+		fputs( "5", f );
+		fclose( f );
+	}
+}
+
+/// Adds an empty arena, the arrays of arenas and empty arenas grow together
+static bool EpochAdd( Replay * replay ) {
+	if ( replay->EpochCount == replay->EpochCapacity ) {
+		size_t capacity = replay->EpochCapacity ? replay->EpochCapacity * 2 : 64;
+		Epoch * epochs = realloc( replay->Epochs, capacity * sizeof( Epoch ) );
+		if ( epochs ) {
+			replay->Epochs = epochs;
+		}
+		uint32_t * empty = realloc( replay->Empty, capacity * sizeof( uint32_t ) );
+		if ( empty ) {
+			replay->Empty = empty;
+		}
+		if ( !epochs || !empty ) {
+			return false;
+		}
+		replay->EpochCapacity = capacity;
+	}
+	replay->Epochs[replay->EpochCount++] = (Epoch) { .Arena = ArenaCreate( REPLAY_EPOCH ), .Live = 0 };
+	return true;
+}
+
+static void * StrategyAllocate( Replay * replay, Strategy strategy, uint32_t id, uint64_t size ) {
+	replay->Owners[id] = REPLAY_NONE;
+	switch ( strategy ) {
+	case STRATEGY_POOL:
+		if ( size <= REPLAY_CLASS_MAX ) {
+			replay->Owners[id] = (uint32_t)ClassOf( size );
+			return PoolAllocate( &replay->Pools[ClassOf( size )] );
+		}
+		return malloc( (size_t)size );
+	case STRATEGY_HEAP:
+		return HeapAllocate( &replay->Heap, (size_t)size );
+	case STRATEGY_ARENA: {
+		if ( size > REPLAY_EPOCH / 4 ) {
+			return malloc( (size_t)size );
+		}
+		Epoch * epoch = &replay->Epochs[replay->Current];
+		void * memory = ArenaAllocateAligned( &epoch->Arena, (size_t)size, 16 );
+		if ( !memory ) {
+			// The full arena retires, it is reset once its last object is released
+			if ( !epoch->Live ) {
+				ArenaReset( &epoch->Arena );
+			} else if ( replay->EmptyCount ) {
+				replay->Current = replay->Empty[--replay->EmptyCount];
+			} else if ( EpochAdd( replay ) ) {
+				replay->Current = (uint32_t)(replay->EpochCount - 1);
+			}
+			epoch = &replay->Epochs[replay->Current];
+			memory = ArenaAllocateAligned( &epoch->Arena, (size_t)size, 16 );
+		}
+		epoch->Live++;
+		replay->Owners[id] = replay->Current;
+		return memory;
+	}
+	default:
+		return malloc( (size_t)size );
+	}
+}
+
+static void StrategyRelease( Replay * replay, Strategy strategy, uint32_t id ) {
+	void * memory = replay->Pointers[id];
+	uint32_t owner = replay->Owners[id];
+	replay->Pointers[id] = NULL;
+	switch ( strategy ) {
+	case STRATEGY_POOL:
+		if ( owner != REPLAY_NONE ) {
+			PoolRelease( &replay->Pools[owner], memory );
+			return;
+		}
+		break;
+	case STRATEGY_HEAP:
+		HeapRelease( &replay->Heap, memory );
+		return;
+	case STRATEGY_ARENA:
+		if ( owner != REPLAY_NONE ) {
+			Epoch * epoch = &replay->Epochs[owner];
+			if ( !--epoch->Live && owner != replay->Current ) {
+				ArenaReset( &epoch->Arena );
+				replay->Empty[replay->EmptyCount++] = owner;
+			}
+			return;
+		}
+		break;
+	default:
+		break;
+	}
+	free( memory );
+}
+
+static bool StrategyOpen( Replay * replay, Strategy strategy ) {
+	switch ( strategy ) {
+	case STRATEGY_POOL:
+		// Offline every class knows how many objects it holds at most
+		for ( size_t i = 0; i < REPLAY_CLASSES; ++i ) {
+			if ( replay->ClassPeak[i] ) {
+				replay->Pools[i] = PoolCreateFreeList( (i + 1) * REPLAY_CLASS_STEP, replay->ClassPeak[i], false );
+			}
+		}
+		return true;
+	case STRATEGY_HEAP:
+		replay->Heap = HeapOpen();
+		return true;
+	case STRATEGY_ARENA:
+		replay->Current = 0;
+		return EpochAdd( replay );
+	default:
+		return true;
+	}
+}
+
+static void Run( Replay * replay, Strategy strategy ) {
+	// The bookkeeping of the replay is touched up front, so only the strategy adds to the peak RSS
+	memset( replay->Pointers, 0x00, ( replay->Objects + 1 ) * sizeof( void * ) );
+	memset( replay->Owners, 0xFF, ( replay->Objects + 1 ) * sizeof( uint32_t ) );
+	ResetPeak();
+	size_t baseline = Status( "VmRSS:" );
+	if ( !StrategyOpen( replay, strategy ) ) {
+		fprintf( stderr, "%s: out of memory\n", sstring[strategy] );
+		return;
+	}
+
+	uint64_t begin = Now();
+	for ( size_t i = 0; i < replay->OpCount; ++i ) {
+		ReplayOp const * op = &replay->Ops[i];
+		if ( op->Op == OP_RELEASE ) {
+			StrategyRelease( replay, strategy, op->Id );
+			continue;
+		}
+
+		if ( op->Op == OP_RESIZE && strategy == STRATEGY_MALLOC ) {
+			replay->Pointers[op->Id] = realloc( replay->Pointers[op->Previous], (size_t)op->Size );
+			replay->Pointers[op->Previous] = NULL;
+			replay->Owners[op->Id] = REPLAY_NONE;
+		} else if ( op->Op == OP_RESIZE && strategy == STRATEGY_HEAP ) {
+			replay->Pointers[op->Id] = HeapResize( &replay->Heap, replay->Pointers[op->Previous], (size_t)op->Size );
+			replay->Pointers[op->Previous] = NULL;
+		} else {
+			void * memory = StrategyAllocate( replay, strategy, op->Id, op->Size );
+			if ( memory && op->Op == OP_CALLOC ) {
+				memset( memory, 0x00, (size_t)op->Size );
+			} else if ( memory && op->Op == OP_RESIZE ) {
+				uint64_t size = replay->Sizes[op->Previous] < op->Size ? replay->Sizes[op->Previous] : op->Size;
+				memcpy( memory, replay->Pointers[op->Previous], (size_t)size );
+				StrategyRelease( replay, strategy, op->Previous );
+			}
+			replay->Pointers[op->Id] = memory;
+		}
+		if ( !replay->Pointers[op->Id] && op->Size ) {
+			fprintf( stderr, "%s: allocation %zu of %llu bytes failed\n", sstring[strategy], i, (unsigned long long)op->Size );
+			return;
+		}
+		// Touch every page like the traced program did, untouched pages would not count to the RSS
+		char * bytes = replay->Pointers[op->Id];
+		for ( uint64_t offset = 0; bytes && offset < op->Size; offset += 4096 ) {
+			bytes[offset] = (char)0xA5;
+		}
+	}
+	uint64_t elapsed = Now() - begin;
+
+	size_t peak = Status( "VmHWM:" );
+	if ( !peak ) {
+		struct rusage usage;
+		getrusage( RUSAGE_SELF, &usage );
+		peak = (size_t)usage.ru_maxrss;
+	}
+	double footprint = (double)( peak > baseline ? peak - baseline : 0 ) * 1024.0;
+	double fragmentation = footprint > (double)replay->PeakLive ? ( 1.0 - (double)replay->PeakLive / footprint ) * 100.0 : 0.0;
+	printf( "%-8s %12.6lf %10.2lf %14.0lf %14.0lf %12.1lf%%\n", sstring[strategy], (double)elapsed * 1e-9,
+		replay->OpCount ? (double)elapsed / (double)replay->OpCount : 0.0, footprint / 1024.0, (double)replay->PeakLive / 1024.0, fragmentation );
+}
+
+int main( int argc, char ** argv ) {
+	char const * path = NULL;
+	char const * only = NULL;
+	for ( int i = 1; i < argc; ++i ) {
+		if ( !strcmp( argv[i], "--strategy" ) && i + 1 < argc ) {
+			only = argv[++i];
+		} else if ( !path ) {
+			path = argv[i];
+		} else {
+			path = NULL;
+			break;
+		}
+	}
+	if ( !path ) {
+		printf( "Usage: %s <trace> [--strategy malloc|pool|heap|arena]\n", argv[0] );
+		return EXIT_FAILURE;
+	}
+
+	Replay replay = { 0 };
+	if ( !Load( &replay, path ) ) {
+		return EXIT_FAILURE;
+	}
+	printf( "%zu operations, %zu objects, %u threads, peak %llu live bytes, %llu never released, mean lifetime %.0lf ns\n",
+		replay.OpCount, replay.Objects, replay.Threads, (unsigned long long)replay.PeakLive, (unsigned long long)replay.Leaked, replay.Lifetime );
+	printf( "%-8s %12s %10s %14s %14s %13s\n", "Strategy", "Seconds", "ns/op", "Peak RSS KB", "Peak live KB", "Fragmentation" );
+	fflush( stdout );
+
+	for ( Strategy strategy = 0; strategy < STRATEGY_TOTAL; ++strategy ) {
+		if ( only && strcmp( only, sstring[strategy] ) ) {
+			continue;
+		}
+		pid_t child = fork();
+		if ( child == 0 ) {
+			Run( &replay, strategy );
+			fflush( stdout );
+			_exit( EXIT_SUCCESS );
+		} else if ( child > 0 ) {
+			waitpid( child, NULL, 0 );
+		} else {
+			Run( &replay, strategy );
+		}
+	}
+
+	free( replay.Owners );
+	free( replay.Pointers );
+	free( replay.Sizes );
+	free( replay.Ops );
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,318 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "mmem.compiler.h"
+#include "trace.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Allocation trace shim, preloaded into the traced program:
+ *     MMEM_TRACE=service.trace LD_PRELOAD=libmmem_trace.so ./service
+ * Every call is appended to a shared buffer under a lock and written out whenever the buffer is full and at exit.
+ * Calls made by the shim itself, e.g. by dlsym while the real functions are looked up, are not recorded.
+ * A forked child continues its trace in <path>.<pid>, created on its first event so a fork followed by exec leaves
+ * no empty file behind. The parent's events are written once, by the parent.
+ */
+
+// Events written at once
+#define TRACE_BUFFER    4096
+// Memory handed out while dlsym looks up the real functions
+#define TRACE_BOOTSTRAP (64 * 1024)
+
+#define STATE_UNINITIALIZED 0
+#define STATE_INITIALIZING  1
+#define STATE_READY         2
+
+static void * (*real_malloc)( size_t );
+static void * (*real_calloc)( size_t, size_t );
+static void * (*real_realloc)( void *, size_t );
+static void (*real_free)( void * );
+static int (*real_posix_memalign)( void **, size_t, size_t );
+static void * (*real_aligned_alloc)( size_t, size_t );
+
+static char bootstrap[TRACE_BOOTSTRAP] MMEM_ALIGNED( 16 );
+static uint64_t bootstrap_used = 0;
+
+static TraceEvent buffer[TRACE_BUFFER];
+static size_t buffered = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int file = -1;
+static bool forked = false;
+static char path[PATH_MAX];
+static uint64_t start = 0;
+static uint32_t threads = 0;
+static uint64_t state = STATE_UNINITIALIZED;
+
+static MMEM_THREAD_LOCAL bool inside = false;
+static MMEM_THREAD_LOCAL uint32_t thread_id = 0;
+
+static inline uint64_t Now( void ) {
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static inline bool Bootstrapped( void const * memory ) {
+	return (char const *)memory >= bootstrap && (char const *)memory < bootstrap + sizeof( bootstrap );
+}
+
+static void * BootstrapAllocateAligned( size_t size, size_t alignment ) {
+	if ( size > sizeof( bootstrap ) || alignment > sizeof( bootstrap ) ) {
+		return NULL;
+	}
+	// Every reservation is a multiple of 16 bytes, so every offset stays 16 byte aligned and larger alignments need slack
+	uint64_t slack = alignment > 16 ? alignment - 16 : 0;
+	uint64_t reserved = (((uint64_t)size + 15) & ~(uint64_t)15) + slack;
+	uint64_t offset = MMEM_ATOMIC_FETCH_ADD( &bootstrap_used, reserved );
+	if ( reserved > sizeof( bootstrap ) || offset > sizeof( bootstrap ) - reserved ) {
+		return NULL;
+	}
+	// Static memory is zeroed and never reused, which also serves calloc
+	uintptr_t address = (uintptr_t)(bootstrap + offset);
+	return (void *)((address + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+static void * BootstrapAllocate( size_t size ) {
+	return BootstrapAllocateAligned( size, 16 );
+}
+
+/// @brief Looks up a function of the next library, the ISO C way to turn the object pointer into a function pointer
+static void Resolve( void * function, char const * name ) {
+	void * symbol = dlsym( RTLD_NEXT, name );
+	memcpy( function, &symbol, sizeof( symbol ) );
+}
+
+static void Write( void const * data, size_t size ) {
+	char const * bytes = data;
+	while ( size && file >= 0 ) {
+		ssize_t written = write( file, bytes, size );
+		if ( written < 0 && errno == EINTR ) {
+			continue;
+		}
+		if ( written <= 0 ) {
+			// Keep the traced program running, the trace ends here
+			close( file );
+			file = -1;
+			return;
+		}
+		bytes += written;
+		size -= (size_t)written;
+	}
+}
+
+static void Flush( void ) {
+	Write( buffer, buffered * sizeof( TraceEvent ) );
+	buffered = 0;
+}
+
+/// @brief Creates the trace file and writes its header
+static void Open( char const * name ) {
+	file = open( name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+	TraceHeader header = { .Magic = TRACE_MAGIC, .Version = TRACE_VERSION };
+	Write( &header, sizeof( header ) );
+}
+
+/// @brief Writes out the buffer and holds the lock across fork, so no other thread leaves it locked in the child
+static void ForkPrepare( void ) {
+	pthread_mutex_lock( &lock );
+	Flush();
+}
+
+static void ForkParent( void ) {
+	pthread_mutex_unlock( &lock );
+}
+
+/// @brief Leaves the trace of the parent, the trace of the child is created by its first event
+static void ForkChild( void ) {
+	buffered = 0;
+	if ( file >= 0 ) {
+		close( file );
+		file = -1;
+		forked = true;
+	}
+	pthread_mutex_unlock( &lock );
+}
+
+/// @brief Creates the trace of a forked child in <path>.<pid>, the caller holds the lock
+static void OpenChild( void ) {
+	forked = false;
+	char name[PATH_MAX + 24];
+	char digits[24];
+	size_t length = strlen( path );
+	size_t count = 0;
+	unsigned long pid = (unsigned long)getpid();
+	do {
+		digits[count++] = (char)('0' + pid % 10);
+		pid /= 10;
+	} while ( pid );
+	memcpy( name, path, length );
+	name[length++] = '.';
+	while ( count ) {
+		name[length++] = digits[--count];
+	}
+	name[length] = '\0';
+
+	Open( name );
+}
+
+static void Initialize( void ) {
+	Resolve( &real_malloc, "malloc" );
+	Resolve( &real_calloc, "calloc" );
+	Resolve( &real_realloc, "realloc" );
+	Resolve( &real_free, "free" );
+	Resolve( &real_posix_memalign, "posix_memalign" );
+	Resolve( &real_aligned_alloc, "aligned_alloc" );
+
+	char const * name = getenv( "MMEM_TRACE" );
+	name = name && *name ? name : "mmem.trace";
+	if ( strlen( name ) < sizeof( path ) ) {
+		strcpy( path, name );
+		Open( path );
+	}
+	pthread_atfork( ForkPrepare, ForkParent, ForkChild );
+	start = Now();
+	MMEM_ATOMIC_STORE( &state, STATE_READY );
+}
+
+/// @brief Initializes the shim on the first call, threads racing the first call are served from the bootstrap memory
+static inline bool Ready( void ) {
+	uint64_t current = MMEM_ATOMIC_LOAD( &state );
+	if ( current == STATE_UNINITIALIZED ) {
+		if ( !MMEM_ATOMIC_CAS( &state, &current, STATE_INITIALIZING ) ) {
+			return false;
+		}
+		Initialize();
+		return true;
+	}
+	return current == STATE_READY;
+}
+
+/// @brief Appends an event, the caller holds the lock
+static void Append( uint32_t op, void const * address, void const * previous, size_t size ) {
+	if ( forked ) {
+		OpenChild();
+	}
+	if ( file < 0 ) {
+		return;
+	}
+	if ( !thread_id ) {
+		thread_id = ++threads;
+	}
+	buffer[buffered++] = (TraceEvent) {
+		.Time = Now() - start,
+		.Address = (uint64_t)(uintptr_t)address,
+		.Previous = (uint64_t)(uintptr_t)previous,
+		.Size = (uint64_t)size,
+		.Thread = thread_id,
+		.Op = op
+	};
+	if ( buffered == TRACE_BUFFER ) {
+		Flush();
+	}
+}
+
+static void Record( uint32_t op, void const * address, void const * previous, size_t size ) {
+	if ( inside ) {
+		return;
+	}
+	inside = true;
+	pthread_mutex_lock( &lock );
+	Append( op, address, previous, size );
+	pthread_mutex_unlock( &lock );
+	inside = false;
+}
+
+__attribute__(( destructor )) static void Finish( void ) {
+	pthread_mutex_lock( &lock );
+	Flush();
+	if ( file >= 0 ) {
+		close( file );
+		file = -1;
+	}
+	pthread_mutex_unlock( &lock );
+}
+
+void * malloc( size_t size ) {
+	if ( !Ready() ) {
+		return BootstrapAllocate( size );
+	}
+	void * memory = real_malloc( size );
+	Record( TRACE_MALLOC, memory, NULL, size );
+	return memory;
+}
+
+void * calloc( size_t count, size_t size ) {
+	if ( !Ready() ) {
+		return count && size > SIZE_MAX / count ? NULL : BootstrapAllocate( count * size );
+	}
+	void * memory = real_calloc( count, size );
+	Record( TRACE_CALLOC, memory, NULL, count && size > SIZE_MAX / count ? SIZE_MAX : count * size );
+	return memory;
+}
+
+void * realloc( void * memory, size_t size ) {
+	bool ready = Ready();
+	if ( !ready || Bootstrapped( memory ) ) {
+		// The size of bootstrap memory is unknown, copy what may belong to it
+		void * moved = ready ? malloc( size ) : BootstrapAllocate( size );
+		if ( moved && Bootstrapped( memory ) ) {
+			size_t left = (size_t)(bootstrap + sizeof( bootstrap ) - (char *)memory);
+			memmove( moved, memory, size < left ? size : left );
+		}
+		return moved;
+	}
+	if ( inside ) {
+		return real_realloc( memory, size );
+	}
+
+	// The released memory may be handed out again right away, so the call and its record are not interleaved
+	inside = true;
+	pthread_mutex_lock( &lock );
+	void * moved = real_realloc( memory, size );
+	Append( TRACE_REALLOC, moved, memory, size );
+	pthread_mutex_unlock( &lock );
+	inside = false;
+	return moved;
+}
+
+void free( void * memory ) {
+	if ( !memory || Bootstrapped( memory ) || !Ready() ) {
+		return;
+	}
+	// Recorded before the memory can be handed out again
+	Record( TRACE_FREE, memory, NULL, 0 );
+	real_free( memory );
+}
+
+int posix_memalign( void ** memory, size_t alignment, size_t size ) {
+	if ( !Ready() ) {
+		if ( alignment < sizeof( void * ) || ( alignment & (alignment - 1) ) ) {
+			return EINVAL;
+		}
+		*memory = BootstrapAllocateAligned( size, alignment );
+		return *memory ? 0 : ENOMEM;
+	}
+	int result = real_posix_memalign( memory, alignment, size );
+	Record( TRACE_ALIGNED, result ? NULL : *memory, NULL, size );
+	return result;
+}
+
+void * aligned_alloc( size_t alignment, size_t size ) {
+	if ( !Ready() ) {
+		return alignment && !( alignment & (alignment - 1) ) ? BootstrapAllocateAligned( size, alignment ) : NULL;
+	}
+	void * memory = real_aligned_alloc( alignment, size );
+	Record( TRACE_ALIGNED, memory, NULL, size );
+	return memory;
+}
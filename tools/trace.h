@@ -0,0 +1,44 @@
+#ifndef MMEM_TRACE_H
+#define MMEM_TRACE_H
+
+#include <stdint.h>
+
+/// @brief Magic number at the start of every trace file ("MMTR")
+#define TRACE_MAGIC   0x52544D4Du
+#define TRACE_VERSION 1
+
+#define TRACE_MALLOC  0
+#define TRACE_CALLOC  1
+#define TRACE_REALLOC 2
+#define TRACE_FREE    3
+#define TRACE_ALIGNED 4
+
+/**
+ * @brief Header at the start of every trace file, followed by TraceEvent records until the end of the file
+ */
+typedef struct {
+	/// @brief TRACE_MAGIC
+	uint32_t Magic;
+	/// @brief TRACE_VERSION of the writer
+	uint32_t Version;
+} TraceHeader;
+
+/**
+ * @brief One intercepted call, records are written in the order the calls took effect
+ */
+typedef struct {
+	/// @brief Nanoseconds since the trace started
+	uint64_t Time;
+	/// @brief Returned memory, or the released memory of TRACE_FREE. 0 if the allocation failed
+	uint64_t Address;
+	/// @brief Memory passed to realloc, 0 for every other call
+	uint64_t Previous;
+	/// @brief Requested size in bytes, calloc records the product of its arguments
+	uint64_t Size;
+	/// @brief Sequential number of the calling thread, starting at 1
+	uint32_t Thread;
+	/// @brief Intercepted call ( TRACE_MALLOC/TRACE_CALLOC/TRACE_REALLOC/TRACE_FREE/TRACE_ALIGNED )
+	uint32_t Op;
+} TraceEvent;
+
+#endif // MMEM_TRACE_H